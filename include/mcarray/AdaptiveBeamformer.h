@@ -0,0 +1,117 @@
+/*
+* AdaptiveBeamformer.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_ADAPTIVEBEAMFORMER_H_
+#define __MCA_ADAPTIVEBEAMFORMER_H_
+
+#include <mcarray/Beamformer.h>
+
+namespace mca
+{
+
+/**
+ * @brief The AdaptiveBeamformer class computes, for each bin and beam, the weights
+ *
+ *    w = R^-1 a / (a^H R^-1 a)
+ *
+ * where a is the steering vector of the DOA of the beam and R is:
+ *   MVDR: the spatial covariance of the input, estimated recursively, plus a diagonal loading
+ *         proportional to its trace.
+ *   SUPERDIRECTIVE: the coherence matrix of a spherically diffuse noise field plus a fixed diagonal loading.
+ *
+ * R is factorised (Cholesky) per bin, so the weights of a beam whose DOA changes are obtained by
+ * forward and backward substitution only. In MVDR mode, the input snapshots are stored and
+ * the covariance is updated with all of them in a block every _updatePeriod frames, right before
+ * factorising it again. Until the first update the weights are the delay-and-sum ones.
+ * Matrices are stored bin by bin ([bin][row][column]) so that each update or solve only
+ * touches a small contiguous block of memory.
+ */
+class AdaptiveBeamformer : public Beamformer
+{
+    public:
+
+	/**
+	   * @brief AdaptiveBeamformer
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the array.
+	   * @param fftCCSLength  real length of the buffers containing the FFT in CCS format.
+	   * @param nchannels  number of input channels.
+	   * @param nbeams  maximum number of beams computed at once.
+	   * @param type  MVDR or SUPERDIRECTIVE.
+	   */
+	AdaptiveBeamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels,
+			   unsigned int nbeams=1, BeamformerType type=MVDR);
+	virtual ~AdaptiveBeamformer(){}
+
+	virtual void processFrame(SignalVector &inputAnalysisFrames, SignalPtr outputFrame, double DOA);
+	virtual void processFrame(SignalVector &inputAnalysisFrames, SignalVector &outputFrames, const BaseType *DOAs, unsigned int nbeams);
+
+    private:
+
+	static constexpr double _covarianceMemoryFactor = 0.95; /**< weight of the previous covariance at each frame */
+	static constexpr double _diagonalLoading = 0.01; /**< loading added to the covariance, relative to its mean eigenvalue */
+	static constexpr double _superdirectiveLoading = 0.01; /**< loading added to the diffuse noise coherence matrix */
+	static constexpr int _updatePeriod = 4; /**< number of frames between covariance updates (and weights computation) */
+
+	const BeamformerType _type; /**< MVDR or SUPERDIRECTIVE */
+	int _complexLength; /**< number of bins of the one-sided FFT */
+	int _storedSnapshots; /**< number of frames stored in _snapshots since the last update */
+	SignalCPtr _snapshots; /**< input frames since the last update, stored as [bin][frame][channel] */
+	SignalCPtr _covariance; /**< covariance of the input (or noise coherence) for each bin, [bin][row][column] */
+	SignalCPtr _choleskyFactors; /**< lower Cholesky factor of the loaded covariance for each bin, [bin][row][column] */
+	SignalCPtr _steeringVector; /**< steering vector of one bin */
+	SignalCPtr _solution; /**< R^-1 a for one bin */
+	SignalVector _singleOutput; /**< used to call the multi-beam processFrame with one output */
+
+	/**
+	   * @brief allocate Allocates memory.
+	   */
+	void allocate();
+
+	/**
+	   * @brief setDiffuseNoiseCoherence  Stores in _covariance the coherence between microphones of a
+	   * spherically diffuse noise field: sin(w*d_ij/c)/(w*d_ij/c).
+	   */
+	void setDiffuseNoiseCoherence();
+
+	/**
+	   * @brief updateCovariance  Adds the stored snapshots to the covariance in one block:
+	   * R = l^K*R + (1-l)*sum_j l^(K-1-j) x_j x_j^H, with K the number of stored snapshots.
+	   */
+	void updateCovariance();
+
+	/**
+	   * @brief factorise  Loads the diagonal of the covariance of each bin and computes its Cholesky factor.
+	   * @param loading  diagonal loading, relative to the mean of the diagonal.
+	   */
+	void factorise(double loading);
+
+	/**
+	   * @brief setWeights  Computes the weights of one beam for all bins using the current Cholesky factors.
+	   * @param beam  index of the beam.
+	   * @param DOA  DOA to be pointed by the beam.
+	   */
+	void setWeights(unsigned int beam, double DOA);
+};
+
+}
+
+#endif // __MCA_ADAPTIVEBEAMFORMER_H_
@@ -24,6 +24,8 @@
 
 #include <mcarray/microhponeArrayHelpers.h>
 #include <mcarray/ArrayDescription.h>
+#include <mcarray/SteeringBeamforming.h>
+#include <mcarray/DecimatingFrontEnd.h>
 #include <dspone/dsp.h>
 #include <dspone/rt/ShortTimeAnalysis.h>
 
@@ -46,13 +48,35 @@ class SoundLocalisation : public dsp::SignalAnalyser
 	 * @param sampleRate   sample rate of the input signal.
 	 * @param microphonePositions   Description of the microphone array.
 	 * @param callback    Callback to call, whenever a new DOA is computed.
+	 * @param method    Method used to localise with arrays of more than 2 microphones.
+	 * @param decimate    Localise at the lowest rate adequate for the bandwidth of the array,
+	 * with a DecimatingFrontEnd in front of the localisation.
 	 */
 	SoundLocalisation(int sampleRate,
 			  ArrayDescription microphonePositions,
-			  LocalisationCallback *callback=NULL);
+			  LocalisationCallback *callback=NULL,
+			  SteeringBeamforming::LocalisationMethod method=SteeringBeamforming::SRP_PHAT,
+			  bool decimate=false);
 	virtual ~SoundLocalisation();
+
+	/**
+	 * @brief process  localises a block of samples at the input sample rate.
+	 * @param input  one buffer per microphone.
+	 * @param length  number of samples per channel.
+	 * @return number of samples passed to the localisation (fewer than length when decimating).
+	 */
+	int process(const std::vector<double*> &input, int length);
+
+	/**
+	 * @brief getAnalysisSampleRate
+	 * @return sample rate at which the sources are localised.
+	 */
+	inline int getAnalysisSampleRate() const {return _frontEnd ? _frontEnd->getOutputSampleRate() : _sampleRate;}
     private:
+	const int _sampleRate;
 	std::unique_ptr<dsp::ShortTimeAnalysis> _impl;
+	std::unique_ptr<DecimatingFrontEnd> _frontEnd; /**< decimation before the localisation, if any */
+	std::vector<double*> _input; /**< channels passed to the localisation */
 };
 
 
@@ -91,7 +115,7 @@ class BinauralMasking: public dsp::SignalProcessor
 	/**
 	 * @brief BinauralMasking
 	 * @param sampleRate  sample rate of the signal to be processed.
-	 * @param nchannels  number of channels to be process.
+	 * @param microphones  positions of the microphones, one channel per microphone (at least two).
 	 */
 	BinauralMasking(int samplerate,
 			ArrayDescription microphones,
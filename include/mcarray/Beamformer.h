@@ -23,6 +23,7 @@
 #define __MCA_BEAMFORMER_H_
 
 #include <mcarray/ArrayDescription.h>
+#include <mcarray/SplitSpectrum.h>
 #include <mcarray/mcadefs.h>
 
 #include <memory>
@@ -31,12 +32,33 @@ namespace mca
 {
 
 
+/**
+ * @brief The Beamformer class implements a delay-and-sum beamformer in the frequency domain.
+ * It is also the base class of the beamformers that compute other weights (see AdaptiveBeamformer).
+ */
 class Beamformer
 {
 
     public:
 
-	Beamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels);
+	/**
+	   * This type identifies the beamforming algorithm.
+	   * DELAY_AND_SUM = delays each channel according to the DOA and averages them.
+	   * MVDR = minimum variance distortionless response with diagonal loading, computed from
+	   *        the estimated spatial covariance of the input.
+	   * SUPERDIRECTIVE = MVDR computed for a spherically diffuse noise field, weights are fixed for each DOA.
+	   **/
+	typedef enum {DELAY_AND_SUM=0, MVDR=1, SUPERDIRECTIVE=2} BeamformerType;
+
+	/**
+	   * @brief Beamformer
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the array.
+	   * @param fftCCSLength  real length of the buffers containing the FFT in CCS format.
+	   * @param nchannels  number of input channels.
+	   * @param nbeams  maximum number of beams computed at once by the multi-beam processFrame.
+	   */
+	Beamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels, unsigned int nbeams=1);
 	virtual ~Beamformer(){}
 
 	/**
@@ -46,19 +68,74 @@ class Beamformer
 	   * @param outputFrame  output frame
 	   * @param DOA  DOA to be pointed.
 	   */
-	void processFrame(SignalVector &inputAnalysisFrames, SignalPtr outputFrame, double DOA);
+	virtual void processFrame(SignalVector &inputAnalysisFrames, SignalPtr outputFrame, double DOA);
 
-    private:
+	/**
+	   * @brief processFrame  Processes one frame and generates one output frame per DOA (beam) in a single
+	   * pass over the input frames. For each frequency bin the outputs are obtained as the product
+	   * of a (nbeams x nchannels) steering matrix and the vector of input bins.
+	   * All the inputs are read before the outputs are written, so output
+	   * frames may be the same buffers as the input frames.
+	   * The steering vectors of a beam are only recomputed when its DOA changes.
+	   * @param inputAnalysisFrames  input frames to be processed (FFT in CCS format).
+	   * @param outputFrames  output frames, at least nbeams.
+	   * @param DOAs  DOA to be pointed by each beam.
+	   * @param nbeams  number of beams to compute, up to the number given on construction.
+	   */
+	virtual void processFrame(SignalVector &inputAnalysisFrames, SignalVector &outputFrames, const BaseType *DOAs, unsigned int nbeams);
+
+    protected:
 
+	static constexpr int _renormalisationPeriod = 64; /**< number of bins between renormalisations of the steering phasor */
 	int _sampleRate; /**< sample rate of the signals to be processed */
 	int _fftCCSLength; /**< real length of the buffers containing the FFT in CCS format */
 	int _nchannels; /**< number of channels in input signal (number of microphones) */
 	ArrayDescription _microphonePositions; /**< description of the array (position of each microphone). */
 
+	unsigned int _nbeams; /**< maximum number of beams of the multi-beam processFrame */
+	SignalPtr _beamDOAs; /**< DOA of the steering vectors currently stored for each beam */
+	SplitSpectrum _steering; /**< weights applied to each bin (y = sum_c w_c*x_c), one split plane per beam and channel (see steeringIndex) */
+
+	/**
+	   * @brief phaseStep  Phase increment per FFT bin of the delay applied to one channel to point to a DOA.
+	   * @param channel  index of the channel.
+	   * @param DOA  DOA to be pointed.
+	   * @return  phase increment, in radians per bin.
+	   */
+	double phaseStep(int channel, double DOA) const;
+
+	/**
+	   * @brief steeringIndex  Index of the plane of _steering with the weights of one beam and channel.
+	   */
+	inline unsigned int steeringIndex(unsigned int beam, int channel) const {return beam*_nchannels + channel;}
+
+	/**
+	   * @brief checkNumberOfBeams  Throws an exception if more beams than the number given on construction are requested.
+	   */
+	void checkNumberOfBeams(unsigned int nbeams) const;
+
+	/**
+	   * @brief applySteering  Computes the output of the first nbeams beams with the weights in _steering.
+	   * The inputs are converted to split layout before the outputs are written, and each beam is accumulated
+	   * channel by channel over all bins.
+	   */
+	void applySteering(SignalVector &inputAnalysisFrames, SignalVector &outputFrames, unsigned int nbeams);
+
+    private:
+
 	SignalPtr _phase; /**< phase ramp used to apply a delay to each channel */
 	SignalCPtr _complexRamp; /**< complex "ramp" used to apply a delay to each channel */
 	SignalPtr _ones; /**< used as magnitude to compute the complex ramp */
 	SignalCPtr _channelSignal; /**< delayed signal of one channel, used to compute the output signal */
+	SplitSpectrum _splitInput; /**< input frames in split layout */
+	SplitSpectrum _splitOutput; /**< output of the beam being computed, in split layout */
+
+	/**
+	   * @brief setSteering  Computes the delay-and-sum weights of one beam for all bins.
+	   * @param beam  index of the beam.
+	   * @param DOA  DOA to be pointed by the beam.
+	   */
+	void setSteering(unsigned int beam, double DOA);
 
 	/**
 	   * @brief allocate Allocates memory.
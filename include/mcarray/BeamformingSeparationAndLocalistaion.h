@@ -37,12 +37,71 @@ class BeamformingSeparationAndLocalisation : public SoundLocalisationImpl
 
     public:
 
-	BeamformingSeparationAndLocalisation(int sampleRate, int fftCCSLength, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor);
+	/**
+	   * @brief The LocalisationRate struct sets how often the sources are localised.
+	   * The separation runs on every frame, steered to the last localised DOAs.
+	   */
+	struct LocalisationRate
+	{
+	    LocalisationRate(unsigned int period=1) :
+		period(period), powerChange(0), spectralChange(0) {}
+
+	    unsigned int period; /**< frames above the noise floor between localisations, 1 to localise every frame */
+	    BaseType powerChange; /**< localise earlier if the log power changes more than this since the last localisation, 0 to disable */
+	    BaseType spectralChange; /**< localise earlier if the relative spectral flux since the last localisation exceeds this (in (0, 1]), 0 to disable */
+	};
+
+	/**
+	   * @brief BeamformingSeparationAndLocalisation
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param fftCCSLength  real length of the buffers containing the FFT in CCS format.
+	   * @param microphonePositions  description of the array.
+	   * @param numOfSources  number of sources to localise and separate.
+	   * @param usePowerFloor  use the estimated power floor to detect the presence of signal.
+	   * @param beamformerType  algorithm used to separate the sources.
+	   * @param localisationMethod  method used to compute the energy in each DOA.
+	   */
+	BeamformingSeparationAndLocalisation(int sampleRate, int fftCCSLength, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor,
+					     Beamformer::BeamformerType beamformerType=Beamformer::DELAY_AND_SUM,
+					     SteeringBeamforming::LocalisationMethod localisationMethod=SteeringBeamforming::PAIRWISE_GCC);
 
 	virtual ~BeamformingSeparationAndLocalisation(){}
-	void processFrameLocalisation(SignalVector &analysisFrames, SignalVector &wienerCoefs);
+	/**
+	   * @brief processFrameLocalisation  localises the sources if the frame exceeds the noise floor.
+	   * @return the log power of the frame.
+	   */
+	BaseType processFrameLocalisation(SignalVector &analysisFrames, SignalVector &wienerCoefs);
+	/**
+	   * @brief processSilentFrame  updates the noise floor with a frame that has been found to be
+	   * silence before its FFT was computed.
+	   * @param power  estimated log power of the frame.
+	   */
+	void processSilentFrame(BaseType power);
 	void processFrameSeparation(SignalVector &analysisFrames, SignalVector &outputFrames);
 
+	/**
+	   * @brief setLocalisationRate  sets how often the sources are localised, by default on every frame.
+	   */
+	void setLocalisationRate(const LocalisationRate &rate);
+	inline const LocalisationRate &getLocalisationRate() const {return _rate;}
+	/**
+	   * @brief getNumberOfLocalisations
+	   * @return number of frames in which the sources have been localised.
+	   */
+	inline unsigned long getNumberOfLocalisations() const {return _localisations;}
+
+	/**
+	   * @brief setSourceCounting  enables the separation of only the sources found active
+	   * by the localisation (see SteeringBeamforming::getNumberOfActiveSources), the outputs
+	   * of the rest are set to zero. Disabled by default, all numOfSources are separated.
+	   */
+	void setSourceCounting(bool enable);
+	/**
+	   * @brief getNumberOfActiveSources
+	   * @return number of sources separated in the following frames.
+	   */
+	inline unsigned int getNumberOfActiveSources() const {return _activeSources;}
+
     private:
 
 	const unsigned int _nchannels; /**< number of channels (microphones in array) */
@@ -51,23 +110,22 @@ class BeamformingSeparationAndLocalisation : public SoundLocalisationImpl
 	bool _usePowerFloor; /**< flag used to indicate if power floor is used */
 	static constexpr double _noiseMarginDB = 3; /**< noise margin respect to the power floor (in dB). */
 	unsigned int _numOfSources; /**< num of sources to search. */
-	SignalVector _inputFrames; /**< used to store a copy of inputFrames in processFrameSeparation function. */
 	SteeringBeamforming _steeringBeamforming; /**< steering beamforming object.*/
-	Beamformer _beamformer; /** beamformer object. */
-
+	std::unique_ptr<Beamformer> _beamformer; /**< beamformer object (delay-and-sum or adaptive). */
+	bool _sourceCounting; /**< separate only the active sources */
+	unsigned int _activeSources; /**< number of sources found active in the last localisation */
+	LocalisationRate _rate; /**< how often the sources are localised */
+	unsigned int _framesSinceLocalisation; /**< frames above the noise floor since the last localisation */
+	unsigned long _localisations; /**< number of frames in which the sources have been localised */
+	BaseType _localisedPower; /**< log power of the last localised frame */
+	SignalPtr _magnitude; /**< magnitude spectrum of the first channel of the current frame */
+	SignalPtr _localisedMagnitude; /**< magnitude spectrum of the first channel of the last localised frame */
 
 	/**
-	   * @brief setPowerFloor  Sets the power floor and when the necessary amount of samples have been
-	   * consumed set the variable __noiseEstimated to true and the variable _powerFloor.
-	   * Used calculatePower to obtain the power value.
-	   * to the estimated value.
-	   * @param analysisFrames  input frames
-	   * @param length  length of the input vectors
-	   * @param nchannels  number of channels in analysisFrames
-	   * @param sampleRate  sampleRate
-	   * @return   returns the power calculated.
+	   * @brief isLocalisationDue  decides whether the current frame has to be localised,
+	   * following _rate.
 	   */
-	BaseType setPowerFloor(SignalVector &analysisFrames, int fftCCSLength, int nchannels, int sampleRate);
+	bool isLocalisationDue(const SignalVector &analysisFrames, BaseType power);
 
 	/**
 	   * @brief allocate Allocates memory.
@@ -0,0 +1,135 @@
+/*
+* BinauralGCC.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_BINAURALGCC_H_
+#define __MCA_BINAURALGCC_H_
+
+#include <mcarray/mcadefs.h>
+
+namespace mca
+{
+
+/**
+ * @brief The BinauralGCC class evaluates the GCC-PHAT of two channels for a set of delays
+ * with the same convention as TauMatrix:
+ *
+ *    C(tau_t) = Re{ sum_k  X_l(k)X*_r(k)/|X_l(k)X*_r(k)| * e^{jw_k*tau_t} }
+ *
+ * but with a compact table, so that it stays in cache when the band is the whole spectrum:
+ *  - the phase terms are stored in float32, as separate cosine and sine tables.
+ *  - when the delays are symmetric (tau_t = -tau_{T-1-t}, as in a DOA grid from -90 to 90 degrees)
+ *    only half of the rows are stored, since C(tau) and C(-tau) share the same products:
+ *    C(+-tau) = sum_k S_re*cos(w_k*tau) -+ sum_k S_im*sin(w_k*tau).
+ *  - the table is split in blocks of bins, and all the delays of a block are evaluated before
+ *    moving to the next one, so that the cross-spectrum block is reused from L1.
+ *  - several frames can be evaluated at once, then each block of the table is read once for all of them.
+ * Partial sums of each block are done in float and accumulated in double.
+ */
+class BinauralGCC
+{
+    public:
+
+	/**
+	   * @brief BinauralGCC  precomputes the phase terms for the given delays and band.
+	   * @param tau  delays (in samples) to evaluate.
+	   * @param tauLength  number of delays.
+	   * @param firstBin  first one-sided FFT bin of the band (included).
+	   * @param lastBin  last one-sided FFT bin of the band (excluded).
+	   * @param complexLength  length of the one-sided FFT (N/2+1).
+	   */
+	BinauralGCC(const BaseType *tau, int tauLength, int firstBin, int lastBin, int complexLength);
+	virtual ~BinauralGCC(){}
+
+	/**
+	   * @brief calculateCorrelations  computes the real part of the GCC-PHAT for each delay.
+	   * @param left  one-sided spectrum of the left channel (full length, indexed by FFT bin).
+	   * @param right  one-sided spectrum of the right channel (full length, indexed by FFT bin).
+	   * @param correlations  output vector of tauLength elements.
+	   */
+	void calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations);
+
+	/**
+	   * @brief calculateCorrelations  computes the correlations of the delays in [firstDelay, lastDelay) only.
+	   * Only the rows of the table needed by those delays are read (a contiguous slice of each block).
+	   * The rest of correlations is not modified.
+	   */
+	void calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations,
+				   int firstDelay, int lastDelay);
+
+	/**
+	   * @brief calculateCorrelations  computes the correlations of several frames.
+	   * @param left  one-sided spectrum of the left channel of each frame.
+	   * @param right  one-sided spectrum of the right channel of each frame.
+	   * @param nframes  number of frames.
+	   * @param correlations  output matrix of nframes x tauLength elements, stored by frames.
+	   */
+	void calculateCorrelations(const BaseTypeC *const *left, const BaseTypeC *const *right, int nframes, BaseType *correlations);
+
+	inline int getFirstBin() const {return _firstBin;}
+	inline int getLastBin() const {return _lastBin;}
+	inline int getNumberOfDelays() const {return _tauLength;}
+	inline bool isSymmetric() const {return _symmetric;}
+	/**
+	   * @brief getTableSize
+	   * @return size in bytes of the phase tables.
+	   */
+	inline size_t getTableSize() const {return 2*sizeof(BaseType32)*_nblocks*_nrows*_blockLength;}
+
+    private:
+	static constexpr int _blockLength = 128; /**< number of bins of each block */
+	static constexpr double _symmetryTolerance = 1e-5; /**< max mismatch (in samples) between tau and -tau of symmetric delays */
+
+	const int _tauLength; /**< number of delays */
+	const int _firstBin; /**< first FFT bin of the band */
+	const int _lastBin; /**< last FFT bin of the band (excluded) */
+	const int _nbins; /**< number of FFT bins in the band */
+	const int _nblocks; /**< number of blocks of bins, the last one is padded with zeros */
+	bool _symmetric; /**< delays are symmetric, only half of the rows are stored */
+	int _nrows; /**< number of rows stored */
+	SignalPtr32 _cos; /**< cos(w_k*tau_t) stored as [block][row][bin in block] */
+	SignalPtr32 _sin; /**< sin(w_k*tau_t) stored as [block][row][bin in block] */
+	int _frameCapacity; /**< number of frames the buffers below can hold */
+	SignalPtr32 _crossRe; /**< real part of the PHAT-weighted cross-spectrum of each frame, padded to the blocks */
+	SignalPtr32 _crossIm; /**< imaginary part of the PHAT-weighted cross-spectrum of each frame, padded to the blocks */
+	SignalPtr _cosSums; /**< sum_k S_re*cos of each frame and row */
+	SignalPtr _sinSums; /**< sum_k S_im*sin of each frame and row */
+
+	/**
+	   * @brief reserveFrames  makes the buffers big enough for nframes frames.
+	   */
+	void reserveFrames(int nframes);
+
+	/**
+	   * @brief calculateCrossSpectrum  computes the PHAT-weighted cross-spectrum in the band for one frame.
+	   */
+	void calculateCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right, int frame);
+
+	/**
+	   * @brief calculateRows  computes the correlations of the delays in [firstDelay, lastDelay) of several
+	   * frames, reading only the rows of the table those delays need.
+	   */
+	void calculateRows(const BaseTypeC *const *left, const BaseTypeC *const *right, int nframes, BaseType *correlations,
+			   int firstDelay, int lastDelay);
+};
+
+}
+
+#endif // __MCA_BINAURALGCC_H_
@@ -24,7 +24,10 @@
 #define __BINAURALLOCALISATION_H
 
 #include <mcarray/SoundLocalisationImpl.h>
-#include <dspone/algorithm/gralCrossCorrelation.h>
+#include <mcarray/SpectralFrontEnd.h>
+#include <mcarray/SilencePreGate.h>
+#include <mcarray/BinauralGCC.h>
+#include <mcarray/TauMatrix.h>
 #include <dspone/rt/ShortTimeFourierAnalysis.h>
 
 namespace mca {
@@ -52,6 +55,7 @@ class TemporalGCCBinauralLocalisation : public SoundLocalisationImpl, public dsp
 	static constexpr double _frameRate = 0.075; /**< the length of the frame to work with, in  seconds  */
 	static constexpr double _doaMemoryFactor = 0.500; /**< the weight assign to prevous DOA in when updating _currentDOA */
 	static constexpr double _doaMemoryFactorSilence = 0.800; /**< the weight assign to prevous DOA in when updating _currentDOA */
+	static constexpr double _noiseMarginDB = 3.0; /**< margin over the noise floor to decide that signal is present */
 
 	const double _microphoneDistance; /**< distance between the two microphones used to record the audio signal, in meters */
 
@@ -168,54 +172,125 @@ class TemporalGCCBinauralLocalisation : public SoundLocalisationImpl, public dsp
 	   */
 	double samples2Degrees(int delay, int ndelays);
 
-	/**
-	   * @brief setPowerFloor  Sets the power floor and when the necessary amount of samples have been
-	   * consumed set the variable __noiseEstimated to true and the variable _powerFloor.
-	   * Used calculatePower to obtain the power value.
-	   * to the estimated value.
-	   * @param analysisFrames  input frames
-	   * @param length  length of the input vectors
-	   * @param nchannels  number of channels in analysisFrames
-	   * @param sampleRate  sampleRate
-	   * @return   returns the power calculated.
-	   */
-	virtual BaseType setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate);
-	BaseType setPowerFloor(std::vector<BaseType*> &analysisFrames, int analysisLength, int nchannels, int sampleRate);
-
 };
 
 
-class FreqGCCBinauralLocalisation : public SoundLocalisationImpl, public dsp::STFTAnalysis
+class FreqGCCBinauralLocalisation : public SoundLocalisationImpl, public dsp::STFTAnalysis, public SpectrumConsumer
 {
     public:
-	FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, bool usePowerFloor=true);
+	/**
+	   * @brief The Config struct holds the parameters that trade latency and resolution against CPU.
+	   * Shorter frames lower the latency, longer frames and a coarser DOA grid lower the CPU load.
+	   */
+	struct Config {
+	    explicit Config(float frameRate = _frameRate) :
+		frameRate(frameRate), fftOrder(0), doaStep(_defaultDoaStep), tauEvaluation(TauMatrix::TABLE), bandLimited(false),
+		trackingWindow(0), fullSearchPeriod(_defaultFullSearchPeriod) {}
+
+	    float frameRate; /**< frame rate in seconds, used to derive the FFT order if fftOrder is not set */
+	    int fftOrder; /**< order of the FFT, 0 to derive it from frameRate */
+	    float doaStep; /**< step between DOA values of the grid, in radians */
+	    TauMatrix::Evaluation tauEvaluation; /**< TABLE uses the compact BinauralGCC table, RECURRENCE one phasor per DOA */
+	    bool bandLimited; /**< evaluate the GCC only over the bins below spatial aliasing and above 100 Hz (see getUsefulBand) */
+	    int trackingWindow; /**< grid points evaluated on each side of the tracked DOA while a source is locked, 0 to always search the whole grid */
+	    int fullSearchPeriod; /**< frames between searches of the whole grid while a source is locked, to catch new sources */
+
+	    /**
+	       * @brief getFFTOrder  returns fftOrder, or the order derived from the frame rate if it is not set.
+	       */
+	    int getFFTOrder(int sampleRate) const;
+	};
+
+	/**
+	   * @brief FreqGCCBinauralLocalisation
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the (two) microphones.
+	   * @param usePowerFloor  use the estimated power floor to detect the presence of signal.
+	   * @param frameRate  frame rate in seconds, to work with the frames of a SpectralFrontEnd.
+	   * Memory factors are adapted to keep the same time constants as with the default frame rate.
+	   */
+	FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, bool usePowerFloor=true, float frameRate=_frameRate);
+
+	/**
+	   * @brief FreqGCCBinauralLocalisation  constructor with a runtime configuration.
+	   * @param config  frame rate, FFT order and DOA grid resolution to use.
+	   */
+	FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, const Config &config, bool usePowerFloor=true);
 	virtual void setProbability(const double *doas, double *probs, int size);
 
+	/**
+	   * @brief consumeSpectrum  Localises from a spectrum computed by a SpectralFrontEnd.
+	   */
+	virtual void consumeSpectrum(const SpectralFrame &frame);
+
+	/**
+	   * @brief consumeSpectra  Localises from a block of spectra. The correlations of all the frames
+	   * are computed at once (see BinauralGCC), then frames are processed in order as in consumeSpectrum.
+	   */
+	virtual void consumeSpectra(const SpectralBlock &block);
+
+	/**
+	   * @brief isSourceLocked
+	   * @return true if the next frame will only be evaluated around the tracked DOA (see Config::trackingWindow).
+	   */
+	inline bool isSourceLocked() const {return _trackingWindow > 0 && _trackedStep >= 0;}
+
+	/**
+	   * @brief getFrameCorrMemoryFactor
+	   * @return memory factor of the correlation, adapted to the hop in use.
+	   */
+	inline float getFrameCorrMemoryFactor() const {return _frameCorrMemoryFactor;}
+	/**
+	   * @brief getFrameDoaMemoryFactor
+	   * @return memory factor of the DOA, adapted to the hop in use.
+	   */
+	inline float getFrameDoaMemoryFactor() const {return _frameDoaMemoryFactor;}
+
     private:
 
 	static constexpr float _frameRate = 0.075; /**< related with the length of the frame to work with, in  seconds  */
+	static constexpr float _defaultDoaStep = 3*M_PI/180; /**< default resolution of the DOA grid, see Config */
+	static constexpr int _defaultFullSearchPeriod = 10; /**< default frames between searches of the whole grid, see Config */
 	static constexpr float _noiseMarginDB = 6.0; /**< def: 3 margin over the noise level to decide that signal is present  */
 	static constexpr float _maxCorrMemoryFactor = 0.8; /**< max memory factor to smooth the correlation (weigth assigned to the previous correlation).  */
 	static constexpr float _maxDoaMemoryFactor = 0.6; /**< max memory factor used to smooth the DOA values (weigth assigned to the previous DOA).   */
+	const float _frameCorrMemoryFactor; /**< _maxCorrMemoryFactor adapted to the hop of the FFT order in use */
+	const float _frameDoaMemoryFactor; /**< _maxDoaMemoryFactor adapted to the hop of the FFT order in use */
 	float _corrMemoryFactor; /**< Current memory factor used to smooth the correlation. It goes to zero in silence periods. */
 	float _doaMemoryFactor; /**< Current memory factor used to smooth the DOA values. It goes to zero in silence periods.  */
 	const double _microphoneDistance; /**< distance between the two microphones used to record the audio signal, in meters */
 	int _silenceFramesCounter; /**< Counter of the consecutive frames in silence (without signal). Used to control memory factors.  */
 	int _sampleRate; /**< sample rate of the signals to be processed */
-	const float _doaStep; /**< Step in degrees between DOA values used in the DOA grid. It determines the resolution.  */
+	const float _doaStep; /**< Step in radians between DOA values used in the DOA grid. It determines the resolution.  */
 	const int _numSteps; /**< Number of steps in DOA grid (calculated from doaStep).  */
 	bool _usePowerFloor; /**< Flag that indicates if the power floor is used to detect the presence of signal.  */
 	std::unique_ptr<uint16_t> _sampledDOAs;
 	SignalPtr _magnitude; /**< vector used to compute the magnitude of the signal. */
 	SignalPtr _power; /**< vector used to compute the power of the signal. */
-	SignalCPtr _correlations; /**< vector used to store the correlation. */
 	SignalPtr _correlationsReal; /**< vector used to store the real part of the correlation. */
 	SignalPtr _prevCorrelationsReal; /**< vector used to store the previous correlation. */
 	SignalPtr _triangle; /**< triangle used to give more weigth to the center DOAs in the correlation. */
 	SignalCPtr _mixedChannel; /**< vector used to mix right and left channels */
 	SignalPtr _samplesDelay; /**< Delay (in samples) used to compute the correlation, according to doaStep and numSteps.  */
 
-	dsp::GeneralisedCrossCorrelation _gcc; /**< pointer to the object which implements the GCC algorithm. */
+	std::unique_ptr<BinauralGCC> _gcc; /**< pointer to the object which implements the GCC algorithm. */
+	std::unique_ptr<TauMatrix> _recurrenceGCC; /**< GCC with the phase terms generated by recurrence, used instead of _gcc if configured */
+	std::vector<double*> _consumedFrames; /**< pointers to the frames of a consumed spectrum */
+	std::vector<double*> _noDataChannels; /**< empty data channels used when consuming a spectrum */
+	SignalPtr _blockCorrelations; /**< correlations of the frames of a consumed block, stored by frames */
+	int _blockCapacity; /**< number of frames that fit in _blockCorrelations */
+	const BaseType *_precomputedCorrelations; /**< correlations of the current frame if already computed, NULL otherwise */
+	const int _trackingWindow; /**< grid points evaluated on each side of the tracked DOA, 0 if the whole grid is always searched */
+	const int _fullSearchPeriod; /**< frames between searches of the whole grid while a source is locked */
+	int _trackedStep; /**< grid point of the locked source, -1 if there is none */
+	int _framesSinceFullSearch; /**< frames evaluated around the tracked DOA since the last search of the whole grid */
+	SilencePreGate _preGate; /**< keeps the windowed frames until it is known whether they need an FFT */
+
+	/**
+	   * @brief frameAnalysis  stores the windowed frame, the FFT is done in processParametrisation
+	   * only if the frame is not clearly below the noise floor.
+	   */
+	virtual void frameAnalysis(BaseType *inFrame, BaseType *analysis, int frameLength, int analysisLength, int channel);
 
 	/**
 	   * @brief processParametrisation  Process the signal in _analysisFrames
@@ -224,20 +299,27 @@ class FreqGCCBinauralLocalisation : public SoundLocalisationImpl, public dsp::ST
 	   */
 	virtual void processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
 					    std::vector<double*> &dataChannels, int dataLength);
+
+	/**
+	   * @brief getSearchWindow  decides which grid points are evaluated in the current frame.
+	   * @param firstStep  first grid point of the window.
+	   * @param lastStep  last grid point of the window (excluded).
+	   * @return false if the whole grid has to be evaluated.
+	   */
+	bool getSearchWindow(int &firstStep, int &lastStep);
+
 	/**
-	   * @brief setPowerFloor  Sets the power floor and when the necessary amount of samples have been
-	   * consumed set the variable __noiseEstimated to true and the variable _powerFloor.
-	   * Used calculatePower to obtain the power value.
-	   * to the estimated value.
-	   * @param analysisFrames  input frames
-	   * @param length  length of the input vectors
-	   * @param nchannels  number of channels in analysisFrames
-	   * @param sampleRate  sampleRate
-	   * @return   returns the power calculated.
+	   * @brief updateTrack  locks the window on the current DOA, or releases it
+	   * if the maximum of the correlations is on an inner edge of the window.
 	   */
-	virtual BaseType setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate);
-	BaseType setPowerFloor(std::vector<BaseType*> &analysisFrames, int analysisLength, int nchannels, int sampleRate);
+	void updateTrack(int firstStep, int lastStep);
 
+	/**
+	   * @brief getHopRatio
+	   * @return hop of the given FFT order relative to the hop of the default order, by which
+	   * the time constants are scaled (1 with the default configuration).
+	   */
+	static double getHopRatio(int sampleRate, int fftOrder);
 
 	/**
 	   * @brief For debuggin purposes
@@ -23,6 +23,7 @@
 #define __BINAURALMASKINGIMPL_H
 
 #include <mcarray/mcadefs.h>
+#include <mcarray/GammatoneFilterBank.h>
 
 #include <dspone/rt/ShortTimeProcess.h>
 #include <dspone/rt/ShortTimeFourierTransform.h>
@@ -47,6 +48,10 @@ namespace mca {
 	* This can be useful in cases were we rely more on one masking type.
 	*
 	* Use use a mel-scaled filter bank instead of a gammtone filterbank.
+	* A gammatone filter bank of IIR resonators (GammatoneFilterBank) can be chosen instead. It does not
+	* store the band signals, so the analysis buffer holds the frame alone instead of one frame per band.
+	* It filters the signal as a stream, one hop per frame, so its output is delayed by half the frame
+	* overlap on top of the delay of the bank.
 	*
 	**/
 
@@ -66,6 +71,15 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	   **/
 	typedef enum {FACTOR =0, RELATIVE=1, FULL=3} MaskingMethod;
 
+	/**
+	   * This type identifies the filter bank that splits the signal in bands.
+	   * MEL_FFT = mel-scaled filter bank applied in the frequency domain, the bands of the frame are stored
+	   *           in the analysis buffer.
+	   * GAMMATONE_IIR = gammatone filter bank of IIR resonators, the bands are produced and consumed
+	   *                 sample by sample, only the frame is stored.
+	   **/
+	typedef enum {MEL_FFT=0, GAMMATONE_IIR=1} FilterBankType;
+
 	/**
 	   * @brief BinauralMasking constructor
 	   * @param nchannels  number of channels to be process
@@ -74,12 +88,14 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	   * @param samplerate
 	   * @param microDistance  distance between the microphones in metres
 	   * @param mmethod  set the masking method used
+	   * @param filterBank  filter bank used to split the signal in bands
 	   */
 	BinauralMaskingImpl(int samplerate,
 			    double microDistance,
 			    float lowFreq,
 			    float highFreq,
-			    MaskingMethod mmethod = RELATIVE);
+			    MaskingMethod mmethod = RELATIVE,
+			    FilterBankType filterBank = MEL_FFT);
 
 	virtual ~BinauralMaskingImpl();
 
@@ -93,6 +109,7 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	   * @param analysisLength   Length of the buffer that can be used to stored the filtered signal.
 	   * Has to be (_nBins+1)*frameLength this is because it has to store the nBins filtered buffers
 	   * generated by the filterbank plus the residual.
+	   * With the GAMMATONE_IIR filter bank the frame is just unwindowed, its new hop is filtered while it is masked.
 	   */
 	virtual void frameAnalysis(BaseType *inFrame, BaseType *analysis, int frameLength, int analysisLength, int channel);
 	/**
@@ -133,6 +150,7 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	   * @return the factor used for temporal masking in the FACTOR masking method
 	   */
 	inline float getTemporalMaskingFactor(){return 1/_temporalMaskingFactor;}
+	inline FilterBankType getFilterBankType() const {return _filterBankType;}
 
     private:
 
@@ -168,13 +186,21 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	const float _maxFreq;
 	const int _nchannels;
 	const int _windowSize;
+	const FilterBankType _filterBankType;
 
 	/**
-	   * @brief Mel-scaled filter bank.
+	   * @brief Mel-scaled filter bank (MEL_FFT).
 	   */
 	std::unique_ptr<dsp::FilterBank> _filterBankLeft;
 	std::unique_ptr<dsp::FilterBank> _filterBankRight;
 
+	/**
+	   * @brief Gammatone filter bank (GAMMATONE_IIR), shared by both channels.
+	   */
+	std::unique_ptr<GammatoneFilterBank> _gammatone;
+	boost::scoped_array<BaseType> _gammatoneOutput; /**< last frame of masked signal of each channel, nchannels x windowSize */
+	boost::scoped_array<BaseType> _analysisWindow; /**< window of the input frames, applied to the output ones */
+
 	/**
 	   * @brief Low pass-filtered power.
 	   * Memory of the temporal masking.
@@ -187,6 +213,20 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	   */
 	std::vector<double> _thresholds;
 
+	/**
+	   * @brief Statistics of the current frame, one value per bin, measured before any decision is taken.
+	   */
+	boost::scoped_array<BaseType> _bandPower; /**< P[m], power of the averaged channels */
+	boost::scoped_array<BaseType> _bandCorrelation; /**< normalised correlation between channels */
+	boost::scoped_array<BaseType> _gainStatistics; /**< mean power of each channel, nchannels x nBins */
+
+	/**
+	   * @brief Decisions of the current frame, one value per bin (1 if masked).
+	   */
+	boost::scoped_array<unsigned char> _spatialMask;
+	boost::scoped_array<unsigned char> _temporalMask;
+	boost::scoped_array<BaseType> _bandGains; /**< gain applied to each bin, nchannels x nBins */
+
 	/**
 	   * Deprecated
 	   ***/
@@ -202,30 +242,26 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	double normaliseCorrelation(BaseType* left, BaseType *right, int length);
 
 	/**
-	   * @brief Decides whethe the time-frequency bin has to be masked or not
-	   * acording to spatial information.
-	   * @param left  left channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param right  right channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param length  length of left and right buffers
-	   * @param bin  bin to which the given signal corresponds.
-	   * @return  true if the bin has to be masked.
+	   * @brief Masks the frames of both channels with the gammatone filter bank (GAMMATONE_IIR).
+	   * The decisions are the same as with stored bands, but they are taken from the band energies
+	   * and the masking is applied as a gain per band when the frame is filtered again.
+	   * Only the hop that is new in the unwindowed frames is filtered, and the result is appended
+	   * to _gammatoneOutput.
+	   */
+	void processGammatoneFrames(BaseType *left, BaseType *right);
+
+	/**
+	   * @brief Updates the memory of the temporal masking and takes the masking decisions and the
+	   * gains of all the bins at once, from the statistics in _bandPower, _bandCorrelation and
+	   * _gainStatistics. Fills _spatialMask, _temporalMask and _bandGains.
 	   */
-	inline bool spatialMasking(BaseType *left, BaseType *right, int length, int bin);
+	void calculateMask();
 
 	/**
-	   * @brief Decides whethe the time-frequency bin has to be masked or not
-	   * acording to temporal information.
-	   * @param left  left channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param right  right channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param length  length of left and right buffers
-	   * @param bin  bin to which the given signal corresponds.
-	   * @return  true if the bin has to be masked.
+	   * @brief getBandCenterFrequency
+	   * @return the centre frequency of a bin in Hz, for the filter bank in use.
 	   */
-	inline bool temportalMasking(BaseType *left, BaseType *right, int length, int bin);
+	double getBandCenterFrequency(int bin) const;
 
 	/**
 	   * @brief Calculate the power (linear scale) for te specified frame
@@ -237,47 +273,11 @@ class BinauralMaskingImpl : public dsp::ShortTimeProcess
 	inline BaseType getFramePower(BaseType *left, BaseType *right, int length);
 
 	/**
-	   * @brief Executed a masking method over the given frame
-	   * @param frame  signal buffer
-	   * @param length  length of frame
-	   * @param factor  factor to be applied to the frame. This paramters is only used
-	   * if the specified method used a given factor.
-	   * @param bin  bin at which the given signal belongs to.
-	   */
-	inline void maskFrame(BaseType *frame, int length, float factor, int bin);
-
-
-	/**
-	   * @brief Enhance a frame in the case it is not rejected by
-	   * multiplying it by a factor (has to be greater than one)
-	   * @param frame  signal buffer
-	   * @param length   length of the buffer
-	   */
-	inline void enhanceFrame(BaseType *frame, int length);
-
-	/**
-	   * @brief Sets the frame buffer to zero.
-	   * @param frame frame buffer
-	   * @param length   length of the buffer
-	   */
-	void zeroFrame(BaseType *frame, int length);
-
-	/**
-	   * @brief Multiplies the frame by a factor that is calculated
-	   * as reported by Kim et al. (2011).
-	   * @param frame buffer frame
-	   * @param length  legth of the buffer
-	   * @param bin  time-frequency bin the signal belongs to.
-	   */
-	void maskFrameByScaling(BaseType *frame, int length, int bin);
-
-	/**
-	   * @brief Divides the signal frame by the supplied factor
-	   * @param frame  frame signal buffer
+	   * @brief Calculate the mean power (1/N)*sum_n(frame[n]^2) of a single channel
+	   * @param frame  channel buffer
 	   * @param length  length of the buffer
-	   * @param factor  factor by whish the signal is divided
 	   */
-	void maskFrameByFactor(BaseType *frame, int length, float factor);
+	inline BaseType getMeanPower(BaseType *frame, int length);
 
 	/**
 	   * @brief Calculates the normalised correlation thresholds for spatial
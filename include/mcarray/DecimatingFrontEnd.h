@@ -0,0 +1,136 @@
+/*
+* DecimatingFrontEnd.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_DECIMATINGFRONTEND_H_
+#define __MCA_DECIMATINGFRONTEND_H_
+
+#include <mcarray/mcadefs.h>
+#include <mcarray/ArrayDescription.h>
+
+#include <dspone/rt/ShortTimeAnalysis.h>
+
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The DecimatingFrontEnd class reduces the sample rate of a multichannel signal by an
+ * integer factor M before passing it to a set of analysers (i.e. localisation modules).
+ *
+ * Localisation only uses the band below the spatial aliasing frequency of the array
+ * (ArrayDescription::getBandwidth()), which is a small part of the spectrum at 44.1 or 48 kHz.
+ * Analysers created with getOutputSampleRate() work with FFTs M times shorter, and their delays
+ * in samples, which are already fractional, are evaluated at the reduced rate.
+ *
+ * The anti-aliasing filter is a Blackman-windowed sinc of _tapsPerPhase*M+1 taps with its cut-off
+ * at the output Nyquist frequency fs/(2M), and only one of every M outputs is computed,
+ * which is the cost of its polyphase form: _tapsPerPhase multiplications per input sample and channel.
+ * Blocks of any length can be processed, the filter keeps its history between calls.
+ * The output is delayed getDelay() input samples.
+ * SoundLocalisation places one in front of its localisation when it is asked to decimate.
+ */
+class DecimatingFrontEnd
+{
+    public:
+	/**
+	   * @brief DecimatingFrontEnd  with the lowest rate adequate for the bandwidth of the array.
+	   * @param sampleRate  sample rate of the input signal.
+	   * @param microphones  description of the array, one channel per microphone.
+	   */
+	DecimatingFrontEnd(int sampleRate, const ArrayDescription &microphones);
+
+	/**
+	   * @brief DecimatingFrontEnd
+	   * @param sampleRate  sample rate of the input signal.
+	   * @param nchannels  number of channels.
+	   * @param factor  decimation factor M (1 to pass the signal as it is).
+	   */
+	DecimatingFrontEnd(int sampleRate, unsigned int nchannels, int factor);
+	virtual ~DecimatingFrontEnd(){}
+
+	/**
+	   * @brief chooseFactor
+	   * @return the largest factor M that divides the sample rate and keeps [0, bandwidth] within the
+	   * passband of the filter (_passbandFraction of the output Nyquist frequency), at least 1.
+	   */
+	static int chooseFactor(int sampleRate, double bandwidth);
+
+	/**
+	   * @brief addAnalyser  adds a module that analyses the decimated signal. It has to be created
+	   * with getOutputSampleRate() and the same number of channels. Analysers are not owned.
+	   */
+	void addAnalyser(dsp::ShortTimeAnalysis *analyser);
+
+	/**
+	   * @brief process  decimates a block of samples and passes it to all the analysers.
+	   * @param input  one buffer per channel.
+	   * @param length  number of samples per channel.
+	   * @return number of decimated samples passed to the analysers.
+	   */
+	int process(const std::vector<double*> &input, int length);
+
+	/**
+	   * @brief decimate  decimates a block of samples.
+	   * @param input  one buffer per channel.
+	   * @param length  number of samples per channel.
+	   * @param output  one buffer per channel of at least getMaxOutputLength(length) samples.
+	   * @return number of samples written in the output.
+	   */
+	int decimate(const std::vector<double*> &input, int length, std::vector<double*> &output);
+
+	inline int getFactor() const {return _factor;}
+	inline int getSampleRate() const {return _sampleRate;}
+	inline int getOutputSampleRate() const {return _sampleRate/_factor;}
+	inline unsigned int getNumberOfChannels() const {return _nchannels;}
+	inline int getMaxOutputLength(int length) const {return (length + _factor - 1)/_factor;}
+	/**
+	   * @brief getDelay
+	   * @return group delay of the filter, in input samples.
+	   */
+	inline int getDelay() const {return _ntaps/2;}
+
+    private:
+	static constexpr int _tapsPerPhase = 32; /**< taps of the filter per output sample */
+	static constexpr double _passbandFraction = 0.8; /**< fraction of the output Nyquist frequency kept free of aliasing */
+
+	const int _sampleRate; /**< sample rate of the input */
+	const unsigned int _nchannels; /**< number of channels */
+	const int _factor; /**< decimation factor */
+	const int _ntaps; /**< length of the filter */
+	SignalPtr _taps; /**< filter taps, in reverse order */
+	SignalVector _history; /**< last ntaps-1 input samples followed by the current block, per channel */
+	int _historyCapacity; /**< number of samples _history can hold */
+	int _phase; /**< position of the next output sample in the following block */
+	SignalVector _decimated; /**< decimated block passed to the analysers */
+	std::vector<double*> _decimatedPtrs; /**< pointers to _decimated */
+	int _decimatedCapacity; /**< number of samples _decimated can hold */
+	std::vector<dsp::ShortTimeAnalysis*> _analysers; /**< modules working at the output rate */
+
+	/**
+	   * @brief designFilter  computes the taps of the anti-aliasing filter.
+	   */
+	void designFilter();
+};
+
+}
+
+#endif // __MCA_DECIMATINGFRONTEND_H_
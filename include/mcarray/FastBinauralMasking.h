@@ -23,6 +23,9 @@
 #define __FAST_BINAURALMASKING_H
 
 #include <mcarray/ArrayModules.h>
+#include <mcarray/SpectralFrontEnd.h>
+#include <mcarray/MaskStream.h>
+#include <mcarray/ArrayDescription.h>
 #include <dspone/algorithm/gralCrossCorrelation.h>
 #include <dspone/rt/ShortTimeFourierTransform.h>
 #include <dspone/filter/FilterBank.h>
@@ -50,31 +53,93 @@ namespace mca {
 	*
 	* Use use a mel-scaled filter bank instead of a gammtone filterbank.
 	*
+	* With more than two microphones, the spectrum of each channel is decomposed in bands once, and
+	* the energy of each band and channel is shared by all the pairs of microphones it belongs to.
+	* Spatial masking compares the mean normalised correlation of a set of pairs (nearest neighbours
+	* by default) with the mean of their thresholds, temporal masking uses the power of the average
+	* of all the channels, and the resulting mask is applied to every channel. With nearest-neighbour
+	* pairs the cost grows linearly with the number of channels.
+	*
 	**/
 
-class FastBinauralMasking : public dsp::STFT
+class FastBinauralMasking : public dsp::STFT, public SpectrumProcessor
 {
     public:
 
 	typedef BinauralMasking::MaskingMethod MaskingMethod;
 	typedef BinauralMasking::MaskingAlg MaskingAlg;
+	typedef std::pair<ArrayDescription::ElementId, ArrayDescription::ElementId> MicrophonePair;
+
+	/**
+	   * @brief The Config struct holds the parameters that trade latency and resolution against CPU.
+	   * Shorter frames lower the latency, longer frames and fewer bins lower the CPU load.
+	   */
+	struct Config {
+	    explicit Config(float frameRate = _frameRate) :
+		frameRate(frameRate), fftOrder(0), nBins(_defaultNumBins), maskStreamCapacity(0), maskOnly(false) {}
+
+	    float frameRate; /**< frame rate in seconds, used to derive the FFT order if fftOrder is not set */
+	    int fftOrder; /**< order of the FFT, 0 to derive it from frameRate */
+	    int nBins; /**< number of bands of the mel-scaled filter bank */
+	    int maskStreamCapacity; /**< number of frames of the mask stream, 0 not to publish the masks (see getMaskStream) */
+	    bool maskOnly; /**< only compute the masks: the spectrum is not modified and no signal is synthesised */
+	    std::vector<MicrophonePair> pairs; /**< pairs of microphones used by spatial masking, empty for nearest neighbours */
+
+	    /**
+	       * @brief getFFTOrder  returns fftOrder, or the order derived from the frame rate if it is not set.
+	       */
+	    int getFFTOrder(int sampleRate) const;
+	};
 
 	/**
 	   * @brief FastBinauralMasking constructor
-	   * @param nchannels  number of channels to be process
-	   * (currently Binaural Masking only accepts two input channels, otherwise
-	   * it would not be binaural! )
+	   * Processes two channels, see the constructor with an ArrayDescription for more microphones.
 	   * @param samplerate
 	   * @param microDistance  distance between the microphones in metres
 	   * @param mmethod  set the masking method used
+	   * @param frameRate  frame rate in seconds, to work with the frames of a SpectralFrontEnd.
+	   * The memory of the temporal masking is adapted to keep the same time constant.
+	   */
+	FastBinauralMasking(int samplerate,
+			    double microDistance,
+			    float lowFreq,
+			    float highFreq,
+			    MaskingMethod mmethod = BinauralMasking::RELATIVE,
+			    MaskingAlg algorithm = BinauralMasking::BOTH,
+			    float frameRate = _frameRate);
+
+	/**
+	   * @brief FastBinauralMasking constructor with a runtime configuration.
+	   * @param config  frame rate, FFT order and number of bands to use.
 	   */
 	FastBinauralMasking(int samplerate,
 			    double microDistance,
 			    float lowFreq,
 			    float highFreq,
+			    const Config &config,
+			    MaskingMethod mmethod = BinauralMasking::RELATIVE,
+			    MaskingAlg algorithm = BinauralMasking::BOTH);
+
+	/**
+	   * @brief FastBinauralMasking constructor for an array of microphones, one channel per microphone.
+	   * @param microphones  positions of the microphones (at least two).
+	   * @param config  frame rate, FFT order, number of bands and pairs of microphones to use.
+	   */
+	FastBinauralMasking(int samplerate,
+			    const ArrayDescription &microphones,
+			    float lowFreq,
+			    float highFreq,
+			    const Config &config,
 			    MaskingMethod mmethod = BinauralMasking::RELATIVE,
 			    MaskingAlg algorithm = BinauralMasking::BOTH);
 
+	/**
+	   * @brief getNearestNeighbourPairs
+	   * @return the pairs made of each microphone and the closest ones to it (up to _neighbourTolerance
+	   * times the distance to the nearest one), without repetitions.
+	   */
+	static std::vector<MicrophonePair> getNearestNeighbourPairs(const ArrayDescription &microphones);
+
 	/**
 	   * @brief Processes the analysis buffers and changes the time-frequency bins stored in the analysis buffer
 	   * accoording to the implemented algorithm. Performes the masking itself.
@@ -82,6 +147,11 @@ class FastBinauralMasking : public dsp::STFT
 	virtual void processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
 					    std::vector<double*> &dataChannels, int dataLength);
 
+	/**
+	   * @brief processSpectrum  Masks a spectrum computed by a SpectralFrontEnd and writes the result in outputFrames.
+	   */
+	virtual void processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames);
+
 	/**
 	   * @brief getNonMaskingAngle
 	   * @return the angle in degrees for the region where signal is accepted.
@@ -89,9 +159,14 @@ class FastBinauralMasking : public dsp::STFT
 	inline int getNonMaskingAngle(){return _phi*180*M_1_PI;}
 	/**
 	   * @brief getMicroPhoneDistance
-	   * @return returns the distance between microphones in metres.
+	   * @return returns the distance between the microphones of the first pair in metres.
+	   */
+	inline float getMicroPhoneDistance(){return _pairDistances[0];}
+	/**
+	   * @brief getMicrophonePairs
+	   * @return the pairs of microphones used by spatial masking.
 	   */
-	inline float getMicroPhoneDistance(){return _microDistance;}
+	inline const std::vector<MicrophonePair> &getMicrophonePairs() const {return _pairs;}
 	/**
 	   * @brief getSpatialMaskingFactor
 	   * @return  the factor used for spatial masking in the FACTOR masking method
@@ -102,16 +177,61 @@ class FastBinauralMasking : public dsp::STFT
 	   * @return the factor used for temporal masking in the FACTOR masking method
 	   */
 	inline float getTemporalMaskingFactor(){return 1/_temporalMaskingFactor;}
+	/**
+	   * @brief getNumberOfBins
+	   * @return the number of bands of the filter bank.
+	   */
+	inline int getNumberOfBins() const {return _nBins;}
+	/**
+	   * @brief getFrameForgetingFactor
+	   * @return forgetting factor of the temporal masking, adapted to the hop in use.
+	   */
+	inline float getFrameForgetingFactor() const {return _frameForgetingFactor;}
+	/**
+	   * @brief getBandGains
+	   * @return the gain applied to each bin of a channel in the last frame (getNumberOfBins() values).
+	   */
+	inline const BaseType *getBandGains(int channel) const {return &_bandGains[channel*_nBins];}
+	/**
+	   * @brief getSpatialMask
+	   * @return for each bin, 1 if it was masked by spatial masking in the last frame.
+	   */
+	inline const unsigned char *getSpatialMask() const {return _spatialMask.get();}
+	/**
+	   * @brief getTemporalMask
+	   * @return for each bin, 1 if it was masked by temporal masking in the last frame.
+	   * Spatial masking takes precedence: a bin can be set in both masks.
+	   */
+	inline const unsigned char *getTemporalMask() const {return _temporalMask.get();}
+	/**
+	   * @brief getMaskStream
+	   * @return the stream where the mask of every frame is published, or NULL if
+	   * Config::maskStreamCapacity was 0. Frames are timed by their number times the window shift.
+	   */
+	inline MaskStream *getMaskStream() {return _maskStream.get();}
+	/**
+	   * @brief isMaskOnly
+	   * @return true if only the masks are computed (see Config::maskOnly).
+	   */
+	inline bool isMaskOnly() const {return _maskOnly;}
+
+    protected:
+	/**
+	   * @brief frameSynthesis  In mask-only mode the inverse FFT is skipped and a silent frame is
+	   * output, otherwise the frame is synthesised as usual.
+	   */
+	virtual void frameSynthesis(BaseType *outFrame, BaseType *analysis, int frameLength, int analysisLength, int channel);
 
     private:
 
 	/**
 	   * @brief Parameters of the algorithm
 	   */
-	static constexpr  int _nBins = 45;
+	static constexpr  int _defaultNumBins = 45; // see Config
 	static constexpr float _frameRate = 0.050; // in secods, will be windowShift and half of windowSize
 	static constexpr double _phi = 10*M_PI/180; // Degrees to radians
 	static constexpr float _forgetingFactor = 0.04; // necessary for memory in temporal masking
+	static constexpr double _neighbourTolerance = 1.05; // microphones up to 5% further than the nearest one are also neighbours
 
 	// Parameters for FACTOR method
 	static constexpr float _temporalMaskingFactor=3;  // Masked signal is divided by this factor (3 ~ -10dB)
@@ -132,7 +252,9 @@ class FastBinauralMasking : public dsp::STFT
 	   * Configuration parameters
 	   **/
 	const int _sampleRate;
-	const double _microDistance;
+	const ArrayDescription _microphones; /**< position of the microphone of each channel */
+	const std::vector<MicrophonePair> _pairs; /**< pairs of microphones used by spatial masking */
+	std::vector<double> _pairDistances; /**< distance between the microphones of each pair */
 	const MaskingMethod _mmethod;
 	const MaskingAlg _algorithm;
 	// Pre filter parameters
@@ -142,8 +264,13 @@ class FastBinauralMasking : public dsp::STFT
 	const int _fftOrder;
 	const int _oneSidedFFTLength;
 	const int _windowSize;
+	const int _nBins; /**< number of bands of the filter bank */
+	const float _frameForgetingFactor; /**< _forgetingFactor adapted to the hop of the FFT order in use */
+	const bool _maskOnly; /**< see Config::maskOnly */
 
 	int _firstCall;
+	unsigned long _frameIndex; /**< number of the current frame since the beginning of the stream */
+	std::unique_ptr<MaskStream> _maskStream; /**< masks published for other modules (may be null) */
 
 	//          boost::scoped_ptr<GeneralisedCrossCorrelation> _gcc;
 
@@ -154,10 +281,16 @@ class FastBinauralMasking : public dsp::STFT
 	std::unique_ptr<dsp::FilterBank> _filterBank;
 	int _coeficientsLength;
 	boost::scoped_array<BaseTypeC> _filterCoeficients;
-	boost::scoped_array<BaseType> _fftLeftFrame;
-	boost::scoped_array<BaseType> _fftRightFrame;
-	boost::scoped_array<BaseType> _outLeftFrame;
-	boost::scoped_array<BaseType> _outRightFrame;
+	boost::scoped_array<BaseType> _filterResponses; /**< real response H_b of each band, nBins x oneSidedFFTLength */
+	boost::scoped_array<BaseType> _bandFrames; /**< spectrum of the current band for each channel, nchannels x analysisLength */
+	boost::scoped_array<BaseType> _mixedFrame; /**< spectrum of the current band averaged over the channels */
+	boost::scoped_array<BaseType> _channelEnergies; /**< mean |X_c*H_b|^2 of the current band for each channel */
+
+	/**
+	   * @brief Real gain of each FFT bin, sum_b(g_b*H_b), for each channel (nchannels x oneSidedFFTLength).
+	   * It applies the gains of all the bands to the spectrum with a single product.
+	   */
+	boost::scoped_array<BaseType> _spectralGains;
 
 
 
@@ -175,10 +308,24 @@ class FastBinauralMasking : public dsp::STFT
 
 	/**
 	   * @brief Normalised correlation thresholds for accptance/rejection
-	   * in spatial masking.
+	   * in spatial masking, averaged over the pairs of microphones.
 	   */
 	std::vector<double> _thresholds;
 
+	/**
+	   * @brief Statistics of the current frame, one value per bin, measured before any decision is taken.
+	   */
+	boost::scoped_array<BaseType> _bandPower; /**< P[m], power of the averaged channels */
+	boost::scoped_array<BaseType> _bandCorrelation; /**< normalised correlation between channels, averaged over the pairs */
+	boost::scoped_array<BaseType> _gainStatistics; /**< statistic of the gain of each channel: getEnergy() for RELATIVE and getPower() for NOISY, nchannels x nBins */
+
+	/**
+	   * @brief Decisions of the current frame, one value per bin (1 if masked).
+	   */
+	boost::scoped_array<unsigned char> _spatialMask;
+	boost::scoped_array<unsigned char> _temporalMask;
+	boost::scoped_array<BaseType> _bandGains; /**< gain applied to each bin, nchannels x nBins */
+
 	/**
 	   * Deprecated
 	   ***/
@@ -193,42 +340,13 @@ class FastBinauralMasking : public dsp::STFT
 	   */
 	double normaliseCorrelation(BaseType* left, BaseType *right, int length);
 	double normaliseFFTCorrelation(BaseType* left, BaseType *right, int length);
-	double generalisedCrossCorrelation(BaseType* left, BaseType *right, int length);
-
-	/**
-	   * @brief Decides whethe the time-frequency bin has to be masked or not
-	   * acording to spatial information.
-	   * @param left  left channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param right  right channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param length  length of left and right buffers
-	   * @param bin  bin to which the given signal corresponds.
-	   * @return  true if the bin has to be masked.
-	   */
-	inline bool spatialMasking(BaseType *left, BaseType *right, int length, int bin);
-
 	/**
-	   * @brief Decides whethe the time-frequency bin has to be masked or not
-	   * acording to temporal information.
-	   * @param left  left channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param right  right channel signal corresponding to the filterd singal in
-	   * the specified bin.
-	   * @param length  length of left and right buffers
-	   * @param bin  bin to which the given signal corresponds.
-	   * @return  true if the bin has to be masked.
+	   * @brief Same as normaliseFFTCorrelation, with the energies of the channels already computed.
+	   * @param leftEnergy  getEnergy() of the left channel.
+	   * @param rightEnergy  getEnergy() of the right channel.
 	   */
-	inline bool temportalMasking(BaseType *left, BaseType *right, int length, int bin);
-
-	/**
-	   * @brief Calculate the power (linear scale) for the specified frame
-	   * @param left  left channel buffer
-	   * @param right  right channel buffer
-	   * @param length  length of the buffers
-	   * @return the power of the averaged channels
-	   */
-	inline BaseType getFramePower(BaseType *left, BaseType *right, int length);
+	double normaliseFFTCorrelation(BaseType* left, BaseType *right, BaseType leftEnergy, BaseType rightEnergy);
+	double generalisedCrossCorrelation(BaseType* left, BaseType *right, int length);
 
 	/**
 	   * @brief getFRamePower  same as previous function but for a single channel
@@ -239,59 +357,22 @@ class FastBinauralMasking : public dsp::STFT
 	inline BaseType getPower(BaseType *frame, int length);
 
 	/**
-	   * @brief Executed a masking method over the given frame
-	   * @param frame  signal buffer
-	   * @param length  length of frame
-	   * @param factor  factor to be applied to the frame. This paramters is only used
-	   * if the specified method used a given factor.
-	   * @param bin  bin at which the given signal belongs to.
+	   * @brief getEnergy  (1/N)*sum_k(|frame[k]|^2) over the one-sided spectrum.
+	   * It is the statistic of the RELATIVE method and the normalisation of the correlations.
+	   * @param frame  one-sided spectrum of the band, it is not modified
 	   */
-	inline void maskFrame(BaseType *frame, int length, float factor, int bin);
-
+	BaseType getEnergy(BaseType *frame);
 
 	/**
-	   * @brief Enhance a frame in the case it is not rejected by
-	   * multiplying it by a factor (has to be greater than one)
-	   * @param frame  signal buffer
-	   * @param length   length of the buffer
-	   */
-	inline void enhanceFrame(BaseType *frame, int length);
-
-	/**
-	   * @brief Sets the frame buffer to zero.
-	   * @param frame frame buffer
-	   * @param length   length of the buffer
-	   */
-	void zeroFrame(BaseType *frame, int length);
-
-	/**
-	   * @brief Sets the frame buffer to ******************
-	   * @param frame frame buffer
-	   * @param length   length of the buffer
-	   * @param bin  bin at which the given signal belongs to
-	   */
-	void noisyFrame(BaseType *frame, int length, int bin);
-
-	/**
-	   * @brief Multiplies the frame by a factor that is calculated
-	   * as reported by Kim et al. (2011).
-	   * @param frame buffer frame
-	   * @param length  legth of the buffer
-	   * @param bin  time-frequency bin the signal belongs to.
-	   */
-	void maskFrameByScaling(BaseType *frame, int length, int bin);
-
-	/**
-	   * @brief Divides the signal frame by the supplied factor
-	   * @param frame  frame signal buffer
-	   * @param length  length of the buffer
-	   * @param factor  factor by whish the signal is divided
+	   * @brief Updates the memory of the temporal masking and takes the masking decisions and the
+	   * gains of all the bins at once, from the statistics in _bandPower, _bandCorrelation and
+	   * _gainStatistics. Fills _spatialMask, _temporalMask and _bandGains.
 	   */
-	void maskFrameByFactor(BaseType *frame, int length, float factor);
+	void calculateMask();
 
 	/**
 	   * @brief Calculates the normalised correlation thresholds for spatial
-	   * masking and stores them in _thresholds
+	   * masking, averaged over the pairs, and stores them in _thresholds
 	   */
 	void calculateThresholds();
 
@@ -0,0 +1,148 @@
+/*
+* GammatoneFilterBank.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_GAMMATONEFILTERBANK_H_
+#define __MCA_GAMMATONEFILTERBANK_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The GammatoneFilterBank class is a time-domain filter bank of ERB-spaced bands between
+ * lowFreq and highFreq. Each band is a cascade of _order complex one-pole resonators
+ *
+ *    y[n] = p_b*y[n-1] + (1-|p_b|)*x[n],   p_b = e^{-2*pi*B_b/fs} * e^{j*2*pi*f_b/fs}
+ *
+ * which has the impulse response of an all-pole gammatone of centre frequency f_b and bandwidth
+ * B_b = 1.019*ERB(f_b), and unit gain at f_b. The real band signal is 2*Re{y}.
+ *
+ * Bands have different group delays, and adding them up as they are cancels most of the signal
+ * between centre frequencies. As proposed by Hohmann (2002), the impulse response of each band is
+ * delayed so that its envelope peaks _synthesisDelay seconds after the input (or as close as
+ * possible for the narrow bands that peak later), and rotated so that it is real at that time.
+ * The output of synthesise() is therefore delayed by _synthesisDelay.
+ *
+ * Bands are filtered sample by sample, all of them at once (one SIMD lane per band), so the band
+ * signals are never stored: analyse() only keeps their energies and synthesise() adds them up
+ * weighted by a gain per band as they are produced. A frame is therefore filtered twice, once to
+ * measure it and once to rebuild it, with a state of a few values per band instead of a buffer.
+ *
+ * The bank is a streaming filter: the analysis and the synthesis of each channel keep their own
+ * resonator state and delay line from one call to the next, so consecutive blocks must be
+ * consecutive samples of the signal, and splitting a signal in blocks gives the same result as
+ * filtering it at once. reset() restarts every path from rest.
+ */
+class GammatoneFilterBank
+{
+    public:
+	/**
+	   * @brief GammatoneFilterBank
+	   * @param sampleRate  sampling rate in Hz.
+	   * @param nbands  number of bands.
+	   * @param lowFreq  centre frequency of the first band in Hz.
+	   * @param highFreq  centre frequency of the last band in Hz.
+	   */
+	GammatoneFilterBank(int sampleRate, int nbands, float lowFreq, float highFreq);
+	virtual ~GammatoneFilterBank(){}
+
+	/**
+	   * @brief analyse  filters the next block of a binaural signal and measures the energy of the bands.
+	   * @param left  left channel block.
+	   * @param right  right channel block.
+	   * @param length  number of samples of each channel.
+	   * @param leftEnergy  sum_n l_b[n]^2 for each band.
+	   * @param rightEnergy  sum_n r_b[n]^2 for each band.
+	   * @param crossEnergy  sum_n l_b[n]*r_b[n] for each band.
+	   */
+	void analyse(const BaseType *left, const BaseType *right, int length,
+		     BaseType *leftEnergy, BaseType *rightEnergy, BaseType *crossEnergy);
+
+	/**
+	   * @brief synthesise  filters the next block of a channel and adds up its bands scaled by the given gains.
+	   * With unit gains the output is the input restricted to [lowFreq, highFreq].
+	   * @param input  input block.
+	   * @param gains  gain of each band.
+	   * @param length  number of samples.
+	   * @param output  output block, it can be the input buffer.
+	   * @param channel  channel of the signal (0 or 1), each one has its own state.
+	   */
+	void synthesise(const BaseType *input, const BaseType *gains, int length, BaseType *output, int channel = 0);
+
+	/**
+	   * @brief reset  clears the state of the resonators and the delay lines of all the paths.
+	   */
+	void reset();
+
+	inline int getNumberOfBands() const {return _nbands;}
+	/**
+	   * @brief getCenterFrequency
+	   * @return centre frequency of a band in Hz.
+	   */
+	inline double getCenterFrequency(int band) const {return _centerFrequencies[band];}
+	/**
+	   * @brief getDelay
+	   * @return delay in samples of the output of synthesise().
+	   */
+	inline int getDelay() const {return _delayLength - 1;}
+	/**
+	   * @brief getStateSize
+	   * @return size in bytes of the filter state and scratch buffers.
+	   */
+	size_t getStateSize() const;
+
+	static constexpr int _order = 4; /**< number of resonators of each band */
+	static constexpr double _synthesisDelay = 0.005; /**< delay in seconds at which the bands are aligned */
+	static constexpr int _nchannels = 2; /**< number of channels, analysed together and synthesised apart */
+
+    private:
+	const int _sampleRate;
+	const int _nbands;
+	SignalPtr _centerFrequencies; /**< centre frequency of each band in Hz */
+	SignalPtr _poleRe; /**< real part of the pole of each band */
+	SignalPtr _poleIm; /**< imaginary part of the pole of each band */
+	SignalPtr _inputGainRe; /**< real part of the input gain of the first resonator, (1-|p_b|) rotated to align the band */
+	SignalPtr _inputGainIm; /**< imaginary part of the input gain of the first resonator */
+	SignalPtr _gain; /**< input gain of the other resonators, 1-|p_b| */
+	std::vector<int> _delays; /**< delay in samples of each band in the synthesis */
+	const int _delayLength; /**< number of samples kept by the delay line */
+	SignalPtr _delayLine; /**< last _delayLength samples of each band, stored by sample, one line per channel */
+	int _delayPosition[_nchannels]; /**< slot of the next sample in the delay line of each channel */
+	SignalPtr _stateRe; /**< real part of the analysis resonator outputs, _order x 2 channels x nbands */
+	SignalPtr _stateIm; /**< imaginary part of the analysis resonator outputs, _order x 2 channels x nbands */
+	SignalPtr _synthesisStateRe; /**< real part of the synthesis resonator outputs, 2 channels x _order x nbands */
+	SignalPtr _synthesisStateIm; /**< imaginary part of the synthesis resonator outputs, 2 channels x _order x nbands */
+	SignalPtr _bands; /**< band signals of the current sample, 2 channels x nbands */
+	BaseType _synthesisGain; /**< normalises the sum of the bands to unit gain */
+
+	/**
+	   * @brief calculateSynthesisGain  computes _synthesisGain from the mean response of the
+	   * sum of the aligned bands at their centre frequencies.
+	   */
+	void calculateSynthesisGain();
+};
+
+}
+
+#endif // __MCA_GAMMATONEFILTERBANK_H_
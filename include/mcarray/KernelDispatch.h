@@ -0,0 +1,120 @@
+/*
+* KernelDispatch.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_KERNELDISPATCH_H_
+#define __MCA_KERNELDISPATCH_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <string>
+
+namespace mca
+{
+
+/**
+ * @brief The KernelDispatch class selects, once per process, the variant of the hot kernels
+ * built for the best instruction set supported by the CPU. All the variants are compiled from
+ * the same source with a different target, so the library runs on any x86-64 host while using
+ * AVX2 or AVX-512 where available.
+ * The environment variable MCARRAY_SIMD (scalar, sse4, avx2 or avx512) forces a lower instruction
+ * set, which is useful to test the fallbacks on a single host.
+ *
+ * Reductions are split in _lanes independent partial sums, so results of different variants
+ * only differ in rounding.
+ * Kernels working on complex values take them in split layout (see SplitSpectrum), real and
+ * imaginary parts in separate vectors.
+ */
+class KernelDispatch
+{
+    public:
+
+	/**
+	   * This type identifies the instruction set the kernels are built for, in increasing order.
+	   **/
+	typedef enum {SCALAR=0, SSE4=1, AVX2=2, AVX512=3} InstructionSet;
+
+	/**
+	   * @brief The Kernels struct holds the functions of one variant.
+	   */
+	struct Kernels {
+	    InstructionSet instructionSet;
+	    /** sum_k x[k]^2 */
+	    BaseType (*energy)(const BaseType *x, int length);
+	    /** sum_k filter[k]^2*(|left[k]|^2 + |right[k]|^2) */
+	    BaseType (*filteredEnergy)(const BaseTypeC *left, const BaseTypeC *right, const BaseType *filter, int length);
+	    /** y[k] += a[k]*b[k] */
+	    void (*splitMultiplyAccumulate)(const BaseType *aRe, const BaseType *aIm, const BaseType *bRe, const BaseType *bIm,
+					    int length, BaseType *yRe, BaseType *yIm);
+	    /** y[k] += a*b[k], a complex scalar */
+	    void (*splitScaleAccumulate)(BaseType aRe, BaseType aIm, const BaseType *bRe, const BaseType *bIm,
+					 int length, BaseType *yRe, BaseType *yIm);
+	    /** cosSum = sum_k re[k]*cosine[k] and sinSum = sum_k im[k]*sine[k], the GCC for one delay is cosSum - sinSum */
+	    void (*splitCorrelation)(const BaseType *re, const BaseType *im, const BaseType *cosine, const BaseType *sine,
+				     int length, BaseType *cosSum, BaseType *sinSum);
+	    /** splitCorrelation in float32 */
+	    void (*splitCorrelation32)(const BaseType32 *re, const BaseType32 *im, const BaseType32 *cosine, const BaseType32 *sine,
+				       int length, BaseType32 *cosSum, BaseType32 *sinSum);
+	    /** advances nchannels x nbands cascades of stages complex one-pole resonators y = pole*y + gain*x by one real
+		sample per channel, the first stage takes a complex inputGain and the others the real gain. Lanes are stored
+		by channel and band and the state by stage, output = 2*Re{y} of the last stage */
+	    void (*resonatorCascade)(const BaseType *input, int nchannels, int nbands, int stages, const BaseType *poleRe,
+				     const BaseType *poleIm, const BaseType *inputGainRe, const BaseType *inputGainIm,
+				     const BaseType *gain, BaseType *stateRe, BaseType *stateIm, BaseType *output);
+	};
+
+	/**
+	   * @brief get
+	   * @return kernels selected for this process.
+	   */
+	static const Kernels &get();
+
+	/**
+	   * @brief get  kernels of a given instruction set.
+	   * Throws MCArrayException if the CPU does not support it.
+	   */
+	static const Kernels &get(InstructionSet instructionSet);
+
+	/**
+	   * @brief getSupportedInstructionSet
+	   * @return best instruction set supported by the CPU (and the build).
+	   */
+	static InstructionSet getSupportedInstructionSet();
+
+	static const char *getName(InstructionSet instructionSet);
+
+	/**
+	   * @brief parseInstructionSet  converts a name (as in MCARRAY_SIMD) to an instruction set.
+	   * Throws MCArrayException if the name is unknown.
+	   */
+	static InstructionSet parseInstructionSet(const std::string &name);
+
+	static constexpr int _lanes = 8; /**< number of independent partial sums of the reductions */
+
+    private:
+	/**
+	   * @brief select  chooses the instruction set from the CPU and the environment.
+	   */
+	static const Kernels &select();
+};
+
+}
+
+#endif // __MCA_KERNELDISPATCH_H_
@@ -0,0 +1,112 @@
+/*
+* MaskStream.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_MASKSTREAM_H_
+#define __MCA_MASKSTREAM_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <boost/scoped_array.hpp>
+
+namespace mca
+{
+
+/**
+ * @brief The MaskStream class is a ring buffer of time-frequency masks, allocated once at
+ * construction. Each frame holds, for every band, the binary decision (1 if the band is masked)
+ * and the soft gain applied to each channel, together with the number of the frame and its time.
+ *
+ * A masking module pushes one frame per hop and a consumer reads the frames from the oldest
+ * one and discards them when it is done. When the buffer is full the oldest frame is
+ * overwritten and counted as dropped, so the writer never waits nor allocates.
+ * The class is not thread-safe: frames have to be read between two calls of the writer.
+ */
+class MaskStream
+{
+    public:
+	/**
+	   * @brief MaskStream
+	   * @param nbins  number of bands of each mask.
+	   * @param nchannels  number of channels with a gain for each band.
+	   * @param capacity  number of frames that can be stored.
+	   */
+	MaskStream(int nbins, unsigned int nchannels, int capacity);
+	virtual ~MaskStream(){}
+
+	/**
+	   * @brief push  stores a frame, overwriting the oldest one if the buffer is full.
+	   * A band is masked if it is masked by any of the two masks.
+	   * @param index  number of the frame since the beginning of the stream.
+	   * @param timestamp  time of the frame in seconds.
+	   * @param spatialMask  1 for each band masked by spatial masking (nbins values).
+	   * @param temporalMask  1 for each band masked by temporal masking (nbins values).
+	   * @param gains  gain of each band for each channel (nchannels x nbins).
+	   */
+	void push(unsigned long index, double timestamp,
+		  const unsigned char *spatialMask, const unsigned char *temporalMask, const BaseType *gains);
+
+	/**
+	   * @brief discard  releases the oldest frames once they have been read.
+	   * @param nframes  number of frames to release, at most getNumberOfFrames().
+	   */
+	void discard(int nframes);
+
+	/**
+	   * @brief clear  releases all the frames.
+	   */
+	inline void clear() {discard(_nframes);}
+
+	/**
+	   * Access to the stored frames, frame 0 is the oldest one (0 <= frame < getNumberOfFrames()).
+	   */
+	inline unsigned long getIndex(int frame) const {return _indices[slot(frame)];}
+	inline double getTimestamp(int frame) const {return _timestamps[slot(frame)];}
+	inline const unsigned char *getMask(int frame) const {return &_masks[slot(frame)*_nbins];}
+	inline const BaseType *getGains(int frame, unsigned int channel) const {return &_gains[(slot(frame)*_nchannels + channel)*_nbins];}
+
+	inline int getNumberOfFrames() const {return _nframes;}
+	inline int getNumberOfBins() const {return _nbins;}
+	inline unsigned int getNumberOfChannels() const {return _nchannels;}
+	inline int getCapacity() const {return _capacity;}
+	/**
+	   * @brief getNumberOfDroppedFrames
+	   * @return number of frames overwritten before they were discarded.
+	   */
+	inline unsigned long getNumberOfDroppedFrames() const {return _droppedFrames;}
+
+    private:
+	const int _nbins; /**< number of bands of each mask */
+	const unsigned int _nchannels; /**< number of channels with gains */
+	const int _capacity; /**< maximum number of frames */
+	int _first; /**< slot of the oldest frame */
+	int _nframes; /**< number of stored frames */
+	unsigned long _droppedFrames; /**< number of frames overwritten before they were discarded */
+	boost::scoped_array<unsigned long> _indices; /**< number of the frame of each slot */
+	boost::scoped_array<double> _timestamps; /**< time of the frame of each slot */
+	boost::scoped_array<unsigned char> _masks; /**< binary mask of each slot, capacity x nbins */
+	boost::scoped_array<BaseType> _gains; /**< gains of each slot, capacity x nchannels x nbins */
+
+	inline int slot(int frame) const {return (_first + frame) % _capacity;}
+};
+
+}
+
+#endif // __MCA_MASKSTREAM_H_
@@ -26,10 +26,14 @@
 #include "BinauralLocalisation.h"
 
 #include <mcarray/microhponeArrayHelpers.h>
+#include <mcarray/TauMatrix.h>
+#include <mcarray/WorkerPool.h>
 
 #include <dspone/filter/FilterBank.h>
 #include <dspone/rt/ShortTimeFourierSubBand.h>
-#include <dspone/algorithm/gralCrossCorrelation.h>
+
+#include <memory>
+#include <vector>
 
 namespace mca {
 
@@ -38,7 +42,21 @@ class LocalisationCallback;
 class MultibandBinarualLocalisation : public SoundLocalisationImpl, public dsp::SubBandSTFTAnalysis
 {
     public:
-	MultibandBinarualLocalisation(int sampleRate, ArrayDescription microphonePositions, int nbins=15, bool userPowerFloor=1);
+	/**
+	   * @brief MultibandBinarualLocalisation
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the (two) microphones.
+	   * @param nbins  number of subbands.
+	   * @param userPowerFloor  use the estimated power floor to detect the presence of signal.
+	   * @param nthreads  number of threads used to process the subbands of a frame.
+	   * With 1 the subbands are processed sequentially in the calling thread, otherwise
+	   * each thread processes a fixed subset of subbands. The same subband energies and
+	   * correlations are computed in both cases, so the result does not depend
+	   * on the number of threads.
+	   * @param tauEvaluation  how the phase terms of the subband tau matrices are obtained.
+	   */
+	MultibandBinarualLocalisation(int sampleRate, ArrayDescription microphonePositions, int nbins=15, bool userPowerFloor=1, int nthreads=1,
+				      TauMatrix::Evaluation tauEvaluation=TauMatrix::TABLE);
 
     private:
 	static constexpr float _frameRate = 0.025;
@@ -54,33 +72,75 @@ class MultibandBinarualLocalisation : public SoundLocalisationImpl, public dsp::
 	const float _minFreq;
 	const float _maxFreq;
 	bool _usePowerFloor;
+	const TauMatrix::Evaluation _tauEvaluation; /**< how the phase terms of the subband tau matrices are obtained */
+	BaseType _framePower; /**< log power of the current frame */
+	bool _frameHasSignal; /**< the current frame has to be analysed (it exceeds the noise floor or it is not used) */
 	//	SoundSampleTypeVector _filteredSignals;
 	SignalPtr _binDOAs;
+	SignalPtr _binCorrelations; /**< maximum correlation of each subband in the current frame */
 	SignalPtr _energyInDOA;
 	SignalPtr _energies;
 	SignalPtr _magnitude;
 	SignalPtr _power;
-	SignalCPtr _correlations;
-	SignalPtr _correlationsReal;
 	SignalPtr _triangle;
 	SignalCPtr _mixedChannel;
 	SignalPtr _samplesDelay;
 	SignalVector _prevCorrelationsReal;
 
-	dsp::GeneralisedCrossCorrelation _gcc;
+	std::vector<std::shared_ptr<TauMatrix> > _subbandTauMatrices; /**< one precomputed tau matrix per subband, restricted to its frequency support */
+	SignalVector _subbandFilters; /**< coefficients of each subband filter over its support */
+
+	std::shared_ptr<WorkerPool> _workerPool; /**< threads processing the subbands, null if they are processed sequentially */
+	SignalVector _workerEnergyInDOA; /**< partial energy per DOA accumulated by each worker, merged in processSumamry */
+	SignalVector _workerCorrelations; /**< correlations of the current subband, one vector per worker */
+	std::vector<SignalVector> _workerSubbands; /**< both channels of the current subband once filtered, per worker */
+	std::vector<std::vector<double*> > _workerSubbandPtrs; /**< pointers to _workerSubbands */
+
+	/**
+	   * @brief generateSubbandTauMatrices  Finds the frequency support of each subband filter
+	   * and precomputes the phase terms of the DOA grid delays for those bins only.
+	   */
+	void generateSubbandTauMatrices();
+
+	/**
+	   * @brief processParametrisation  Processes the subbands directly from the full spectrum
+	   * (the tau matrices only use the support of each subband), in parallel when several
+	   * threads are used.
+	   */
+	virtual void processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
+					    std::vector<double*> &dataChannels, int dataLength);
 
 	virtual void processSetup(std::vector<double *> &analysisFrames, int analysisLength,
 				  std::vector<double *> &dataChannels, int dataLength);
-	void processOneSubband(const SignalVector &analysisFrame, int length, int bin);
+	/**
+	   * @brief processOneSubband  Processes one subband from the full spectra in the calling thread,
+	   * as the first worker does. Used when the subbands are processed sequentially.
+	   */
 	virtual void processOneSubband(std::vector<double*> &analysisFrame, int length, int bin);
 
 	virtual void processSumamry(std::vector<double *> &analysisFrames, int analysisLength,
 				    std::vector<double *> &dataChannels, int dataLength);
 
+	/**
+	   * @brief processSubband  Estimates the DOA of one subband and adds its energy to the
+	   * partial energy per DOA of the given worker.
+	   * @param left  one-sided spectrum of the left channel.
+	   * @param right  one-sided spectrum of the right channel.
+	   * @param energy  energy of the subband.
+	   * @param bin  subband index.
+	   * @param worker  index of the worker processing the subband.
+	   */
+	void processSubband(const BaseTypeC *left, const BaseTypeC *right, BaseType energy, int bin, int worker);
+
+	/**
+	   * @brief calculateSubbandPower  Power of both channels once filtered by the subband filter,
+	   * as dsp::SignalPower::FFTPower measures it. The filtered spectra are stored in the buffers of the worker.
+	   * @param analysisLength  length of the spectra in CCS format.
+	   */
+	BaseType calculateSubbandPower(const BaseTypeC *left, const BaseTypeC *right, int bin, int analysisLength, int worker);
+
 	BaseType calculateLinearPower(const BaseTypeC *left, const BaseTypeC *right, int length);
 	BaseType calculateLogPower(const BaseTypeC *left, const BaseTypeC *right, int length);
-	BaseType setPowerFloor(std::vector<double*> &analysisFrames, int analysisLength, int nchannels, int sampleRate);
-	BaseType setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate);
 
 
 	inline int angle2DOAidx(float angle) const
@@ -0,0 +1,95 @@
+/*
+* NoiseFloorTracker.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_NOISEFLOORTRACKER_H_
+#define __MCA_NOISEFLOORTRACKER_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The NoiseFloorTracker class estimates the noise floor of a stream of frame powers
+ * with minimum statistics: the frame power is smoothed and the floor is the minimum of the
+ * smoothed power over a sliding window, plus a margin. The floor follows changes of the
+ * background noise with a delay of at most one window.
+ *
+ * The minimum is kept with a monotonic queue of candidates stored in a ring buffer, so each
+ * update takes constant time (amortised) and no memory is allocated after construction.
+ * The floor is not available until the first window is complete.
+ */
+class NoiseFloorTracker
+{
+    public:
+	/**
+	   * @brief NoiseFloorTracker
+	   * @param windowLength  number of frames of the sliding window, at least 1.
+	   * @param marginDB  margin over the minimum power (in dB) to decide that signal is present.
+	   * @param smoothing  memory factor used to smooth the power before tracking its minimum.
+	   */
+	NoiseFloorTracker(int windowLength, double marginDB, double smoothing = _defaultSmoothing);
+	virtual ~NoiseFloorTracker(){}
+
+	/**
+	   * @brief update  adds the power of a new frame and updates the floor.
+	   * @param powerDB  power of the frame in dB.
+	   * @return true if the floor is estimated and the frame exceeds it.
+	   */
+	bool update(BaseType powerDB);
+
+	/**
+	   * @brief reset  forgets all the frames, the floor has to be estimated again.
+	   */
+	void reset();
+
+	inline bool isEstimated() const {return _estimated;}
+	inline BaseType getFloor() const {return _floor;}
+	inline int getWindowLength() const {return _windowLength;}
+
+	/**
+	   * @brief getWindowLength  number of frames needed to cover a duration.
+	   * @param duration  duration of the window in seconds.
+	   * @param frameRate  time between frames in seconds.
+	   */
+	static int getWindowLength(double duration, double frameRate);
+
+    private:
+	static constexpr double _defaultSmoothing = 0.7; /**< weight of the previous smoothed power */
+
+	const int _windowLength;
+	const double _marginDB;
+	const double _smoothing;
+	double _smoothedPower; /**< smoothed linear power */
+	unsigned long _frame; /**< number of frames since the last reset */
+	std::vector<BaseType> _candidates; /**< ring buffer of increasing powers (dB) that can become the minimum of the window */
+	std::vector<unsigned long> _candidateFrames; /**< frame of each candidate */
+	int _first; /**< position of the oldest candidate, the minimum of the window */
+	int _ncandidates;
+	bool _estimated;
+	BaseType _floor; /**< minimum of the window plus margin, in dB */
+};
+
+}
+
+#endif // __MCA_NOISEFLOORTRACKER_H_
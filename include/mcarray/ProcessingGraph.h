@@ -0,0 +1,180 @@
+/*
+* ProcessingGraph.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_PROCESSINGGRAPH_H_
+#define __MCA_PROCESSINGGRAPH_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <dspone/rt/ShortTimeProcess.h>
+#include <dspone/rt/ShortTimeAnalysis.h>
+
+#include <memory>
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The FrameBufferPool class keeps a fixed set of multichannel buffers that are
+ * handed out with a reference count and go back to the pool when the last reference is released.
+ * All the memory is allocated in the constructor, so it can be used in the real-time loop.
+ */
+class FrameBufferPool
+{
+    public:
+	/**
+	   * @brief FrameBufferPool
+	   * @param nbuffers  number of buffers in the pool.
+	   * @param nchannels  number of channels of each buffer.
+	   * @param length  length (in samples) of each channel.
+	   */
+	FrameBufferPool(unsigned int nbuffers, unsigned int nchannels, int length);
+	virtual ~FrameBufferPool(){}
+
+	/**
+	   * @brief acquire  takes a free buffer from the pool.
+	   * @param references  number of releases needed to give the buffer back to the pool.
+	   * @return the identifier of the buffer. Throws if there is no free buffer.
+	   */
+	int acquire(int references = 1);
+
+	/**
+	   * @brief release  drops one reference of the buffer, it goes back to the pool with the last one.
+	   */
+	void release(int buffer);
+
+	/**
+	   * @brief getChannels  returns the channels of a buffer, as expected by ShortTimeProcess::process.
+	   */
+	inline std::vector<double*>& getChannels(int buffer) {return _channelPtrs[buffer];}
+
+	inline unsigned int getNumberOfBuffers() const {return _references.size();}
+	inline unsigned int getNumberOfFreeBuffers() const {return _free.size();}
+	inline int getLength() const {return _length;}
+
+    private:
+	const int _length;
+	std::vector<SignalVector> _channels; /**< owned memory of each buffer */
+	std::vector<std::vector<double*> > _channelPtrs; /**< channels of each buffer */
+	std::vector<int> _references; /**< reference count of each buffer, 0 when it is free */
+	std::vector<int> _free; /**< stack of free buffers */
+};
+
+/**
+ * @brief The ProcessingGraph class composes several ShortTimeProcess (processors) and ShortTimeAnalysis
+ * (analysers) modules so that they can be run as a single module.
+ * Each node reads the signal of a previous node (or the input of the graph), and the output of the
+ * graph is the signal of the last processor added. Analysers do not generate any signal.
+ * Nodes are run in the order they were added and are not owned by the graph.
+ *
+ * build() has to be called after adding the nodes. It computes:
+ *  - the latency of the signal seen by each node, so that results can be aligned with the input.
+ *  - the number of intermediate buffers needed, which are taken from a FrameBufferPool and
+ *    released as soon as their last reader is run. The input of the graph is read in place and
+ *    the last processor writes directly in the output buffer, so a chain only adds one intermediate
+ *    buffer per link that is still alive.
+ */
+class ProcessingGraph
+{
+    public:
+	static constexpr int INPUT = -1; /**< source of the nodes that read the input of the graph */
+	static constexpr int OUTPUT = -2; /**< source of the nodes that read the output of the graph, i.e. the last processor */
+
+	/**
+	   * @brief ProcessingGraph
+	   * @param nchannels  number of channels of the input, all the nodes have to work with this number of channels.
+	   * @param maxBlockLength  maximum number of samples per channel passed to process().
+	   */
+	ProcessingGraph(unsigned int nchannels, int maxBlockLength);
+	virtual ~ProcessingGraph(){}
+
+	/**
+	   * @brief addProcessor  adds a node that modifies the signal of its source.
+	   * @param source  node whose signal is processed, INPUT or OUTPUT.
+	   * @return identifier of the node.
+	   */
+	int addProcessor(dsp::ShortTimeProcess *processor, int source = OUTPUT);
+
+	/**
+	   * @brief addAnalyser  adds a node that analyses the signal of its source.
+	   * @param source  node whose signal is analysed, INPUT or OUTPUT.
+	   * @return identifier of the node.
+	   */
+	int addAnalyser(dsp::ShortTimeAnalysis *analyser, int source = OUTPUT);
+
+	/**
+	   * @brief build  plans latencies and buffers. No more nodes can be added afterwards.
+	   */
+	void build();
+
+	/**
+	   * @brief process  runs all the nodes on one block of samples.
+	   * @param input  one buffer per channel.
+	   * @param length  number of samples per channel, at most maxBlockLength.
+	   * @param output  one buffer per channel of at least getMaxOutputLength() samples.
+	   * @param outputLength  length of the output buffers.
+	   * @return number of samples written in the output.
+	   */
+	int process(const std::vector<double*> &input, int length, std::vector<double*> &output, int outputLength);
+
+	/**
+	   * @brief getLatency  returns the maximum latency (in samples) of the signal read by a node with respect
+	   * to the input of the graph.
+	   */
+	int getLatency(int node) const;
+
+	/**
+	   * @brief getMaxLatency  maximum latency of the output with respect to the input of the graph.
+	   */
+	inline int getMaxLatency() const {return _outputLatency;}
+	inline int getMaxOutputLength() const {return _maxBlockLength + _outputLatency;}
+	inline unsigned int getNumberOfNodes() const {return _nodes.size();}
+	inline unsigned int getNumberOfBuffers() const {return _pool ? _pool->getNumberOfBuffers() : 0;}
+
+    private:
+	struct Node {
+	    dsp::ShortTimeProcess *processor; /**< null for analysers */
+	    dsp::ShortTimeAnalysis *analyser; /**< null for processors */
+	    int source; /**< node read by this one, or INPUT */
+	    int latency; /**< latency of the signal read by this node */
+	    int readers; /**< number of nodes that read the signal of this one */
+	};
+
+	const unsigned int _nchannels;
+	const int _maxBlockLength;
+	std::vector<Node> _nodes;
+	int _outputNode; /**< last processor, or INPUT if there is none */
+	int _outputLatency;
+	bool _built;
+	std::unique_ptr<FrameBufferPool> _pool;
+	std::vector<double*> _input; /**< channels of the input of the current block */
+	std::vector<int> _nodeBuffers; /**< buffer holding the signal of each processor during process() */
+	std::vector<int> _nodeLengths; /**< samples generated by each processor during process() */
+
+	int addNode(dsp::ShortTimeProcess *processor, dsp::ShortTimeAnalysis *analyser, int source);
+	int resolveSource(int source) const;
+	void releaseSource(int node);
+};
+
+}
+
+#endif // __MCA_PROCESSINGGRAPH_H_
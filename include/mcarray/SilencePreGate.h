@@ -0,0 +1,107 @@
+/*
+* SilencePreGate.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_SILENCEPREGATE_H_
+#define __MCA_SILENCEPREGATE_H_
+
+#include <mcarray/mcadefs.h>
+#include <mcarray/NoiseFloorTracker.h>
+
+namespace mca
+{
+
+/**
+ * @brief The SilencePreGate class decides whether a frame is silence from its time-domain
+ * energy, so that STFT modules can skip the FFT and the rest of the spectral work in frames
+ * that are clearly below the noise floor.
+ *
+ * The windowed frames of all channels are stored (from frameAnalysis) before the FFT. The
+ * noise floor is tracked with the spectral log power of the module, so the time-domain power
+ * is mapped to that scale with an offset learned from the frames that are transformed.
+ * Until the offset is learned no frame is gated.
+ */
+class SilencePreGate
+{
+    public:
+	/**
+	   * @brief SilencePreGate
+	   * @param nchannels  number of channels of the frames.
+	   * @param frameLength  maximum length of the windowed frames.
+	   * @param marginDB  margin below the noise floor (in dB) to consider a frame silence.
+	   */
+	SilencePreGate(unsigned int nchannels, int frameLength, double marginDB = _defaultMarginDB);
+	virtual ~SilencePreGate(){}
+
+	/**
+	   * @brief storeFrame  keeps a copy of the windowed frame of a channel and accumulates its energy.
+	   */
+	void storeFrame(const BaseType *frame, int frameLength, unsigned int channel);
+
+	/**
+	   * @brief hasFrame  true if the frames of all the channels have been stored since the last clear().
+	   */
+	inline bool hasFrame() const {return _storedChannels == _nchannels;}
+
+	/**
+	   * @brief isSilent  true if the estimated power of the stored frame is below the floor by more than the margin.
+	   */
+	bool isSilent(const NoiseFloorTracker &floor) const;
+
+	/**
+	   * @brief getEstimatedPower  estimation of the spectral log power of the stored frame.
+	   */
+	BaseType getEstimatedPower() const;
+
+	/**
+	   * @brief calibrate  updates the offset between the time-domain and the spectral power.
+	   * @param spectralPower  spectral log power of the stored frame.
+	   */
+	void calibrate(BaseType spectralPower);
+
+	/**
+	   * @brief clear  forgets the stored frame, has to be called once it is processed.
+	   */
+	void clear();
+
+	inline const BaseType* getFrame(unsigned int channel) const {return _frames[channel].get();}
+	inline int getFrameLength() const {return _frameLength;}
+
+    private:
+	static constexpr double _defaultMarginDB = 3.0;
+	static constexpr int _calibrationFrames = 10; /**< frames needed to learn the offset */
+	static constexpr double _offsetMemoryFactor = 0.9;
+
+	const unsigned int _nchannels;
+	const int _maxFrameLength;
+	const double _marginDB;
+	SignalVector _frames; /**< windowed frame of each channel */
+	int _frameLength; /**< length of the stored frames */
+	unsigned int _storedChannels;
+	double _energy; /**< energy of the stored frames of all channels */
+	double _offset; /**< spectral log power minus time-domain log power */
+	int _calibratedFrames;
+
+	BaseType getTimePower() const;
+};
+
+}
+
+#endif // __MCA_SILENCEPREGATE_H_
@@ -26,6 +26,7 @@
 #include <mcarray/ArrayDescription.h>
 #include <mcarray/SoundLocalisationCallback.h>
 #include <mcarray/mcadefs.h>
+#include <mcarray/NoiseFloorTracker.h>
 
 #include <dspone/pf/ParticleFilter.hpp>
 #include <dspone/pf/ParticleSet.hpp>
@@ -72,9 +73,15 @@ class SoundLocalisationImpl
 
 	void setParticleDOAs(std::vector<double> &doas, std::vector<double> &weights) const;
 
+	/**
+	   * @brief getNoiseFloorTracker
+	   * @return the noise floor tracker, or null if the class does not track the noise floor.
+	   */
+	inline const NoiseFloorTracker* getNoiseFloorTracker() const {return _noiseFloor.get();}
+
     protected:
 
-	static constexpr double _durationToEstimatePowerFloor = 3; /**< amount of time in seconds used to estimat the noise floor */
+	static constexpr double _durationToEstimatePowerFloor = 3; /**< length in seconds of the window used to track the noise floor */
 
 	LocalisationCallback* _ptrCallback; /**< pointer to the callback whose setDAO function will be called */
 	const ArrayDescription _microphonePositions; /**< array containing the postition of each microphone in the array, in meters */
@@ -83,7 +90,7 @@ class SoundLocalisationImpl
 	SignalPtr _prob; /**< Probability associated to each DOA */
 	double _powerFloor;  /**< minimum frame power for the setDOA function to be called */
 	bool _noiseEstimated; /**< keeps track wether the amount of sampels for noise floor estimation have been consumed */
-	int _samplesConsumedForNoise; /**< number of smaples consumend to calculated the noise floor */
+	std::unique_ptr<NoiseFloorTracker> _noiseFloor; /**< tracks the noise floor, created by initPowerFloor */
 	long int _sourceCounter;
 
 	typedef dsp::ParticleFilter<double, int, dsp::ParticleSet<double>, dsp::ParticleSet<double> > particle_filter_t;
@@ -93,17 +100,20 @@ class SoundLocalisationImpl
 	std::shared_ptr<dsp::ResamplingModel<double, double> > _resamplingModel;
 
 	/**
-	   * @brief setPowerFloor  Sets the power floor and when the necessary amount of samples have been
-	   * consumed set the variable __noiseEstimated to true and the variable _powerFloor.
-	   * Used calculatePower to obtain the power value.
-	   * to the estimated value.
-	   * @param analysisFrames  input frames
-	   * @param length  length of the input vectors
-	   * @param nchannels  number of channels in analysisFrames
-	   * @param sampleRate  sampleRate
-	   * @return   returns the power calculated.
+	   * @brief initPowerFloor  creates the noise floor tracker, with a window of
+	   * _durationToEstimatePowerFloor seconds.
+	   * @param frameRate  time between frames in seconds.
+	   * @param marginDB  margin over the noise floor to decide that signal is present.
+	   */
+	void initPowerFloor(double frameRate, double marginDB);
+
+	/**
+	   * @brief updatePowerFloor  updates the noise floor with the power of the current frame
+	   * and sets _powerFloor and _noiseEstimated accordingly.
+	   * @param power  power of the frame in dB.
+	   * @return true if the noise floor is estimated and the frame exceeds it.
 	   */
-	virtual BaseType setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate) = 0;
+	bool updatePowerFloor(BaseType power);
 
 };
 
@@ -26,6 +26,8 @@
 #include <mcarray/ArrayDescription.h>
 #include <mcarray/SoundLocalisationCallback.h>
 #include <mcarray/BeamformingSeparationAndLocalistaion.h>
+#include <mcarray/SpectralFrontEnd.h>
+#include <mcarray/SilencePreGate.h>
 
 #include <dspone/rt/ShortTimeFourierAnalysis.h>
 
@@ -35,12 +37,22 @@ namespace mca
 {
 
 
-class SourceLocalisation : public dsp::STFTAnalysis
+class SourceLocalisation : public dsp::STFTAnalysis, public SpectrumConsumer
 {
 
     public:
 
-	SourceLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor=true);
+	/**
+	   * @brief SourceLocalisation
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the array.
+	   * @param numOfSources  number of sources to localise.
+	   * @param usePowerFloor  use the estimated power floor to detect the presence of signal.
+	   * @param method  method used to compute the energy in each DOA.
+	   * @param frameRate  frame rate in seconds, to work with the frames of a SpectralFrontEnd.
+	   */
+	SourceLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor=true,
+			   SteeringBeamforming::LocalisationMethod method=SteeringBeamforming::PAIRWISE_GCC, float frameRate=_frameRate);
 
 	virtual ~SourceLocalisation(){}
 
@@ -51,6 +63,11 @@ class SourceLocalisation : public dsp::STFTAnalysis
 	void setCallback(LocalisationCallback &callback);
 	void setCallback(LocalisationCallback *callback);
 
+	/**
+	   * @brief consumeSpectrum  Localises from a spectrum computed by a SpectralFrontEnd.
+	   */
+	virtual void consumeSpectrum(const SpectralFrame &frame);
+
     private:
 
 	static constexpr float _frameRate = 0.025;  /**< related with the length of the frame to work with, in  seconds  */
@@ -59,6 +76,13 @@ class SourceLocalisation : public dsp::STFTAnalysis
 	SignalVector _denoisedFrames; /**< frames after noise reduction. */
 	SignalVector _subBandWeights; /**< weights to indicate which subbands are more qualified for localisation */
 	std::unique_ptr<BeamformingSeparationAndLocalisation> _impl; /**< pointer to the implementation of beamforming localisation and separation */
+	SilencePreGate _preGate; /**< keeps the windowed frames until it is known whether they need an FFT */
+
+	/**
+	   * @brief frameAnalysis  stores the windowed frame, the FFT is done in processParametrisation
+	   * only if the frame is not clearly below the noise floor.
+	   */
+	virtual void frameAnalysis(BaseType *inFrame, BaseType *analysis, int frameLength, int analysisLength, int channel);
 
 	virtual void processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
 					    std::vector<double*> &dataChannels, int dataLength);
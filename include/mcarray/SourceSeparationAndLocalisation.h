@@ -27,6 +27,7 @@
 #include <mcarray/BinauralLocalisation.h>
 #include <mcarray/microhponeArrayHelpers.h>
 #include <mcarray/BeamformingSeparationAndLocalistaion.h>
+#include <mcarray/SpectralFrontEnd.h>
 
 
 #include <dspone/rt/ShortTimeProcess.h>
@@ -39,12 +40,22 @@ namespace mca
 {
 
 
-class SourceSeparationAndLocalisation : public dsp::STFT
+class SourceSeparationAndLocalisation : public dsp::STFT, public SpectrumProcessor
 {
 
     public:
 
-	SourceSeparationAndLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor=true);
+	/**
+	   * @brief SourceSeparationAndLocalisation
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param microphonePositions  description of the array.
+	   * @param numOfSources  number of sources to localise and separate.
+	   * @param usePowerFloor  use the estimated power floor to detect the presence of signal.
+	   * @param beamformerType  algorithm used to separate the sources.
+	   * @param frameRate  frame rate in seconds, to work with the frames of a SpectralFrontEnd.
+	   */
+	SourceSeparationAndLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor=true,
+					Beamformer::BeamformerType beamformerType=Beamformer::DELAY_AND_SUM, float frameRate=_frameRate);
 
 	virtual ~SourceSeparationAndLocalisation(){}
 
@@ -55,6 +66,24 @@ class SourceSeparationAndLocalisation : public dsp::STFT
 	void setCallback(LocalisationCallback &callback);
 	void setCallback(LocalisationCallback *callback);
 
+	/**
+	   * @brief setLocalisationRate  localises the sources only every few frames, or when the signal
+	   * changes, while the separation runs on every frame with the last DOAs.
+	   */
+	void setLocalisationRate(const BeamformingSeparationAndLocalisation::LocalisationRate &rate);
+
+	/**
+	   * @brief setSourceCounting  separates only the sources found active in each frame,
+	   * instead of all numOfSources (disabled by default).
+	   */
+	void setSourceCounting(bool enable);
+
+	/**
+	   * @brief processSpectrum  Localises and separates the sources of a spectrum computed by a SpectralFrontEnd.
+	   * The separated sources are written in outputFrames.
+	   */
+	virtual void processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames);
+
     private:
 
 	static constexpr float _frameRate = 0.025;  /**< related with the length of the frame to work with, in  seconds  */
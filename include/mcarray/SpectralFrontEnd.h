@@ -0,0 +1,212 @@
+/*
+* SpectralFrontEnd.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_SPECTRALFRONTEND_H_
+#define __MCA_SPECTRALFRONTEND_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <dspone/rt/ShortTimeFourierTransform.h>
+
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The SpectralFrame class gives read-only access to one frame of a multichannel
+ * spectrum (one-sided FFT in CCS format for each channel). It does not own the data,
+ * which is only valid during the call it is passed to.
+ */
+class SpectralFrame
+{
+    public:
+	SpectralFrame(const std::vector<double*> &analysisFrames, int analysisLength, unsigned long index);
+
+	inline const BaseType* getChannel(unsigned int channel) const {return _channels[channel];}
+	inline unsigned int getNumberOfChannels() const {return _channels.size();}
+	inline int getAnalysisLength() const {return _analysisLength;}
+	inline unsigned long getIndex() const {return _index;}
+
+	/**
+	   * @brief checkCompatibility  Throws an exception if the frame does not have the expected
+	   * number of channels or analysis length.
+	   */
+	void checkCompatibility(unsigned int nchannels, int analysisLength) const;
+
+    private:
+	std::vector<const BaseType*> _channels; /**< spectrum of each channel */
+	int _analysisLength; /**< length of the spectrum of each channel (FFT in CCS format) */
+	unsigned long _index; /**< number of the frame since the beginning of the stream */
+
+	friend class SpectralBlock;
+};
+
+/**
+ * @brief The SpectralBlock class gives read-only access to a block of consecutive frames of a
+ * multichannel spectrum. Each channel is a nframes x analysisLength matrix stored by frames.
+ * It does not own the data, which is only valid during the call it is passed to.
+ */
+class SpectralBlock
+{
+    public:
+	/**
+	   * @brief SpectralBlock
+	   * @param blocks  one buffer per channel with nframes spectra, one after the other.
+	   * @param analysisLength  length of each spectrum (FFT in CCS format).
+	   * @param nframes  number of frames of the block.
+	   * @param firstIndex  number of the first frame since the beginning of the stream.
+	   */
+	SpectralBlock(const std::vector<double*> &blocks, int analysisLength, int nframes, unsigned long firstIndex);
+
+	inline const BaseType* getChannel(int frame, unsigned int channel) const {return _blocks[channel] + frame*_analysisLength;}
+	inline unsigned int getNumberOfChannels() const {return _blocks.size();}
+	inline int getAnalysisLength() const {return _analysisLength;}
+	inline int getNumberOfFrames() const {return _nframes;}
+	inline unsigned long getFirstIndex() const {return _firstIndex;}
+
+	/**
+	   * @brief getFrame  returns one frame of the block, without allocating memory.
+	   * The returned frame is only valid until the next call.
+	   */
+	const SpectralFrame &getFrame(int frame) const;
+
+	/**
+	   * @brief checkCompatibility  Throws an exception if the block does not have the expected
+	   * number of channels or analysis length.
+	   */
+	void checkCompatibility(unsigned int nchannels, int analysisLength) const;
+
+    private:
+	std::vector<const BaseType*> _blocks; /**< frames of each channel */
+	int _analysisLength; /**< length of each spectrum (FFT in CCS format) */
+	int _nframes; /**< number of frames */
+	unsigned long _firstIndex; /**< number of the first frame since the beginning of the stream */
+	mutable SpectralFrame _frame; /**< frame returned by getFrame */
+};
+
+/**
+ * @brief The SpectrumConsumer class is the interface of the modules that can analyse a spectrum
+ * computed by someone else (i.e. by SpectralFrontEnd) instead of computing their own FFT.
+ */
+class SpectrumConsumer
+{
+    public:
+	virtual ~SpectrumConsumer(){}
+
+	/**
+	   * @brief consumeSpectrum  Analyses one frame of a precomputed spectrum.
+	   * The analysis length of the frame has to be the one of the module.
+	   */
+	virtual void consumeSpectrum(const SpectralFrame &frame) = 0;
+
+	/**
+	   * @brief consumeSpectra  Analyses a block of consecutive frames, in order.
+	   * By default every frame is passed to consumeSpectrum; modules override it
+	   * when the work of several frames can be shared.
+	   */
+	virtual void consumeSpectra(const SpectralBlock &block);
+};
+
+/**
+ * @brief The SpectrumProcessor class is the interface of the modules that can modify a spectrum
+ * computed by someone else (i.e. by SpectralFrontEnd) instead of computing their own FFT and IFFT.
+ */
+class SpectrumProcessor
+{
+    public:
+	virtual ~SpectrumProcessor(){}
+
+	/**
+	   * @brief processSpectrum  Processes one frame of a precomputed spectrum.
+	   * @param input  frame to be processed, the analysis length has to be the one of the module.
+	   * @param outputFrames  buffers (one per channel, analysis length) where the processed spectrum is written.
+	   */
+	virtual void processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames) = 0;
+
+	/**
+	   * @brief processSpectra  Processes a block of consecutive frames, in order.
+	   * By default every frame is passed to processSpectrum.
+	   * @param input  frames to be processed.
+	   * @param outputBlocks  buffers (one per channel, frames x analysis length) where the processed spectra are written.
+	   */
+	virtual void processSpectra(const SpectralBlock &input, std::vector<double*> &outputBlocks);
+};
+
+/**
+ * @brief The SpectralFrontEnd class computes the STFT of all channels once per hop and passes it
+ * through a chain of stages, in the order they were added:
+ *  - consumers analyse the current spectrum (e.g. localisation).
+ *  - processors generate a new spectrum from the current one (e.g. masking or separation),
+ *    which becomes the current spectrum for the following stages.
+ * The output signal is the synthesis of the last spectrum. Modules in the chain have to be
+ * created with the same frame rate as the front end so that their analysis lengths match.
+ * Stages are not owned by the front end.
+ *
+ * For offline processing, processSpectra runs the chain over a block of precomputed spectra:
+ * each stage processes the whole block before the next one starts, so its tables and state
+ * are loaded once per block instead of once per frame. Frames still reach each stage in order.
+ */
+class SpectralFrontEnd : public dsp::STFT
+{
+    public:
+	/**
+	   * @brief SpectralFrontEnd
+	   * @param sampleRate  sample rate of the signals to be processed.
+	   * @param nchannels  number of channels.
+	   * @param frameRate  frame rate (in seconds) common to all the stages.
+	   */
+	SpectralFrontEnd(int sampleRate, unsigned int nchannels, float frameRate);
+	virtual ~SpectralFrontEnd(){}
+
+	void addConsumer(SpectrumConsumer *consumer);
+	void addProcessor(SpectrumProcessor *processor);
+
+	inline float getFrameRate() const {return _frameRate;}
+
+	/**
+	   * @brief processSpectra  Runs all the stages over a block of spectra (see SpectralBlock).
+	   * The frames are numbered after the ones already processed.
+	   * @param blocks  spectra of each channel (nframes x analysis length).
+	   * @param nframes  number of frames.
+	   * @param outputBlocks  buffers (nframes x analysis length) where the last spectrum of each frame is written.
+	   * They can be the input buffers.
+	   */
+	void processSpectra(const std::vector<double*> &blocks, int nframes, std::vector<double*> &outputBlocks);
+
+    private:
+	const float _frameRate; /**< frame rate common to all the stages, in seconds */
+	unsigned long _frameIndex; /**< number of frames processed */
+	std::vector<SpectrumConsumer*> _consumers; /**< consumer of each stage (null if the stage is a processor) */
+	std::vector<SpectrumProcessor*> _processors; /**< processor of each stage (null if the stage is a consumer) */
+	SignalVector _processedFrames[2]; /**< spectra generated by processors, used alternatively */
+	std::vector<double*> _processedFramesPtrs[2];
+	int _blockCapacity; /**< number of frames of the buffers of processed blocks */
+	SignalVector _processedBlocks[2]; /**< blocks generated by processors in processSpectra, used alternatively */
+	std::vector<double*> _processedBlocksPtrs[2];
+
+	virtual void processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
+					    std::vector<double*> &dataChannels, int dataLength);
+};
+
+}
+
+#endif // __MCA_SPECTRALFRONTEND_H_
@@ -0,0 +1,78 @@
+/*
+* SplitSpectrum.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_SPLITSPECTRUM_H_
+#define __MCA_SPLITSPECTRUM_H_
+
+#include <mcarray/mcadefs.h>
+
+namespace mca
+{
+
+/**
+ * @brief The SplitSpectrum class keeps one-sided spectra of several channels with the real and
+ * imaginary parts in separate planes (split-complex layout).
+ * Spectra are exchanged with the rest of the library interleaved (CCS format); kernels that
+ * multiply complex values work on the planes instead, so that SIMD registers are filled with
+ * real parts on one side and imaginary parts on the other, without shuffles.
+ */
+class SplitSpectrum
+{
+    public:
+	/**
+	   * @brief SplitSpectrum
+	   * @param nchannels  number of channels.
+	   * @param complexLength  number of complex values of each channel (N/2+1 for a one-sided FFT).
+	   */
+	SplitSpectrum(unsigned int nchannels, int complexLength);
+	virtual ~SplitSpectrum(){}
+
+	/**
+	   * @brief deinterleave  copies an interleaved spectrum into the planes of one channel.
+	   */
+	void deinterleave(const BaseTypeC *spectrum, unsigned int channel);
+
+	/**
+	   * @brief interleave  copies the planes of one channel into an interleaved spectrum.
+	   */
+	void interleave(unsigned int channel, BaseTypeC *spectrum) const;
+
+	/**
+	   * @brief setZeros  sets both planes of one channel to zero.
+	   */
+	void setZeros(unsigned int channel);
+
+	inline BaseType *getReal(unsigned int channel) {return _real[channel].get();}
+	inline BaseType *getImag(unsigned int channel) {return _imag[channel].get();}
+	inline const BaseType *getReal(unsigned int channel) const {return _real[channel].get();}
+	inline const BaseType *getImag(unsigned int channel) const {return _imag[channel].get();}
+	inline unsigned int getNumberOfChannels() const {return _real.size();}
+	inline int getLength() const {return _complexLength;}
+
+    private:
+	const int _complexLength; /**< number of complex values of each channel */
+	SignalVector _real; /**< real parts, one plane per channel */
+	SignalVector _imag; /**< imaginary parts, one plane per channel */
+};
+
+}
+
+#endif // __MCA_SPLITSPECTRUM_H_
@@ -0,0 +1,83 @@
+/*
+* SteeredResponsePower.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_STEEREDRESPONSEPOWER_H_
+#define __MCA_STEEREDRESPONSEPOWER_H_
+
+#include <mcarray/mcadefs.h>
+
+namespace mca
+{
+
+/**
+ * @brief The SteeredResponsePower class evaluates the SRP-PHAT of a microphone array over a grid
+ * of candidate positions (DOAs), given the delay of arrival of each channel for each of them.
+ *
+ * The PHAT weighting of a pair cross-spectrum X_i(k)X*_j(k)/|X_i(k)X*_j(k)| is the product of the
+ * phases of both channels, so the sum of the GCC-PHAT of all pairs can be obtained from the
+ * phase-only spectrum of each channel:
+ *
+ *    sum_{i<j} C_ij(t) = ( sum_k |sum_c X_c(k)/|X_c(k)| * e^{jw_k*D_c(t)}|^2  - sum_k M_k ) / 2
+ *
+ * where D_c(t) is the delay of channel c for grid point t and M_k the number of channels with
+ * energy in bin k. The cost is proportional to channels x grid points per bin, instead of
+ * pairs x grid points. Each C_ij(t) is the same correlation computed by TauMatrix for the
+ * delay D_i(t) - D_j(t).
+ *
+ * The steering table is stored as [bin][channel][grid point], with real and imaginary parts in
+ * separate vectors, so the evaluation of all grid points is a contiguous loop.
+ */
+class SteeredResponsePower
+{
+    public:
+
+	/**
+	   * @brief SteeredResponsePower  precomputes the steering table.
+	   * @param delays  one vector per channel with the delay (in samples) of that channel for each grid point.
+	   * @param numSteps  number of grid points.
+	   * @param complexLength  length of the one-sided FFT (N/2+1).
+	   */
+	SteeredResponsePower(const SignalVector &delays, int numSteps, int complexLength);
+	virtual ~SteeredResponsePower(){}
+
+	/**
+	   * @brief calculateResponse  computes the sum of the GCC-PHAT of all microphone pairs for each grid point.
+	   * @param analysisFrames  one-sided spectrum of each channel (FFT in CCS format).
+	   * @param response  output vector of numSteps elements.
+	   */
+	void calculateResponse(const SignalVector &analysisFrames, BaseType *response);
+
+	inline int getNumberOfSteps() const {return _numSteps;}
+
+    private:
+
+	const int _nchannels; /**< number of channels */
+	const int _numSteps; /**< number of grid points */
+	const int _complexLength; /**< length of the one-sided FFT */
+	SignalPtr _tableRe; /**< real part of e^{jw_k*D_c(t)}, stored as [bin][channel][grid point] */
+	SignalPtr _tableIm; /**< imaginary part of e^{jw_k*D_c(t)}, stored as [bin][channel][grid point] */
+	SignalPtr _responseRe; /**< real part of the steered sum of one bin for each grid point */
+	SignalPtr _responseIm; /**< imaginary part of the steered sum of one bin for each grid point */
+};
+
+}
+
+#endif // __MCA_STEEREDRESPONSEPOWER_H_
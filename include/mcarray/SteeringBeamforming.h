@@ -27,21 +27,35 @@
 
 #include <memory>
 
-namespace dsp
-{
-class GeneralisedCrossCorrelation;
-}
-
 namespace mca
 {
 
+class SteeredResponsePower;
+class TauMatrix;
+
 
 class SteeringBeamforming
 {
     public:
 
-	SteeringBeamforming(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels);
-	virtual ~SteeringBeamforming(){}
+	/**
+	   * This type identifies how the energy in each DOA is computed.
+	   * PAIRWISE_GCC = one GCC-PHAT per microphone pair, evaluated for all DOAs and summed.
+	   * SRP_PHAT = steered response power with PHAT weighting, evaluated for all DOAs at once
+	   *            from the phase of each channel (see SteeredResponsePower). Same energy, but its cost
+	   *            grows with the number of microphones instead of the number of pairs.
+	   * PAIRWISE_GCC_RECURRENCE = same as PAIRWISE_GCC, but the phase terms of each pair are generated
+	   *            by recurrence from one phasor per DOA (see TauMatrix::RECURRENCE). The memory of each
+	   *            pair is proportional to the number of DOAs instead of DOAs x FFT bins.
+	   * PAIRWISE_GCC_BAND_LIMITED = same as PAIRWISE_GCC, but the GCC of each pair only covers the bins
+	   *            between 100 Hz and the spatial aliasing frequency of the pair (see getUsefulBand).
+	   *            The table and the cost of each pair shrink with the band, and aliased bins are ignored.
+	   **/
+	typedef enum {PAIRWISE_GCC=0, SRP_PHAT=1, PAIRWISE_GCC_RECURRENCE=2, PAIRWISE_GCC_BAND_LIMITED=3} LocalisationMethod;
+
+	SteeringBeamforming(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels,
+			    LocalisationMethod method=PAIRWISE_GCC);
+	virtual ~SteeringBeamforming();
 
 	/**
 	   * @brief processFrame  Processes one frame and computes the DOA estimation and calls the callback with the obtined values.
@@ -53,6 +67,14 @@ class SteeringBeamforming
 	   */
 	void processFrame(const SignalVector &analysisFrames, SignalPtr DOA, SignalPtr prob, int numOfSources, SignalVector &wienerCoefs);
 
+	/**
+	   * @brief getNumberOfActiveSources
+	   * @return number of sources found active in the last processed frame, the first ones of the DOA vector.
+	   * A source is active while the prominence of its peak in the energy is high enough compared with the one
+	   * of the strongest peak. The first source is always active.
+	   */
+	inline int getNumberOfActiveSources() const {return _activeSources;}
+
     private:
 
 	int _sampleRate; /**< sample rate of the signals to be processed */
@@ -61,18 +83,23 @@ class SteeringBeamforming
 	const unsigned int _nchannels; /**< number of channels in input signal (number of microphones) */
 	const float _doaStep; /**< step in degrees between DOA values used in the DOA grid. It determines the resolution. */
 	const int _numSteps; /**< number of steps in DOA grid (calculated from doaStep). */
+	const LocalisationMethod _method; /**< method used to compute the energy in each DOA */
+	const int _numPairs; /**< number of microphone pairs */
 	SignalVector32 _wienerCoefs; /**< vector containing the wiener coeficients. */
 	ArrayDescription _microphonePositions; /**< description of the array (position of each microphone). */
-	SignalCPtr _complexCorrelation; /**< buffer used to compute the correlations. */
 	SignalVector _correlations; /**< vector used to store the correlation results for each micro pair. */
 	SignalPtr _energyInDOA; /**<  vector that contains the energy in each DOA. */
 	SignalPtr _prevEnergyInDOA; /** < used to average with previous energy vector */
 	static constexpr float _energyMemoryFactor = 0.8; /**< memory factor to smooth the energy (weigth assigned to the previous energy).  */
+	static constexpr double _activationProminence = 0.5; /**< prominence, relative to the first source, for an inactive source to become active */
+	static constexpr double _releaseProminence = 0.25; /**< prominence, relative to the first source, below which an active source is released */
+	int _activeSources; /**< number of active sources in the last processed frame */
 	SignalPtr _firstDerivative; /**< used to look for the local maximums in the energy vector */
 	SignalPtr _filteredFirstDerivative; /**< first derivated filtered with a median filter */
 	SignalPtr _secondDerivative; /**< used to look for the local maximums in the energy vector */
 	std::vector<std::vector<unsigned int> > _microPairIdx; /**< contains the relationship between micro-pair idx and micros idx (k->{i.j}) */
-	std::vector<std::shared_ptr<dsp::GeneralisedCrossCorrelation> > _gcc; /**< vector of GCC objects to compute the correlations (one object for each pair) */
+	std::vector<std::shared_ptr<TauMatrix> > _gcc; /**< vector of tau matrices to compute the GCC (one object for each pair) */
+	std::unique_ptr<SteeredResponsePower> _srp; /**< SRP-PHAT evaluation of all pairs at once, used by SRP_PHAT method */
 
 	/**
 	   * @brief allocate Allocates memory.
@@ -84,9 +111,15 @@ class SteeringBeamforming
 	   */
 	void generateLookupTable();
 
+	/**
+	   * @brief generateSteeringTable Generates the steering table of the SRP_PHAT method, with the delay of
+	   * each channel (relative to the first one) for each DOA.
+	   */
+	void generateSteeringTable();
+
 	/**
 	   * @brief computeCorrelations  Computes the correlations for each micro pair using the GCC algorithm. Stores the
-	   * result in _correlations.
+	   * result in _correlations. With SRP_PHAT, _correlations has a single vector with the sum for all pairs.
 	   * @param analysisFrames  Frames to be processed (FFT in CCS format).
 	   * @param wienerCoefs  Wiener coeficients used in the GCC (not implemented yet).
 	   */
@@ -105,6 +138,13 @@ class SteeringBeamforming
 	   * @param numOfSources  Number of source to search.
 	   */
 	void selectDOA(SignalPtr DOA, SignalPtr prob, int numOfSources);
+
+	/**
+	   * @brief peakProminence  height of a peak of _energyInDOA above the highest of the lowest points
+	   * between the peak and a higher point (or the edge of the grid) on each side.
+	   * @param peak  index of the peak in the DOA grid.
+	   */
+	BaseType peakProminence(int peak) const;
 };
 
 
@@ -0,0 +1,189 @@
+/*
+* TauMatrix.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_TAUMATRIX_H_
+#define __MCA_TAUMATRIX_H_
+
+#include <mcarray/mcadefs.h>
+
+#include <math.h>
+
+namespace mca
+{
+
+/**
+ * @brief The TauMatrix class stores the phase terms e^{jw_k*tau_t} of a GCC-PHAT
+ * evaluation for a set of delays (tau_t) restricted to a band of one-sided FFT bins
+ * [firstBin, lastBin).
+ * The PHAT-weighted cross-spectrum is computed once per frame over the band
+ * and the correlation for each delay is reduced to a dot product with one row
+ * of the matrix:
+ *
+ *    C(tau_t) = Re{ sum_k  X_l(k)X*_r(k)/|X_l(k)X*_r(k)| * e^{jw_k*tau_t} }
+ *
+ * C(tau) is maximum when the left channel is delayed tau samples with respect to the right one.
+ *
+ * Since the FFT bins are uniformly spaced, the terms of a row are the powers of a single phasor
+ * e^{jw_1*tau_t}. With the RECURRENCE evaluation only the first term and that rotation phasor are
+ * stored for each delay, and the row is generated on the fly while the dot product is computed.
+ * Delays are processed in groups of _lanes, so that the inner loop over the group can be vectorised,
+ * and the phasors are renormalised every _renormalisationPeriod bins to keep their magnitude at 1.
+ */
+class TauMatrix
+{
+    public:
+
+	/**
+	   * This type identifies how the phase terms are obtained.
+	   * TABLE = the whole tauLength x nbins matrix is precomputed.
+	   * RECURRENCE = only one rotation phasor per delay is stored, the terms are generated by recurrence.
+	   **/
+	typedef enum {TABLE=0, RECURRENCE=1} Evaluation;
+
+	/**
+	   * @brief TauMatrix  precomputes the phase terms for the given delays and band.
+	   * @param tau  delays (in samples) to evaluate.
+	   * @param tauLength  number of delays.
+	   * @param firstBin  first one-sided FFT bin of the band (included).
+	   * @param lastBin  last one-sided FFT bin of the band (excluded).
+	   * @param complexLength  length of the one-sided FFT (N/2+1).
+	   * @param evaluation  how the phase terms are obtained.
+	   */
+	TauMatrix(const BaseType *tau, int tauLength, int firstBin, int lastBin, int complexLength, Evaluation evaluation=TABLE);
+	virtual ~TauMatrix(){}
+
+	/**
+	   * @brief calculateCorrelations  computes the real part of the GCC-PHAT for each delay.
+	   * @param left  one-sided spectrum of the left channel (full length, indexed by FFT bin).
+	   * @param right  one-sided spectrum of the right channel (full length, indexed by FFT bin).
+	   * @param correlations  output vector of tauLength elements.
+	   */
+	void calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations);
+
+	/**
+	   * @brief calculateCorrelations  computes the correlations of the delays in [firstDelay, lastDelay) only,
+	   * which are the rows of a sub-matrix of the table. The rest of correlations is not modified.
+	   */
+	void calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations,
+				   int firstDelay, int lastDelay);
+
+	inline int getFirstBin() const {return _firstBin;}
+	inline int getLastBin() const {return _lastBin;}
+	inline int getNumberOfDelays() const {return _tauLength;}
+	inline Evaluation getEvaluation() const {return _evaluation;}
+	/**
+	   * @brief getTableSize
+	   * @return size in bytes of the stored phase terms.
+	   */
+	size_t getTableSize() const;
+
+	/**
+	   * @brief calculatePhatCrossSpectrum  computes the PHAT-weighted cross-spectrum X_l(k)X*_r(k)/|X_l(k)X*_r(k)|
+	   * of the bins [firstBin, firstBin+nbins), zero where the product vanishes.
+	   * @param crossRe  output real part, nbins elements.
+	   * @param crossIm  output imaginary part, nbins elements.
+	   */
+	template <typename T>
+	static void calculatePhatCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right, int firstBin, int nbins,
+					       T *crossRe, T *crossIm);
+
+	/**
+	   * @brief calculatePhaseTerms  computes cos(w_k*tau) and sin(w_k*tau) of the bins [firstBin, firstBin+nbins).
+	   * @param complexLength  length of the one-sided FFT (N/2+1).
+	   */
+	template <typename T>
+	static void calculatePhaseTerms(BaseType tau, int firstBin, int nbins, int complexLength, T *cosRow, T *sinRow);
+
+    private:
+	static constexpr int _lanes = 8; /**< number of delays evaluated together with the RECURRENCE evaluation */
+	static constexpr int _renormalisationPeriod = 64; /**< number of bins between renormalisations of the phasors */
+
+	const int _tauLength; /**< number of delays (rows of the matrix) */
+	const int _firstBin; /**< first FFT bin of the band */
+	const int _lastBin; /**< last FFT bin of the band (excluded) */
+	const int _nbins; /**< number of FFT bins in the band (columns of the matrix) */
+	const Evaluation _evaluation; /**< how the phase terms are obtained */
+	const int _paddedLength; /**< tauLength rounded up to a multiple of _lanes */
+	SignalPtr _cos; /**< tauLength x nbins matrix of cos(w_k*tau_t), stored by rows (TABLE) */
+	SignalPtr _sin; /**< tauLength x nbins matrix of sin(w_k*tau_t), stored by rows (TABLE) */
+	SignalPtr _firstRe; /**< real part of e^{jw_firstBin*tau_t} of each delay (RECURRENCE) */
+	SignalPtr _firstIm; /**< imaginary part of e^{jw_firstBin*tau_t} of each delay (RECURRENCE) */
+	SignalPtr _rotationRe; /**< real part of e^{jw_1*tau_t} of each delay (RECURRENCE) */
+	SignalPtr _rotationIm; /**< imaginary part of e^{jw_1*tau_t} of each delay (RECURRENCE) */
+	SignalPtr _crossRe; /**< real part of the PHAT-weighted cross-spectrum of the current frame in the band */
+	SignalPtr _crossIm; /**< imaginary part of the PHAT-weighted cross-spectrum of the current frame in the band */
+
+	/**
+	   * @brief calculateCrossSpectrum  computes the PHAT-weighted cross-spectrum in the band
+	   * and stores it in _crossRe and _crossIm.
+	   */
+	void calculateCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right);
+
+	/**
+	   * @brief calculateRecurrenceCorrelations  computes the correlations of the delays in [firstDelay, lastDelay)
+	   * from the cross-spectrum generating the phase terms by recurrence.
+	   */
+	void calculateRecurrenceCorrelations(BaseType *correlations, int firstDelay, int lastDelay) const;
+};
+
+template <typename T>
+void TauMatrix::calculatePhatCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right, int firstBin, int nbins,
+					   T *crossRe, T *crossIm)
+{
+  for (int k = 0; k < nbins; ++k)
+  {
+    const BaseTypeC &l = left[firstBin + k];
+    const BaseTypeC &r = right[firstBin + k];
+
+    // X_l * conj(X_r)
+    double re = l.re*r.re + l.im*r.im;
+    double im = l.im*r.re - l.re*r.im;
+    double magnitude = sqrt(re*re + im*im);
+
+    if (magnitude > 1e-20)
+    {
+      crossRe[k] = re/magnitude;
+      crossIm[k] = im/magnitude;
+    }
+    else
+    {
+      crossRe[k] = 0;
+      crossIm[k] = 0;
+    }
+  }
+}
+
+template <typename T>
+void TauMatrix::calculatePhaseTerms(BaseType tau, int firstBin, int nbins, int complexLength, T *cosRow, T *sinRow)
+{
+  // w_k = 2*pi*k/N, with N = 2*(complexLength-1) the length of the FFT.
+  double w0 = M_PI/(complexLength-1);
+  for (int k = 0; k < nbins; ++k)
+  {
+    double phase = w0*(firstBin + k)*tau;
+    cosRow[k] = cos(phase);
+    sinRow[k] = sin(phase);
+  }
+}
+
+}
+
+#endif // __MCA_TAUMATRIX_H_
@@ -0,0 +1,75 @@
+/*
+* WorkerPool.h
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MCA_WORKERPOOL_H_
+#define __MCA_WORKERPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mca
+{
+
+/**
+ * @brief The WorkerPool class keeps a fixed set of threads alive to run one
+ * job per frame without paying the cost of creating threads in the real-time loop.
+ * A job is a function called once per worker with the worker index in [0, size()).
+ * The calling thread acts as worker 0, and run() returns when every worker is done,
+ * so the way work is split among workers only depends on the job itself.
+ * Jobs must not throw.
+ */
+class WorkerPool
+{
+    public:
+	/**
+	   * @brief WorkerPool  starts nworkers-1 threads (the caller is the remaining worker).
+	   * @param nworkers  total number of workers, at least 1.
+	   */
+	WorkerPool(int nworkers);
+	virtual ~WorkerPool();
+
+	/**
+	   * @brief run  calls job(worker) for every worker and waits until all of them finish.
+	   * @param job  function to run by each worker.
+	   */
+	void run(const std::function<void(int)> &job);
+
+	inline int size() const {return static_cast<int>(_threads.size()) + 1;}
+
+    private:
+	std::vector<std::thread> _threads; /**< worker threads, worker i+1 is _threads[i] */
+	std::mutex _mutex;
+	std::condition_variable _start; /**< signaled when a new job is available or on stop */
+	std::condition_variable _done; /**< signaled when the last worker finishes the job */
+	const std::function<void(int)> *_job; /**< job being run, only valid during run() */
+	unsigned long _generation; /**< incremented for every job, so that each thread runs it only once */
+	int _pending; /**< number of threads that did not finish the current job yet */
+	bool _stop;
+
+	void workerLoop(int worker);
+};
+
+}
+
+#endif // __MCA_WORKERPOOL_H_
@@ -41,6 +41,9 @@ float doaToDelayFarFieldSamples(float doa, float microDist, int sampleRate);
 float delayToDOA(float delay, float microDist);
 float delaySamplesToDOA(float delay, float microDist, float sampleRate);
 float maxFreqForSpatialAliasing(float microphoneDistance);
+// One-sided FFT bins [firstBin, lastBin) from minFreq to the spatial aliasing frequency of a pair,
+// with at least one bin. Below ~100 Hz bins carry mostly noise.
+void getUsefulBand(float microphoneDistance, int sampleRate, int complexLength, int &firstBin, int &lastBin, float minFreq=100);
 inline float toDegrees(float radians){return radians*M_1_PI*180;}
 SignalPtr toDegrees(SignalPtr radians, int length);
 inline float toRadians(float degrees){return degrees*M_PI/180;}
@@ -0,0 +1,257 @@
+/*
+* AdaptiveBeamformer.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/AdaptiveBeamformer.h>
+#include <mcarray/microhponeArrayHelpers.h>
+#include <mcarray/mcarray_exception.h>
+
+#include <complex>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+typedef std::complex<BaseType> ComplexD;
+
+AdaptiveBeamformer::AdaptiveBeamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels,
+				       unsigned int nbeams, BeamformerType type) :
+  Beamformer(sampleRate, microphonePositions, fftCCSLength, nchannels, nbeams),
+  _type(type),
+  _complexLength(fftCCSLength/2),
+  _storedSnapshots(0)
+{
+  if (_type != MVDR && _type != SUPERDIRECTIVE)
+  {
+    std::ostringstream oss;
+    oss << "Adaptive beamformer type has to be MVDR or SUPERDIRECTIVE: " << _type;
+    throw(MCArrayException(oss.str()));
+  }
+
+  allocate();
+
+  if (_type == SUPERDIRECTIVE)
+  {
+    setDiffuseNoiseCoherence();
+    factorise(_superdirectiveLoading);
+  }
+  else
+  {
+    // No covariance estimated yet: identity factors give the delay-and-sum weights.
+    factorise(0);
+  }
+
+  for (unsigned int b = 0; b < _nbeams; ++b)
+    setWeights(b, _beamDOAs[b]);
+}
+
+void AdaptiveBeamformer::allocate()
+{
+  int matrixSize = _nchannels*_nchannels;
+  _covariance.reset(new BaseTypeC[_complexLength*matrixSize]);
+  _choleskyFactors.reset(new BaseTypeC[_complexLength*matrixSize]);
+  _steeringVector.reset(new BaseTypeC[_nchannels]);
+  _solution.reset(new BaseTypeC[_nchannels]);
+  if (_type == MVDR)
+    _snapshots.reset(new BaseTypeC[_complexLength*_updatePeriod*_nchannels]);
+
+  ComplexD *R = reinterpret_cast<ComplexD*>(_covariance.get());
+  for (int i = 0; i < _complexLength*matrixSize; ++i)
+    R[i] = 0;
+
+  _singleOutput.resize(1);
+}
+
+void AdaptiveBeamformer::setDiffuseNoiseCoherence()
+{
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    ComplexD *R = reinterpret_cast<ComplexD*>(&_covariance[k*_nchannels*_nchannels]);
+    double w = 2*M_PI*k*_sampleRate/(_fftCCSLength-2)/getSpeedOfSound();
+    for (int i = 0; i < _nchannels; ++i)
+    {
+      for (int j = 0; j < _nchannels; ++j)
+      {
+	double x = w*_microphonePositions.distance(i, j);
+	R[i*_nchannels + j] = (x == 0) ? 1.0 : sin(x)/x;
+      }
+    }
+  }
+}
+
+void AdaptiveBeamformer::updateCovariance()
+{
+  double forget = pow(_covarianceMemoryFactor, _storedSnapshots);
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    ComplexD *R = reinterpret_cast<ComplexD*>(&_covariance[k*_nchannels*_nchannels]);
+    const ComplexD *X = reinterpret_cast<const ComplexD*>(&_snapshots[k*_updatePeriod*_nchannels]);
+
+    // Only the lower triangle is used by the factorisation.
+    for (int i = 0; i < _nchannels; ++i)
+      for (int j = 0; j <= i; ++j)
+	R[i*_nchannels + j] *= forget;
+
+    double gain = 1 - _covarianceMemoryFactor;
+    for (int f = _storedSnapshots - 1; f >= 0; --f, gain *= _covarianceMemoryFactor)
+    {
+      const ComplexD *x = &X[f*_nchannels];
+      for (int i = 0; i < _nchannels; ++i)
+      {
+	ComplexD gx = gain*x[i];
+	for (int j = 0; j <= i; ++j)
+	  R[i*_nchannels + j] += gx*std::conj(x[j]);
+      }
+    }
+  }
+  _storedSnapshots = 0;
+}
+
+void AdaptiveBeamformer::factorise(double loading)
+{
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    const ComplexD *R = reinterpret_cast<const ComplexD*>(&_covariance[k*_nchannels*_nchannels]);
+    ComplexD *L = reinterpret_cast<ComplexD*>(&_choleskyFactors[k*_nchannels*_nchannels]);
+
+    double trace = 0;
+    for (int i = 0; i < _nchannels; ++i)
+      trace += R[i*_nchannels + i].real();
+    double diagonal = loading*trace/_nchannels;
+
+    bool valid = (trace > 0);
+    for (int j = 0; j < _nchannels && valid; ++j)
+    {
+      double d = R[j*_nchannels + j].real() + diagonal;
+      for (int p = 0; p < j; ++p)
+	d -= std::norm(L[j*_nchannels + p]);
+      if (d <= 0)
+      {
+	valid = false;
+	break;
+      }
+      d = sqrt(d);
+      L[j*_nchannels + j] = d;
+
+      for (int i = j + 1; i < _nchannels; ++i)
+      {
+	ComplexD v = R[i*_nchannels + j];
+	for (int p = 0; p < j; ++p)
+	  v -= L[i*_nchannels + p]*std::conj(L[j*_nchannels + p]);
+	L[i*_nchannels + j] = v/d;
+      }
+    }
+
+    // Without energy (or numerically singular) the bin falls back to delay-and-sum.
+    if (!valid)
+    {
+      for (int i = 0; i < _nchannels; ++i)
+	for (int j = 0; j < _nchannels; ++j)
+	  L[i*_nchannels + j] = (i == j) ? 1.0 : 0.0;
+    }
+  }
+}
+
+void AdaptiveBeamformer::setWeights(unsigned int beam, double DOA)
+{
+  ComplexD *a = reinterpret_cast<ComplexD*>(_steeringVector.get());
+  ComplexD *z = reinterpret_cast<ComplexD*>(_solution.get());
+  _beamDOAs[beam] = DOA;
+
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    const ComplexD *L = reinterpret_cast<const ComplexD*>(&_choleskyFactors[k*_nchannels*_nchannels]);
+
+    // a_c = e^{-jk*step_c}, so that the delay-and-sum output is a^H x / nchannels.
+    for (int c = 0; c < _nchannels; ++c)
+      a[c] = std::polar(1.0, -k*phaseStep(c, DOA));
+
+    // L y = a
+    for (int i = 0; i < _nchannels; ++i)
+    {
+      ComplexD v = a[i];
+      for (int p = 0; p < i; ++p)
+	v -= L[i*_nchannels + p]*z[p];
+      z[i] = v/L[i*_nchannels + i].real();
+    }
+    // L^H z = y
+    for (int i = _nchannels - 1; i >= 0; --i)
+    {
+      ComplexD v = z[i];
+      for (int p = i + 1; p < _nchannels; ++p)
+	v -= std::conj(L[p*_nchannels + i])*z[p];
+      z[i] = v/L[i*_nchannels + i].real();
+    }
+
+    ComplexD response = 0;
+    for (int c = 0; c < _nchannels; ++c)
+      response += std::conj(a[c])*z[c];
+
+    // Output is sum_c w_c*x_c, so conj(R^-1 a)/(a^H R^-1 a) is stored.
+    for (int c = 0; c < _nchannels; ++c)
+    {
+      ComplexD w = std::conj(z[c])/response.real();
+      _steering.getReal(steeringIndex(beam, c))[k] = w.real();
+      _steering.getImag(steeringIndex(beam, c))[k] = w.imag();
+    }
+  }
+}
+
+void AdaptiveBeamformer::processFrame(SignalVector &analysisFrames, SignalPtr outputFrame, double DOA)
+{
+  _singleOutput[0] = outputFrame;
+  processFrame(analysisFrames, _singleOutput, &DOA, 1);
+  _singleOutput[0].reset();
+}
+
+void AdaptiveBeamformer::processFrame(SignalVector &analysisFrames, SignalVector &outputFrames, const BaseType *DOAs, unsigned int nbeams)
+{
+  checkNumberOfBeams(nbeams);
+
+  bool updated = false;
+  if (_type == MVDR)
+  {
+    // Stored before applying the weights, outputs might be written over the inputs.
+    for (int c = 0; c < _nchannels; ++c)
+    {
+      const BaseTypeC *x = reinterpret_cast<const BaseTypeC*>(analysisFrames[c].get());
+      for (int k = 0; k < _complexLength; ++k)
+	_snapshots[(k*_updatePeriod + _storedSnapshots)*_nchannels + c] = x[k];
+    }
+
+    if (++_storedSnapshots == _updatePeriod)
+    {
+      updateCovariance();
+      factorise(_diagonalLoading);
+      updated = true;
+    }
+  }
+
+  for (unsigned int b = 0; b < _nbeams; ++b)
+  {
+    double DOA = (b < nbeams) ? DOAs[b] : _beamDOAs[b];
+    if (updated || DOA != _beamDOAs[b])
+      setWeights(b, DOA);
+  }
+
+  applySteering(analysisFrames, outputFrames, nbeams);
+}
+
+}
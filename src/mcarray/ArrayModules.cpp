@@ -23,18 +23,26 @@
 #include <mcarray/FastBinauralMasking.h>
 #include <mcarray/BinauralLocalisation.h>
 #include <mcarray/SourceSeparationAndLocalisation.h>
+#include <mcarray/SourceLocalisation.h>
 #include <mcarray/SoundLocalisationCallback.h>
 
 namespace mca {
 
-SoundLocalisation::SoundLocalisation(int sampleRate, ArrayDescription microphonePositions, LocalisationCallback *callback)
+SoundLocalisation::SoundLocalisation(int sampleRate, ArrayDescription microphonePositions, LocalisationCallback *callback,
+				     SteeringBeamforming::LocalisationMethod method, bool decimate) :
+  _sampleRate(sampleRate)
 {
     bool usePowerFloor = true;
 
+    // The localisation, and its table of delays, is built at the decimated rate.
+    if (decimate)
+	_frontEnd.reset(new DecimatingFrontEnd(sampleRate, microphonePositions));
+    int analysisRate = getAnalysisSampleRate();
+
     if (microphonePositions.size() == 2)
     {
 	FreqGCCBinauralLocalisation *loc = nullptr;
-	loc = new FreqGCCBinauralLocalisation(sampleRate, microphonePositions, usePowerFloor);
+	loc = new FreqGCCBinauralLocalisation(analysisRate, microphonePositions, usePowerFloor);
 	if (callback != NULL)
 	{
 	    loc->setCallback(callback);
@@ -43,9 +51,8 @@ SoundLocalisation::SoundLocalisation(int sampleRate, ArrayDescription microphone
     }
     else
     {
-	// Carefull, this 512 should not be here !!! I do not know why it is here.
-	BeamformingSeparationAndLocalisation *loc;
-	loc = new BeamformingSeparationAndLocalisation(sampleRate, 512, microphonePositions, 1, true);
+	SourceLocalisation *loc;
+	loc = new SourceLocalisation(analysisRate, microphonePositions, 1, usePowerFloor, method);
 	if (callback != NULL)
 	{
 	    loc->setCallback(callback);
@@ -53,13 +60,26 @@ SoundLocalisation::SoundLocalisation(int sampleRate, ArrayDescription microphone
 	_impl.reset(dynamic_cast<dsp::ShortTimeAnalysis*>(loc));
     }
 
+    if (_frontEnd)
+	_frontEnd->addAnalyser(_impl.get());
 }
 
 SoundLocalisation::~SoundLocalisation()
 {
+  _frontEnd.reset();
   _impl.reset();
 }
 
+int SoundLocalisation::process(const std::vector<double*> &input, int length)
+{
+    if (_frontEnd)
+	return _frontEnd->process(input, length);
+
+    _input.assign(input.begin(), input.end());
+    _impl->process(_input, length);
+    return length;
+}
+
 
 BinauralMasking::BinauralMasking(int samplerate,
 				 ArrayDescription microphones,
@@ -68,16 +88,12 @@ BinauralMasking::BinauralMasking(int samplerate,
 				 MaskingMethod mmethod,
 				 MaskingAlg algorithm)
 {
-    double microDist = 0;
-    if (microphones.size() > 1)
-    {
-	microDist = microphones.distance(0,1);
-    }
-
+    // One channel per microphone, spatial masking uses the pairs of nearest neighbours.
     _impl.reset(new FastBinauralMasking(samplerate,
-					microDist,
+					microphones,
 					lowFreq,
 					highFreq,
+					FastBinauralMasking::Config(),
 					mmethod,
 					algorithm));
 
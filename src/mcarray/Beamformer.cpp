@@ -21,20 +21,27 @@
 */
 #include <mcarray/Beamformer.h>
 #include <mcarray/microhponeArrayHelpers.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
 
 #include <wipp/wipputils.h>
 #include <wipp/wippsignal.h>
 //#include <wipp/wippstats.h>
 
 //#include <math.h>
+#include <sstream>
 
 namespace mca {
 
-Beamformer::Beamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels) :
+Beamformer::Beamformer(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels, unsigned int nbeams) :
   _sampleRate(sampleRate),
   _fftCCSLength(fftCCSLength),
   _nchannels(nchannels),
-  _microphonePositions(microphonePositions)
+  _microphonePositions(microphonePositions),
+  _nbeams(nbeams),
+  _steering(nbeams*nchannels, fftCCSLength/2),
+  _splitInput(nchannels, fftCCSLength/2),
+  _splitOutput(1, fftCCSLength/2)
 {
   allocate();
 }
@@ -46,6 +53,60 @@ void Beamformer::allocate()
   _complexRamp.reset(new BaseTypeC[_fftCCSLength/2]);
   _ones.reset(new BaseType[_fftCCSLength/2]);
   wipp::set(1.0, _ones.get(), _fftCCSLength/2);
+
+  _beamDOAs.reset(new BaseType[_nbeams + 1]);
+  for (unsigned int b = 0; b < _nbeams; ++b)
+    setSteering(b, 0.0);
+}
+
+double Beamformer::phaseStep(int channel, double DOA) const
+{
+  return 2*M_PI*_sampleRate/(_fftCCSLength-2)/getSpeedOfSound()*_microphonePositions.getX(channel)*cos(DOA+M_PI/2);
+}
+
+void Beamformer::checkNumberOfBeams(unsigned int nbeams) const
+{
+  if (nbeams > _nbeams)
+  {
+    std::ostringstream oss;
+    oss << "Beamformer was configured for " << _nbeams << " beams, but " << nbeams << " were requested.";
+    throw(MCArrayException(oss.str()));
+  }
+}
+
+void Beamformer::setSteering(unsigned int beam, double DOA)
+{
+  int complexLength = _fftCCSLength/2;
+  _beamDOAs[beam] = DOA;
+
+  for (int c = 0; c < _nchannels; ++c)
+  {
+    // Same phase ramp as the single beam processFrame: phase(k) = k*step.
+    // The ramp is generated by rotating a phasor e^{j*step} bin by bin.
+    double step = phaseStep(c, DOA);
+    const BaseType rotationRe = cos(step);
+    const BaseType rotationIm = sin(step);
+    BaseType *re = _steering.getReal(steeringIndex(beam, c));
+    BaseType *im = _steering.getImag(steeringIndex(beam, c));
+    BaseType phasorRe = 1, phasorIm = 0;
+    for (int k = 0; k < complexLength; ++k)
+    {
+      re[k] = phasorRe/_nchannels;
+      im[k] = phasorIm/_nchannels;
+
+      BaseType rotated = phasorRe*rotationRe - phasorIm*rotationIm;
+      phasorIm = phasorRe*rotationIm + phasorIm*rotationRe;
+      phasorRe = rotated;
+
+      // Rounding errors of the products make the magnitude drift away from 1.
+      if ((k + 1) % _renormalisationPeriod == 0)
+      {
+	BaseType gain = 1/sqrt(phasorRe*phasorRe + phasorIm*phasorIm);
+	phasorRe *= gain;
+	phasorIm *= gain;
+      }
+    }
+  }
 }
 
 void Beamformer::processFrame(SignalVector &analysisFrames, SignalPtr outputFrame, double DOA)
@@ -56,7 +117,7 @@ void Beamformer::processFrame(SignalVector &analysisFrames, SignalPtr outputFram
     for (int c = 0; c < _nchannels; ++c)
     {
       //	ippsVectorRamp_64f(_phase.get(),  _fftCCSLength/2, 0, 2*M_PI*_sampleRate/(_fftCCSLength-2)/getSpeedOfSound()*_microphonePositions[c]*cos(DOA+M_PI/2));
-	wipp::ramp(_phase.get(), _fftCCSLength/2, 0, 2*M_PI*_sampleRate/(_fftCCSLength-2)/getSpeedOfSound()*_microphonePositions.getX(c)*cos(DOA+M_PI/2));
+	wipp::ramp(_phase.get(), _fftCCSLength/2, 0, phaseStep(c, DOA));
 	wipp::polar2cart(_ones.get(), _phase.get(), reinterpret_cast<wipp::wipp_complex_t*>(_complexRamp.get()), _fftCCSLength/2);
 	wipp::mult(reinterpret_cast<wipp::wipp_complex_t*>(analysisFrames[c].get()),
 		   reinterpret_cast<wipp::wipp_complex_t*>(_complexRamp.get()),
@@ -70,7 +131,41 @@ void Beamformer::processFrame(SignalVector &analysisFrames, SignalPtr outputFram
     wipp::divC(_nchannels, outputFrame.get(), _fftCCSLength);
 }
 
+void Beamformer::processFrame(SignalVector &analysisFrames, SignalVector &outputFrames, const BaseType *DOAs, unsigned int nbeams)
+{
+  checkNumberOfBeams(nbeams);
+
+  for (unsigned int b = 0; b < nbeams; ++b)
+  {
+    if (DOAs[b] != _beamDOAs[b])
+      setSteering(b, DOAs[b]);
+  }
+
+  applySteering(analysisFrames, outputFrames, nbeams);
+}
+
+void Beamformer::applySteering(SignalVector &analysisFrames, SignalVector &outputFrames, unsigned int nbeams)
+{
+  int complexLength = _fftCCSLength/2;
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
 
+  // Inputs are converted before any output is written, outputs may be the same buffers.
+  for (int c = 0; c < _nchannels; ++c)
+    _splitInput.deinterleave(reinterpret_cast<const BaseTypeC*>(analysisFrames[c].get()), c);
 
+  BaseType *yRe = _splitOutput.getReal(0);
+  BaseType *yIm = _splitOutput.getImag(0);
+  for (unsigned int b = 0; b < nbeams; ++b)
+  {
+    _splitOutput.setZeros(0);
+    for (int c = 0; c < _nchannels; ++c)
+    {
+      unsigned int plane = steeringIndex(b, c);
+      kernels.splitMultiplyAccumulate(_steering.getReal(plane), _steering.getImag(plane),
+				      _splitInput.getReal(c), _splitInput.getImag(c), complexLength, yRe, yIm);
+    }
+    _splitOutput.interleave(0, reinterpret_cast<BaseTypeC*>(outputFrames[b].get()));
+  }
 }
 
+}
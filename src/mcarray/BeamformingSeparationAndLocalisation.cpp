@@ -20,73 +20,135 @@
 * along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <mcarray/BeamformingSeparationAndLocalistaion.h>
+#include <mcarray/AdaptiveBeamformer.h>
+#include <mcarray/mcarray_exception.h>
 #include <dspone/algorithm/signalPower.h>
 
 #include <wipp/wipputils.h>
 
+#include <algorithm>
+#include <math.h>
+#include <sstream>
+
 namespace mca {
 
 BeamformingSeparationAndLocalisation::BeamformingSeparationAndLocalisation(int sampleRate, int fftCCSLength, ArrayDescription microphonePositions,
-									   unsigned int numOfSources, bool usePowerFloor) :
+									   unsigned int numOfSources, bool usePowerFloor, Beamformer::BeamformerType beamformerType,
+									   SteeringBeamforming::LocalisationMethod localisationMethod) :
   SoundLocalisationImpl(microphonePositions),
   _nchannels(microphonePositions.size()),
   _sampleRate(sampleRate),
   _fftCCSLength(fftCCSLength),
   _usePowerFloor(usePowerFloor),
   _numOfSources(numOfSources),
-  _steeringBeamforming(sampleRate, microphonePositions, fftCCSLength, _nchannels),
-  _beamformer(sampleRate, microphonePositions, fftCCSLength, _nchannels)
+  _steeringBeamforming(sampleRate, microphonePositions, fftCCSLength, _nchannels, localisationMethod),
+  _sourceCounting(false),
+  _activeSources(numOfSources),
+  _framesSinceLocalisation(0),
+  _localisations(0),
+  _localisedPower(0)
 {
+  unsigned int nbeams = std::min(_nchannels, _numOfSources);
+  if (beamformerType == Beamformer::DELAY_AND_SUM)
+    _beamformer.reset(new Beamformer(sampleRate, microphonePositions, fftCCSLength, _nchannels, nbeams));
+  else
+    _beamformer.reset(new AdaptiveBeamformer(sampleRate, microphonePositions, fftCCSLength, _nchannels, nbeams, beamformerType));
+
+  // Frames overlap by half of the window.
+  initPowerFloor(static_cast<double>(fftCCSLength - 2)/(2*sampleRate), _noiseMarginDB);
   allocate();
 }
 
 void BeamformingSeparationAndLocalisation::allocate()
 {
-  for (unsigned int c = 0; c < _nchannels; ++c)
-    _inputFrames.push_back(SignalPtr(new BaseType[_fftCCSLength]));
-
   _currentDOA.reset(new BaseType[_numOfSources]);
   _prob.reset(new BaseType[_numOfSources]);
 
   wipp::setZeros(_currentDOA.get(), _numOfSources);
   wipp::set(-1.0, _prob.get(), _numOfSources);
+
+  _magnitude.reset(new BaseType[_fftCCSLength/2]);
+  _localisedMagnitude.reset(new BaseType[_fftCCSLength/2]);
+  wipp::setZeros(_localisedMagnitude.get(), _fftCCSLength/2);
 }
 
-BaseType BeamformingSeparationAndLocalisation::setPowerFloor(SignalVector &analysisFrames, int fftCCSLength, int nchannels, int sampleRate)
+void BeamformingSeparationAndLocalisation::setLocalisationRate(const LocalisationRate &rate)
 {
-  int neededSamples = _durationToEstimatePowerFloor*sampleRate;
-  double power = dsp::SignalPower::FFTPower(analysisFrames, fftCCSLength)*(fftCCSLength-2);
-//      dsp::calculateLinearPowerFFT(analysisFrames, fftCCSLength, nchannels)*(fftCCSLength-2);
-  _powerFloor += power;
-  _samplesConsumedForNoise += (fftCCSLength-2);
-  if (_samplesConsumedForNoise >= neededSamples)
+  if (rate.period < 1 || rate.powerChange < 0 || rate.spectralChange < 0)
   {
-    _noiseEstimated = true;
-    _powerFloor /= _samplesConsumedForNoise;
-    _powerFloor = 10*log10(_powerFloor) + _noiseMarginDB;
+    std::ostringstream oss;
+    oss << "The localisation period has to be at least 1 frame and the change thresholds cannot be negative, "
+	<< rate.period << ", " << rate.powerChange << " and " << rate.spectralChange << " given.";
+    throw(MCArrayException(oss.str()));
+  }
+  _rate = rate;
+  _framesSinceLocalisation = 0;
+}
+
+void BeamformingSeparationAndLocalisation::setSourceCounting(bool enable)
+{
+  _sourceCounting = enable;
+  if (!enable)
+    _activeSources = _numOfSources;
+}
+
+bool BeamformingSeparationAndLocalisation::isLocalisationDue(const SignalVector &analysisFrames, BaseType power)
+{
+  // The first frame after a silence is always localised, the sources may have changed.
+  bool due = (_framesSinceLocalisation == 0 || _framesSinceLocalisation >= _rate.period);
+
+  if (!due && _rate.powerChange > 0)
+    due = fabs(power - _localisedPower) > _rate.powerChange;
 
-    DEBUG_STREAM("POWER floor: " << _powerFloor);
+  if (_rate.spectralChange > 0)
+  {
+    // Half-wave rectified flux of the first channel, relative to the magnitude of the current frame.
+    int complexLength = _fftCCSLength/2;
+    wipp::magnitude(reinterpret_cast<wipp::wipp_complex_t*>(analysisFrames[0].get()), _magnitude.get(), complexLength);
+    if (!due)
+    {
+      BaseType flux = 0, total = 0;
+      for (int k = 0; k < complexLength; ++k)
+      {
+	flux += std::max(0.0, _magnitude[k] - _localisedMagnitude[k]);
+	total += _magnitude[k];
+      }
+      due = (total > 0 && flux > _rate.spectralChange*total);
+    }
+    if (due)
+      wipp::copyBuffer(_magnitude.get(), _localisedMagnitude.get(), complexLength);
   }
 
-  return _powerFloor;
+  if (due)
+  {
+    _localisedPower = power;
+    _framesSinceLocalisation = 0;
+  }
+  ++_framesSinceLocalisation;
+  return due;
 }
 
-void BeamformingSeparationAndLocalisation::processFrameLocalisation(SignalVector &analysisFrames, SignalVector &wienerCoefs)
+BaseType BeamformingSeparationAndLocalisation::processFrameLocalisation(SignalVector &analysisFrames, SignalVector &wienerCoefs)
 {
   BaseType power;
 
-  // _powerFloor is estimated during an initial number of frames (only if _usePowerFloor==true).
-  // Once powerFloor is estimated (_noiseEstimated==true), the power of the current frame is obtained.
-  if (!_noiseEstimated && _usePowerFloor)
-    power = setPowerFloor(analysisFrames, _fftCCSLength, _nchannels, _sampleRate);
-  else
-    power = dsp::SignalPower::FFTLogPower(analysisFrames, _fftCCSLength);
+  // The noise floor is tracked with the power of every frame (only if _usePowerFloor==true).
+  power = dsp::SignalPower::FFTLogPower(analysisFrames, _fftCCSLength);
   //	dsp::calculateLogPowerFFT(analysisFrames, _fftCCSLength, _nchannels);
 
   // If the power of the current frame is greater than _powerFloor, then the frame is processed.
-  if ((power > _powerFloor) || !_usePowerFloor)
+  if (!_usePowerFloor || updatePowerFloor(power))
   {
+    // Between localisations the separation keeps the last DOAs.
+    if (!isLocalisationDue(analysisFrames, power))
+    {
+      TRACE_STREAM("Localisation skipped, " << _framesSinceLocalisation - 1 << " frames since the last one.");
+      return power;
+    }
+    ++_localisations;
     _steeringBeamforming.processFrame(analysisFrames, _currentDOA, _prob, _numOfSources, wienerCoefs);
+    if (_sourceCounting)
+      _activeSources = _steeringBeamforming.getNumberOfActiveSources();
     // We publish only the DOA of the first source.
     if (_ptrCallback)
     {
@@ -96,24 +158,31 @@ void BeamformingSeparationAndLocalisation::processFrameLocalisation(SignalVector
   }
   else
   {
-    TRACE_STREAM("Power is not high enough. Power: " << power << ", floor: " << powerFloor);
+    TRACE_STREAM("Power is not high enough. Power: " << power << ", floor: " << _powerFloor);
+    _framesSinceLocalisation = 0;
   }
+
+  return power;
 }
 
-void BeamformingSeparationAndLocalisation::processFrameSeparation(SignalVector &inputFrames, SignalVector &outputFrames)
+void BeamformingSeparationAndLocalisation::processSilentFrame(BaseType power)
 {
-  unsigned int c;
+  if (_usePowerFloor)
+    updatePowerFloor(power);
+  _framesSinceLocalisation = 0;
+  TRACE_STREAM("Silent frame skipped. Power: " << power << ", floor: " << _powerFloor);
+}
 
-  // To prevent incorrect behaivor when inputFrames and outputFrames are the same pointer
-  // (inputFrames cannot be modified until all outputFrames are computed)
-  for (c = 0; c < _nchannels; ++c)
-    wipp::copyBuffer(inputFrames[c].get(), _inputFrames[c].get(), _fftCCSLength);
+void BeamformingSeparationAndLocalisation::processFrameSeparation(SignalVector &inputFrames, SignalVector &outputFrames)
+{
+  unsigned int c = std::min(_nchannels, std::min(_numOfSources, _activeSources));
 
-  // Compute "min(_nchannels, _numOfSources)" outputs and store them in outputFrames.
-  for (c = 0; c < std::min(_nchannels, _numOfSources); ++c)
-    _beamformer.processFrame(_inputFrames, outputFrames[c], _currentDOA[c]);
+  // Compute one output per active source (up to _nchannels) in one pass and store them in outputFrames.
+  // The beamformer reads each bin of all inputs before writing it, so inputFrames and
+  // outputFrames can be the same buffers without copying the input first.
+  _beamformer->processFrame(inputFrames, outputFrames, _currentDOA.get(), c);
 
-  // Set to zero the remaining channels (when _numOfSources < _nchannels).
+  // Set to zero the remaining channels (inactive sources or when _numOfSources < _nchannels).
   for (; c < _nchannels; ++c)
     wipp::setZeros(outputFrames[c].get(), _fftCCSLength);
 }
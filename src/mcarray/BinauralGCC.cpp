@@ -0,0 +1,170 @@
+/*
+* BinauralGCC.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/BinauralGCC.h>
+#include <mcarray/TauMatrix.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
+
+#include <wipp/wipputils.h>
+
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+BinauralGCC::BinauralGCC(const BaseType *tau, int tauLength, int firstBin, int lastBin, int complexLength) :
+  _tauLength(tauLength),
+  _firstBin(std::max(0, firstBin)),
+  _lastBin(std::min(complexLength, lastBin)),
+  _nbins(std::max(0, _lastBin - _firstBin)),
+  _nblocks((_nbins + _blockLength - 1)/_blockLength),
+  _frameCapacity(0)
+{
+  if (complexLength < 2)
+  {
+    std::ostringstream oss;
+    oss << "One-sided FFT length has to be at least 2: " << complexLength;
+    throw(MCArrayException(oss.str()));
+  }
+
+  // Delays of a DOA grid are symmetric up to the rounding errors of the float angles,
+  // a mismatch below _symmetryTolerance gives a phase error far below the float32 table precision.
+  _symmetric = true;
+  for (int t = 0; t < _tauLength && _symmetric; ++t)
+    _symmetric = fabs(tau[t] + tau[_tauLength - 1 - t]) <= _symmetryTolerance;
+  _nrows = _symmetric ? (_tauLength + 1)/2 : _tauLength;
+
+  int tableLength = _nblocks*_nrows*_blockLength;
+  _cos.reset(new BaseType32[tableLength + 1]);
+  _sin.reset(new BaseType32[tableLength + 1]);
+
+  wipp::setZeros(_cos.get(), tableLength);
+  wipp::setZeros(_sin.get(), tableLength);
+  reserveFrames(1);
+
+  // Same phase terms as the rows of a TauMatrix, split in blocks.
+  for (int b = 0; b < _nblocks; ++b)
+  {
+    int nbins = std::min(_blockLength, _nbins - b*_blockLength);
+    for (int r = 0; r < _nrows; ++r)
+      TauMatrix::calculatePhaseTerms(tau[r], _firstBin + b*_blockLength, nbins, complexLength,
+				     &_cos[(b*_nrows + r)*_blockLength], &_sin[(b*_nrows + r)*_blockLength]);
+  }
+}
+
+void BinauralGCC::reserveFrames(int nframes)
+{
+  if (nframes <= _frameCapacity)
+    return;
+
+  // The padding of the last block has to be zero.
+  int crossLength = nframes*_nblocks*_blockLength;
+  _crossRe.reset(new BaseType32[crossLength + 1]);
+  _crossIm.reset(new BaseType32[crossLength + 1]);
+  wipp::setZeros(_crossRe.get(), crossLength);
+  wipp::setZeros(_crossIm.get(), crossLength);
+  _cosSums.reset(new BaseType[nframes*_nrows + 1]);
+  _sinSums.reset(new BaseType[nframes*_nrows + 1]);
+  _frameCapacity = nframes;
+}
+
+void BinauralGCC::calculateCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right, int frame)
+{
+  TauMatrix::calculatePhatCrossSpectrum(left, right, _firstBin, _nbins,
+					&_crossRe[frame*_nblocks*_blockLength], &_crossIm[frame*_nblocks*_blockLength]);
+}
+
+void BinauralGCC::calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations)
+{
+  calculateRows(&left, &right, 1, correlations, 0, _tauLength);
+}
+
+void BinauralGCC::calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations,
+					int firstDelay, int lastDelay)
+{
+  calculateRows(&left, &right, 1, correlations, std::max(0, firstDelay), std::min(_tauLength, lastDelay));
+}
+
+void BinauralGCC::calculateCorrelations(const BaseTypeC *const *left, const BaseTypeC *const *right, int nframes, BaseType *correlations)
+{
+  calculateRows(left, right, nframes, correlations, 0, _tauLength);
+}
+
+void BinauralGCC::calculateRows(const BaseTypeC *const *left, const BaseTypeC *const *right, int nframes, BaseType *correlations,
+				int firstDelay, int lastDelay)
+{
+  reserveFrames(nframes);
+  for (int f = 0; f < nframes; ++f)
+    calculateCrossSpectrum(left[f], right[f], f);
+
+  // Delay t is stored in row t, or in row T-1-t if only half of the rows are stored.
+  // The rows of a range of delays are contiguous.
+  int firstRow = _nrows, lastRow = 0;
+  for (int t = firstDelay; t < lastDelay; ++t)
+  {
+    int r = (t < _nrows) ? t : _tauLength - 1 - t;
+    firstRow = std::min(firstRow, r);
+    lastRow = std::max(lastRow, r + 1);
+  }
+
+  wipp::setZeros(_cosSums.get(), nframes*_nrows);
+  wipp::setZeros(_sinSums.get(), nframes*_nrows);
+
+  // Each block of a row is read once for all the frames.
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
+  int crossLength = _nblocks*_blockLength;
+  for (int b = 0; b < _nblocks; ++b)
+  {
+    for (int r = firstRow; r < lastRow; ++r)
+    {
+      const BaseType32 *cosRow = &_cos[(b*_nrows + r)*_blockLength];
+      const BaseType32 *sinRow = &_sin[(b*_nrows + r)*_blockLength];
+      for (int f = 0; f < nframes; ++f)
+      {
+	BaseType32 cosSum, sinSum;
+	kernels.splitCorrelation32(&_crossRe[f*crossLength + b*_blockLength], &_crossIm[f*crossLength + b*_blockLength],
+				   cosRow, sinRow, _blockLength, &cosSum, &sinSum);
+	_cosSums[f*_nrows + r] += cosSum;
+	_sinSums[f*_nrows + r] += sinSum;
+      }
+    }
+  }
+
+  // Re{S*e^{jwt}} = S.re*cos(wt) - S.im*sin(wt), and sin changes its sign for -t.
+  for (int f = 0; f < nframes; ++f)
+  {
+    const BaseType *cosSums = &_cosSums[f*_nrows];
+    const BaseType *sinSums = &_sinSums[f*_nrows];
+    BaseType *frameCorrelations = &correlations[f*_tauLength];
+    for (int r = firstRow; r < lastRow; ++r)
+    {
+      if (r >= firstDelay && r < lastDelay)
+	frameCorrelations[r] = cosSums[r] - sinSums[r];
+      int mirror = _tauLength - 1 - r;
+      if (_symmetric && mirror >= firstDelay && mirror < lastDelay)
+	frameCorrelations[mirror] = cosSums[r] + sinSums[r];
+    }
+  }
+}
+
+}
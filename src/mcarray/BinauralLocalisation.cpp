@@ -21,6 +21,7 @@
 */
 #include <mcarray/BinauralLocalisation.h>
 #include <mcarray/SoundLocalisationCallback.h>
+#include <mcarray/mcarray_exception.h>
 #include "SoundLocalisationParticleFilter.h"
 
 #include <dspone/algorithm/signalPower.h>
@@ -29,6 +30,7 @@
 #include <wipp/wipputils.h>
 #include <wipp/wippstats.h>
 
+#include <algorithm>
 #include <math.h>
 #include <sstream>
 
@@ -83,6 +85,8 @@ TemporalGCCBinauralLocalisation::TemporalGCCBinauralLocalisation(int sampleRate,
 	WARN_STREAM("The number of microphones in ArrayDescription is different from 2.");
     }
 
+    initPowerFloor(_frameRate, _noiseMarginDB);
+
     _currentDOA.reset(new BaseType[1]);
     _prob.reset(new BaseType[1]);
     _currentDOA[0] = 0;
@@ -138,20 +142,14 @@ void TemporalGCCBinauralLocalisation::processParametrisation(std::vector<double*
     BaseType power = 0;
     BaseType max = 0;
 
-    // Getting signal power, and setting as floor if the first signal frame is processed.
-    if (!_noiseEstimated)
-    {
-	power = setPowerFloor(analysisFrames, analysisLength, 2, _sampleRate);
-    }
-    else
-    {
-	power = dsp::SignalPower::logPower(analysisFrames, analysisLength);
-    }
+    // Getting signal power and tracking the noise floor with it.
+    power = dsp::SignalPower::logPower(analysisFrames, analysisLength);
+    bool signal = updatePowerFloor(power);
 
     DEBUG_STREAM("power " << power);
 
     // Only if singal power exceeds the floor power the DOA is obtained
-    if (power > _powerFloor)
+    if (signal)
     {
 	for (int nleftDelay = 0, nrightDelay= _ndelays;
 	     nleftDelay < _ndelays && nrightDelay > 0;
@@ -186,7 +184,7 @@ void TemporalGCCBinauralLocalisation::processParametrisation(std::vector<double*
 
     // Only if singal power exceeds the floor power the DOA is updated and
     // only in the same situation
-    if (power > _powerFloor)
+    if (signal)
 	_ptrCallback->setDOA(_currentDOA, _prob, power,1);
 
 }
@@ -283,57 +281,72 @@ double TemporalGCCBinauralLocalisation::samples2Degrees(int delay, int ndelays)
     return degrees;
 }
 
-BaseType TemporalGCCBinauralLocalisation::setPowerFloor(std::vector<BaseType*> &analysisFrames, int analysisLength, int nchannels, int sampleRate)
+//----------------- Freq GCC Binaural Localisation ---------------------------------------------------------------
+
+int FreqGCCBinauralLocalisation::Config::getFFTOrder(int sampleRate) const
 {
-  SignalVector af;
-  null_deleter deleter;
-  for (size_t i = 0; i < analysisFrames.size(); ++i)
-  {
-    af.push_back(boost::shared_array<double>(analysisFrames[i], deleter));
-  }
-  setPowerFloor(af, analysisLength, nchannels, sampleRate);
+    if (fftOrder > 0)
+	return fftOrder;
+    return calculateOrderFromSampleRate(sampleRate, frameRate);
 }
 
-
-BaseType TemporalGCCBinauralLocalisation::setPowerFloor(SignalVector &analysisFrames, int analysisLength,
-							int nchannels, int sampleRate)
+double FreqGCCBinauralLocalisation::getHopRatio(int sampleRate, int fftOrder)
 {
-    int neededSamples = _durationToEstimatePowerFloor*sampleRate;
-    analysisLength = std::min(neededSamples - _samplesConsumedForNoise, analysisLength);
-    double power = dsp::SignalPower::power(analysisFrames, analysisLength)*analysisLength;
-    _powerFloor += power;
-    _samplesConsumedForNoise += analysisLength;
-    if (_samplesConsumedForNoise >= neededSamples)
-    {
-	_noiseEstimated = true;
-	_powerFloor /= _samplesConsumedForNoise;
-	_powerFloor = 0.15*(100 - _powerFloor) + _powerFloor;  // 100 is ~20*log10(32000)
-	DEBUG_STREAM("POWER floor: " << _powerFloor);
-    }
-    return _powerFloor;
+    // Hops are a fixed fraction of the frame, 2^order samples long.
+    return ldexp(1.0, fftOrder - calculateOrderFromSampleRate(sampleRate, _frameRate));
 }
 
+FreqGCCBinauralLocalisation::FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, bool usePowerFloor, float frameRate) :
+    FreqGCCBinauralLocalisation(sampleRate, microphonePositions, Config(frameRate), usePowerFloor)
+{
 
+}
 
-//----------------- Freq GCC Binaural Localisation ---------------------------------------------------------------
-
-FreqGCCBinauralLocalisation::FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, bool usePowerFloor) :
+FreqGCCBinauralLocalisation::FreqGCCBinauralLocalisation(int sampleRate, ArrayDescription microphonePositions, const Config &config, bool usePowerFloor) :
     SoundLocalisationImpl(microphonePositions),
-    STFTAnalysis(2, calculateOrderFromSampleRate(sampleRate, _frameRate)),
+    STFTAnalysis(2, config.getFFTOrder(sampleRate)),
+    // Same time constants as with the hop of the default order, which keeps its factors as they are.
+    _frameCorrMemoryFactor(pow(_maxCorrMemoryFactor, getHopRatio(sampleRate, config.getFFTOrder(sampleRate)))),
+    _frameDoaMemoryFactor(pow(_maxDoaMemoryFactor, getHopRatio(sampleRate, config.getFFTOrder(sampleRate)))),
     _corrMemoryFactor(0),
     _doaMemoryFactor(0),
     _microphoneDistance(microphonePositions.distance(0,1)),
     _silenceFramesCounter(0),
     _sampleRate(sampleRate),
-    _doaStep(3*M_PI/180),
-    _numSteps(round(M_PI/_doaStep) + 1),
+    _doaStep(config.doaStep),
+    _numSteps(_doaStep > 0 ? round(M_PI/_doaStep) + 1 : 1),
     _usePowerFloor(usePowerFloor),
-    _gcc(getAnalysisLength()/2, _gcc.ONESIDEDFFT)
+    _consumedFrames(2),
+    _blockCapacity(0),
+    _precomputedCorrelations(NULL),
+    _trackingWindow(config.trackingWindow),
+    _fullSearchPeriod(config.fullSearchPeriod),
+    _trackedStep(-1),
+    _framesSinceFullSearch(0),
+    _preGate(2, getWindowSize())
 {
+    if (_doaStep <= 0 || _doaStep > M_PI)
+    {
+	std::ostringstream oss;
+	oss << "The step of the DOA grid has to be in (0, pi] radians, " << _doaStep << " given.";
+	throw(MCArrayException(oss.str()));
+    }
+
+    if (_trackingWindow < 0 || _fullSearchPeriod < 1)
+    {
+	std::ostringstream oss;
+	oss << "The tracking window cannot be negative and the full search period has to be at least 1 frame, "
+	    << _trackingWindow << " and " << _fullSearchPeriod << " given.";
+	throw(MCArrayException(oss.str()));
+    }
+
     if (_microphonePositions.size() != 2)
     {
 	WARN_STREAM("The number of microphones in ArrayDescription is different from 2.");
     }
+    // Time constants follow the real hop, which differs from config.frameRate when fftOrder is set.
+    initPowerFloor(_frameRate*getHopRatio(sampleRate, config.getFFTOrder(sampleRate)), _noiseMarginDB);
+
     _currentDOA.reset(new BaseType[1]);
     _prob.reset(new BaseType[1]);
     _currentDOA[0] = 0;
@@ -342,7 +355,6 @@ FreqGCCBinauralLocalisation::FreqGCCBinauralLocalisation(int sampleRate, ArrayDe
     _sampledDOAs.reset(new uint16_t[_numSteps]);
     _magnitude.reset(new BaseType[getAnalysisLength()/2]);
     _power.reset(new BaseType[getAnalysisLength()/2]);
-    _correlations.reset(new BaseTypeC[_numSteps]);
     _correlationsReal.reset(new BaseType[_numSteps]);
     _mixedChannel.reset(new BaseTypeC[getAnalysisLength()]);
     _samplesDelay.reset(new BaseType[_numSteps]);
@@ -368,41 +380,28 @@ FreqGCCBinauralLocalisation::FreqGCCBinauralLocalisation(int sampleRate, ArrayDe
 
     DEBUG_STREAM("MD: " << _microphoneDistance << " DOA step: " << toDegrees(_doaStep));
 
-    _gcc.precomputeTauMatrix(_samplesDelay.get(), _numSteps, getAnalysisLength()/2, _gcc.ONESIDEDFFT);
-}
-
-
-
-BaseType FreqGCCBinauralLocalisation::setPowerFloor(std::vector<BaseType*> &analysisFrames, int analysisLength, int nchannels, int sampleRate)
-{
-  SignalVector af;
-  null_deleter deleter;
-  for (size_t i = 0; i < analysisFrames.size(); ++i)
-  {
-    af.push_back(boost::shared_array<double>(analysisFrames[i], deleter));
-  }
-  setPowerFloor(af, analysisLength, nchannels, sampleRate);
-}
+    // Bins above the spatial aliasing frequency give ambiguous delays, and the lowest ones mostly noise.
+    int complexLength = getAnalysisLength()/2;
+    int firstBin = 0, lastBin = complexLength;
+    if (config.bandLimited)
+	getUsefulBand(_microphoneDistance, _sampleRate, complexLength, firstBin, lastBin);
+    DEBUG_STREAM("GCC band: [" << firstBin << ", " << lastBin << ") of " << complexLength << " bins");
 
-BaseType FreqGCCBinauralLocalisation::setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate)
-{
-    int neededSamples = _durationToEstimatePowerFloor*sampleRate;
-    double power = dsp::SignalPower::power(analysisFrames, analysisLength)*(analysisLength-2);
-    _powerFloor += power + 1e-10;
-    _samplesConsumedForNoise += (analysisLength-2); // length is one-sided FFT length here.
-    if (_samplesConsumedForNoise >= neededSamples)
+    if (config.tauEvaluation == TauMatrix::RECURRENCE)
     {
-	_noiseEstimated = true;
-	if (_samplesConsumedForNoise > 0)
-	    _powerFloor /= _samplesConsumedForNoise;
-	DEBUG_STREAM("POWER floor: " << _powerFloor << " " << _samplesConsumedForNoise);
-	_powerFloor = 10*log10(_powerFloor) + _noiseMarginDB;
-	DEBUG_STREAM("POWER floor: " << _powerFloor);
+	_recurrenceGCC.reset(new TauMatrix(_samplesDelay.get(), _numSteps, firstBin, lastBin, complexLength,
+					   TauMatrix::RECURRENCE));
+	DEBUG_STREAM("GCC table size: " << _recurrenceGCC->getTableSize() << " bytes, phase recurrence");
+    }
+    else
+    {
+	_gcc.reset(new BinauralGCC(_samplesDelay.get(), _numSteps, firstBin, lastBin, complexLength));
+	DEBUG_STREAM("GCC table size: " << _gcc->getTableSize() << " bytes, symmetric: " << _gcc->isSymmetric());
     }
-
-    return _powerFloor;
 }
 
+
+
 void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
 							 std::vector<double*> &dataChannels, int dataLength)
 {
@@ -410,9 +409,22 @@ void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &a
     if (!_ptrCallback)
     {
 	ERROR_STREAM("I am not computing binaural localisation because no callback has been set.");
+	_preGate.clear();
 	return;
     }
 
+    // Frames coming from frameAnalysis are still in time domain (consumed spectra are not).
+    // The FFT is skipped if the frame is clearly below the noise floor, then only the
+    // silence state is updated.
+    bool timeFrames = _preGate.hasFrame();
+    bool gated = timeFrames && _usePowerFloor && _preGate.isSilent(*_noiseFloor);
+    if (timeFrames && !gated)
+    {
+	for (int c = 0; c < 2; ++c)
+	    STFTAnalysis::frameAnalysis(const_cast<BaseType*>(_preGate.getFrame(c)), analysisFrames[c],
+					_preGate.getFrameLength(), analysisLength, c);
+    }
+
     // Calculate the phase of the FFT of the window using the GCC function
     // to obtain the DOA estimation
     BaseTypeC *left = reinterpret_cast<BaseTypeC*>(analysisFrames[0]);
@@ -423,29 +435,55 @@ void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &a
     BaseType max = 0;
 
     size_t idx = 0;
-    int complexAnalysisLength = analysisLength/2;
 
-    // Getting signal power, and setting as floor if the firsts signal frames are processed.
-    if (!_noiseEstimated)
-	power = setPowerFloor(analysisFrames, analysisLength, 2, _sampleRate);
+    // Getting signal power and tracking the noise floor with it.
+    if (gated)
+    {
+	power = _preGate.getEstimatedPower();
+    }
     else
+    {
 	power = dsp::SignalPower::FFTLogPower(analysisFrames, analysisLength);
+	if (timeFrames)
+	    _preGate.calibrate(power);
+    }
+    _preGate.clear();
+    bool signal = updatePowerFloor(power) && !gated;
 
-    if(power > _powerFloor || !_usePowerFloor)
+    if(signal || !_usePowerFloor)
     {
 
 	DEBUG_STREAM( power << " > " << _powerFloor);
-	_gcc.calculateCorrelationsForPrecomputedTauMatrix(reinterpret_cast<dsp::Complex*>(left),
-							  reinterpret_cast<dsp::Complex*>(right),
-							  reinterpret_cast<dsp::Complex*>(_correlations.get()),
-							  complexAnalysisLength,
-							  _numSteps, _gcc.ONESIDEDFFT);
-
-	wipp::real(reinterpret_cast<wipp::wipp_complex_t*>(_correlations.get()), _correlationsReal.get(), _numSteps);
-	wipp::multC(1-_corrMemoryFactor, _correlationsReal.get(), _numSteps);
-	wipp::multC(_corrMemoryFactor, _prevCorrelationsReal.get(), _numSteps);
-	wipp::add(_prevCorrelationsReal.get(), _correlationsReal.get(), _numSteps);
-	wipp::copyBuffer(_correlationsReal.get(), _prevCorrelationsReal.get(), _numSteps);
+	int firstStep = 0, lastStep = _numSteps;
+	bool restricted = false;
+	if (_precomputedCorrelations)
+	{
+	    wipp::copyBuffer(_precomputedCorrelations, _correlationsReal.get(), _numSteps);
+	}
+	else
+	{
+	    restricted = getSearchWindow(firstStep, lastStep);
+	    if (_recurrenceGCC)
+		_recurrenceGCC->calculateCorrelations(left, right, _correlationsReal.get(), firstStep, lastStep);
+	    else
+		_gcc->calculateCorrelations(left, right, _correlationsReal.get(), firstStep, lastStep);
+	}
+
+	// Only the points that have been evaluated are smoothed, the others keep their memory.
+	int windowLength = lastStep - firstStep;
+	wipp::multC(1-_corrMemoryFactor, &_correlationsReal[firstStep], windowLength);
+	wipp::multC(_corrMemoryFactor, &_prevCorrelationsReal[firstStep], windowLength);
+	wipp::add(&_prevCorrelationsReal[firstStep], &_correlationsReal[firstStep], windowLength);
+	wipp::copyBuffer(&_correlationsReal[firstStep], &_prevCorrelationsReal[firstStep], windowLength);
+
+	// Points outside the window are given the lowest correlation found inside it,
+	// so that the observation model gives them the lowest likelihood.
+	if (restricted)
+	{
+	    BaseType floor = *std::min_element(&_correlationsReal[firstStep], &_correlationsReal[lastStep]);
+	    std::fill(&_correlationsReal[0], &_correlationsReal[firstStep], floor);
+	    std::fill(&_correlationsReal[lastStep], &_correlationsReal[_numSteps], floor);
+	}
 
 	//          ippsAdd_64f_I(_triangle.get(), _correlationsReal.get(), _numSteps);
 
@@ -518,15 +556,18 @@ void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &a
 #endif
 #endif
 
+	updateTrack(firstStep, lastStep);
 	_ptrCallback->setDOA(toDegrees(_currentDOA,1), _prob, power,1);
 
-	_corrMemoryFactor = _maxCorrMemoryFactor;
-	_doaMemoryFactor = _maxDoaMemoryFactor;
+	_corrMemoryFactor = _frameCorrMemoryFactor;
+	_doaMemoryFactor = _frameDoaMemoryFactor;
 	_silenceFramesCounter = 0;
 
     }
     else
     {
+	// The source may have moved while it was silent.
+	_trackedStep = -1;
 	if (_noiseEstimated)
 	{
 	    // Memory factors goes to zero exponentially as silence time increases.
@@ -538,8 +579,8 @@ void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &a
 		// Still needs work
 		//                _corrMemoryFactor = _maxCorrMemoryFactor * exp(-(static_cast<double>(_silenceFramesCounter++))/(2*windowsToDecay));
 		//                _doaMemoryFactor = _maxDoaMemoryFactor * exp(-(static_cast<double>(_silenceFramesCounter++))/(2*windowsToDecay));
-		_corrMemoryFactor = _maxCorrMemoryFactor;
-		_doaMemoryFactor = _maxDoaMemoryFactor;
+		_corrMemoryFactor = _frameCorrMemoryFactor;
+		_doaMemoryFactor = _frameDoaMemoryFactor;
 		//                DEBUG_STREAM("corr mem factor: " << _corrMemoryFactor << " doa mem factor: " << _doaMemoryFactor << " " << _silenceFramesCounter << " " << windowsToDecay);
 		if (_particleFilter)
 		{
@@ -566,6 +607,91 @@ void FreqGCCBinauralLocalisation::processParametrisation(std::vector<double*> &a
 		 );
 }
 
+bool FreqGCCBinauralLocalisation::getSearchWindow(int &firstStep, int &lastStep)
+{
+    firstStep = 0;
+    lastStep = _numSteps;
+    if (!isSourceLocked() || _framesSinceFullSearch >= _fullSearchPeriod)
+    {
+	_framesSinceFullSearch = 0;
+	return false;
+    }
+
+    ++_framesSinceFullSearch;
+    firstStep = std::max(0, _trackedStep - _trackingWindow);
+    lastStep = std::min(_numSteps, _trackedStep + _trackingWindow + 1);
+    return true;
+}
+
+void FreqGCCBinauralLocalisation::updateTrack(int firstStep, int lastStep)
+{
+    if (_trackingWindow == 0)
+	return;
+
+    // A maximum on an inner edge of the window means that the source may be outside it.
+    BaseType max = 0;
+    size_t idx = 0;
+    wipp::maxidx(&_correlationsReal[firstStep], lastStep - firstStep, &max, &idx);
+    int peak = firstStep + static_cast<int>(idx);
+    if ((peak == firstStep && firstStep > 0) || (peak == lastStep - 1 && lastStep < _numSteps))
+    {
+	_trackedStep = -1;
+	return;
+    }
+
+    int step = angle2DOAidx(_currentDOA[0] + _doaStep/2, _doaStep);
+    _trackedStep = std::min(_numSteps - 1, std::max(0, step));
+}
+
+void FreqGCCBinauralLocalisation::frameAnalysis(BaseType *inFrame, BaseType *, int frameLength, int, int channel)
+{
+    _preGate.storeFrame(inFrame, frameLength, channel);
+}
+
+void FreqGCCBinauralLocalisation::consumeSpectrum(const SpectralFrame &frame)
+{
+    frame.checkCompatibility(2, getAnalysisLength());
+
+    // processParametrisation only reads the analysis frames.
+    _consumedFrames[0] = const_cast<BaseType*>(frame.getChannel(0));
+    _consumedFrames[1] = const_cast<BaseType*>(frame.getChannel(1));
+    processParametrisation(_consumedFrames, frame.getAnalysisLength(), _noDataChannels, 0);
+}
+
+void FreqGCCBinauralLocalisation::consumeSpectra(const SpectralBlock &block)
+{
+    block.checkCompatibility(2, getAnalysisLength());
+    int nframes = block.getNumberOfFrames();
+    // With a tracking window the frames are evaluated one by one, since each window depends on the previous frame.
+    if (_recurrenceGCC || _trackingWindow > 0 || !_ptrCallback || nframes < 2)
+    {
+	SpectrumConsumer::consumeSpectra(block);
+	return;
+    }
+
+    if (nframes > _blockCapacity)
+    {
+	_blockCorrelations.reset(new BaseType[nframes*_numSteps]);
+	_blockCapacity = nframes;
+    }
+
+    // Correlations of frames below the noise floor are computed too, but they are not used.
+    std::vector<const BaseTypeC*> left(nframes), right(nframes);
+    for (int f = 0; f < nframes; ++f)
+    {
+	left[f] = reinterpret_cast<const BaseTypeC*>(block.getChannel(f, 0));
+	right[f] = reinterpret_cast<const BaseTypeC*>(block.getChannel(f, 1));
+    }
+    _gcc->calculateCorrelations(left.data(), right.data(), nframes, _blockCorrelations.get());
+
+    for (int f = 0; f < nframes; ++f)
+    {
+	_precomputedCorrelations = &_blockCorrelations[f*_numSteps];
+	consumeSpectrum(block.getFrame(f));
+    }
+    _precomputedCorrelations = NULL;
+}
+
 void FreqGCCBinauralLocalisation::setProbability(const double *doas, double *probs, int size)
 {
     double sum;
@@ -31,6 +31,7 @@
 #include <wipp/wippstats.h>
 #include <wipp/wippsignal.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include <math.h>
@@ -38,9 +39,11 @@
 namespace mca {
 
 // nBins + 1 is to store the residual of the FB.
-BinauralMaskingImpl::BinauralMaskingImpl(int samplerate, double microDistance, float lowFreq, float highFreq, MaskingMethod mmethod) :
+// With the gammatone filter bank the analysis buffer only holds the frame.
+BinauralMaskingImpl::BinauralMaskingImpl(int samplerate, double microDistance, float lowFreq, float highFreq, MaskingMethod mmethod,
+					 FilterBankType filterBank) :
   ShortTimeProcess(calculateWindowSizeFromSampleRate(samplerate, _frameRate),
-		   calculateWindowSizeFromSampleRate(samplerate, _frameRate)*(_nBins),
+		   calculateWindowSizeFromSampleRate(samplerate, _frameRate)*((filterBank == MEL_FFT) ? _nBins : 1),
 		   2),
   _fftOrder(calculateOrderFromSampleRate(samplerate, _frameRate)),
   _sampleRate(samplerate),
@@ -49,7 +52,8 @@ BinauralMaskingImpl::BinauralMaskingImpl(int samplerate, double microDistance, f
   _minFreq(lowFreq),
   _maxFreq(highFreq),
   _nchannels(getNumberOfChannels()),
-  _windowSize(getFrameSize())
+  _windowSize(getFrameSize()),
+  _filterBankType(filterBank)
 {
   init();
   TRACE_STREAM("Binaural Localisation parameters: " << std::endl
@@ -62,6 +66,7 @@ BinauralMaskingImpl::BinauralMaskingImpl(int samplerate, double microDistance, f
 	       << ", scaling factor: " << _scalingFactor
 	       << ", enhance factor: " << _enhanceFactor
 	       << ", Bandwidth: (" << _minFreq << ", " << _maxFreq << ")"
+	       << ", filter bank: " << _filterBankType
 	       );
 }
 
@@ -77,9 +82,33 @@ void BinauralMaskingImpl::init()
   {
     throw(MCArrayException("Sound localisation is only working for 2 channels by now."));
   }
-  _filterBankRight.reset(new dsp::FilterBankFFTWMelScale(_fftOrder, _nBins, _sampleRate, _minFreq, _maxFreq));
-  _filterBankLeft.reset(new dsp::FilterBankFFTWMelScale(_fftOrder, _nBins, _sampleRate, _minFreq, _maxFreq));
+  if (_filterBankType == GAMMATONE_IIR)
+  {
+    _gammatone.reset(new GammatoneFilterBank(_sampleRate, _nBins, _minFreq, _maxFreq));
+    _gammatoneOutput.reset(new BaseType[_nchannels*_windowSize]);
+    wipp::setZeros(_gammatoneOutput.get(), _nchannels*_windowSize);
+
+    // The analysis window is recovered from its inverse, so that the filtered signal can be
+    // windowed again as the frames the synthesis expects.
+    _analysisWindow.reset(new BaseType[_windowSize]);
+    BaseType inverse[_windowSize];
+    std::fill(_analysisWindow.get(), _analysisWindow.get() + _windowSize, 1);
+    unwindowFrame(_analysisWindow.get(), inverse, _windowSize);
+    for (int n = 0; n < _windowSize; ++n)
+      _analysisWindow[n] = (inverse[n] > 0 && std::isfinite(inverse[n])) ? 1/inverse[n] : 0;
+  }
+  else
+  {
+    _filterBankRight.reset(new dsp::FilterBankFFTWMelScale(_fftOrder, _nBins, _sampleRate, _minFreq, _maxFreq));
+    _filterBankLeft.reset(new dsp::FilterBankFFTWMelScale(_fftOrder, _nBins, _sampleRate, _minFreq, _maxFreq));
+  }
   _shortTimePower.reset(new BaseType[_nBins]);
+  _bandPower.reset(new BaseType[_nBins]);
+  _bandCorrelation.reset(new BaseType[_nBins]);
+  _gainStatistics.reset(new BaseType[_nchannels*_nBins]);
+  _bandGains.reset(new BaseType[_nchannels*_nBins]);
+  _spatialMask.reset(new unsigned char[_nBins]);
+  _temporalMask.reset(new unsigned char[_nBins]);
   wipp::setZeros(_shortTimePower.get(), _nBins);
   calculateThresholds();
 }
@@ -87,6 +116,12 @@ void BinauralMaskingImpl::init()
 
 void BinauralMaskingImpl::frameAnalysis(BaseType *inFrame, BaseType *analysis, int frameLength, int analysisLength, int channel)
 {
+  if (_filterBankType == GAMMATONE_IIR)
+  {
+    unwindowFrame(inFrame, analysis, frameLength);
+    return;
+  }
+
   dsp::FilterBank *filter;
   if (channel == 0)
     filter = _filterBankLeft.get();
@@ -101,6 +136,28 @@ void BinauralMaskingImpl::processParametrisation(std::vector<double*> &analysisF
 {
   BaseType *left =  analysisFrames[0];
   BaseType *right = analysisFrames[1];
+
+  if (_filterBankType == GAMMATONE_IIR)
+  {
+    processGammatoneFrames(left, right);
+    return;
+  }
+
+  // The statistics of every band are measured first, then the decisions and gains are taken
+  // for all the bands at once (calculateMask), and finally applied.
+  for (int bin = 0; bin < _nBins; ++bin) // Residual should not be processed (i<_nBins) instead of (i<=_nBins)
+  {
+    BaseType *binleft  = &left[bin*_windowSize];
+    BaseType *binright = &right[bin*_windowSize];
+
+    _bandPower[bin] = getFramePower(binleft, binright, _windowSize);
+    _bandCorrelation[bin] = normaliseCorrelation(binleft, binright, _windowSize);
+    _gainStatistics[bin] = getMeanPower(binleft, _windowSize);
+    _gainStatistics[_nBins + bin] = getMeanPower(binright, _windowSize);
+  }
+
+  calculateMask();
+
   int nspatialMaskedBins = 0;
   int ntempMaskedBins = 0;
   int nenhancedBins= 0;
@@ -108,34 +165,23 @@ void BinauralMaskingImpl::processParametrisation(std::vector<double*> &analysisF
   //  oss << std::setprecision(4);
 
   oss << "[";
-  for (int bin = 0; bin < _nBins; ++bin) // Residual should not be processed (i<_nBins) instead of (i<=_nBins)
+  for (int bin = 0; bin < _nBins; ++bin)
   {
-    BaseType *binleft  = &left[bin*_windowSize];
-    BaseType *binright = &right[bin*_windowSize];
-
-    // temporal masking needs to be executed always, because it has memeory
-    bool tempMask = temportalMasking(binleft, binright, _windowSize, bin);
-    bool spatMask = spatialMasking(binleft, binright, _windowSize, bin);
+    wipp::multC(_bandGains[bin], &left[bin*_windowSize], _windowSize);
+    wipp::multC(_bandGains[_nBins + bin], &right[bin*_windowSize], _windowSize);
 
-    if (spatMask)
+    if (_spatialMask[bin])
     {
-      maskFrame(binleft, _windowSize, _spatialMaskingFactor, bin);
-      maskFrame(binright, _windowSize, _spatialMaskingFactor, bin);
-      oss << _filterBankLeft.get()->getBinCenterFrequency(bin)*_sampleRate << " ";
+      oss << getBandCenterFrequency(bin) << " ";
       ++nspatialMaskedBins;
-
     }
-    else if (tempMask)
+    else if (_temporalMask[bin])
     {
-      maskFrame(binleft, _windowSize, _temporalMaskingFactor, bin);
-      maskFrame(binright, _windowSize, _temporalMaskingFactor, bin);
-      oss << _filterBankLeft.get()->getBinCenterFrequency(bin)*_sampleRate <<  " ";
+      oss << getBandCenterFrequency(bin) <<  " ";
       ++ntempMaskedBins;
     }
     else
     {
-      enhanceFrame(binleft, _windowSize);
-      enhanceFrame(binright, _windowSize);
       ++nenhancedBins;
     }
   }
@@ -147,8 +193,47 @@ void BinauralMaskingImpl::processParametrisation(std::vector<double*> &analysisF
   //          TRACE_STREAM(oss.str());
 }
 
-void BinauralMaskingImpl::frameSynthesis(BaseType *outFrame, BaseType *analysis, int frameLength, int analysisLength, int)
+void BinauralMaskingImpl::processGammatoneFrames(BaseType *left, BaseType *right)
 {
+  BaseType leftEnergy[_nBins], rightEnergy[_nBins], crossEnergy[_nBins];
+
+  // Consecutive frames overlap, only one hop of each one is new. The hop is taken from the middle
+  // of the frame, where the window is largest, and the bank goes on from where the last one left it.
+  const int hop = getWindowShift();
+  const int offset = (_windowSize - hop)/2;
+  _gammatone->analyse(&left[offset], &right[offset], hop, leftEnergy, rightEnergy, crossEnergy);
+
+  // The statistics of getFramePower, normaliseCorrelation and getMeanPower, from the sums over the band signals.
+  for (int bin = 0; bin < _nBins; ++bin)
+  {
+    BaseType denom = sqrt(leftEnergy[bin]*rightEnergy[bin]);
+    _bandPower[bin] = (leftEnergy[bin] + 2*crossEnergy[bin] + rightEnergy[bin])/(4*hop);
+    _bandCorrelation[bin] = (denom == 0) ? 1 : crossEnergy[bin]/denom;
+    _gainStatistics[bin] = leftEnergy[bin]/hop;
+    _gainStatistics[_nBins + bin] = rightEnergy[bin]/hop;
+  }
+
+  calculateMask();
+
+  // The masked hop is appended to the last frame of output of its channel.
+  BaseType *frames[] = {left, right};
+  for (int c = 0; c < _nchannels; ++c)
+  {
+    BaseType *output = &_gammatoneOutput[c*_windowSize];
+    std::copy(&output[hop], &output[_windowSize], output);
+    _gammatone->synthesise(&frames[c][offset], &_bandGains[c*_nBins], hop, &output[_windowSize - hop], c);
+  }
+}
+
+void BinauralMaskingImpl::frameSynthesis(BaseType *outFrame, BaseType *analysis, int frameLength, int analysisLength, int channel)
+{
+  if (_filterBankType == GAMMATONE_IIR)
+  {
+    wipp::copyBuffer(&_gammatoneOutput[channel*_windowSize], outFrame, frameLength);
+    wipp::mult(_analysisWindow.get(), outFrame, frameLength);
+    return;
+  }
+
   wipp::setZeros(outFrame, frameLength);
   for (int bin = 0, offset = 0;
        (bin <= _nBins) && (offset < analysisLength - frameLength);
@@ -159,56 +244,63 @@ void BinauralMaskingImpl::frameSynthesis(BaseType *outFrame, BaseType *analysis,
 }
 
 
-void BinauralMaskingImpl::zeroFrame(BaseType *frame, int length)
-{
-  wipp::divC(1000, frame, length); // 1/1000 --> -60dB
-}
-
-void BinauralMaskingImpl::maskFrameByScaling(BaseType *frame, int length, int bin) // RELATIVE
+void BinauralMaskingImpl::calculateMask()
 {
+  // Every loop runs over independent bins, so they are vectorised.
+  const BaseType *power = _bandPower.get();
+  BaseType *shortTimePower = _shortTimePower.get();
 
   //
-  //                ro * (1/N) *  sum_n(frame[n]²)
-  // factor = sqrt( ------------------------------ )
-  //                           Q[m-1]
+  // first order IIR low pass filter:
+  // Q[m] = labda*Q[m-1] + (1-lambda)*P[m]
   //
-  // ro = scalingFactor
-  // Q[m-1] - low-pass filtered power in the previous frame
+  // lambda = forgetingFactor
+  // Q[m-1] - previous short-time power
+  // P[m] - current frame power
   //
+  for (int bin = 0; bin < _nBins; ++bin)
+    shortTimePower[bin] = shortTimePower[bin]*_forgetingFactor + (1 - _forgetingFactor)*power[bin];
 
-  BaseType aux[length];
-  BaseType factor;
-  wipp::sqr(frame, aux, length);  // frame[n]^2
-  wipp::mean(aux, length, &factor);   // (1/N)*sum_n
-  factor *= _scalingFactor;   // =* ro
-  factor /= _shortTimePower[bin];   //  =* (1/Q[m-1])
-  factor = sqrt(factor);   // sqrt
-  wipp::multC(factor, frame, length);
-}
-
-void BinauralMaskingImpl::maskFrameByFactor(BaseType *frame, int length, float factor)
-{
-  wipp::divC(factor, frame, length);
-}
-
-void BinauralMaskingImpl::maskFrame(BaseType *frame, int length,float factor, int bin)
-{
-  switch(_mmethod)
+  // returns true if the signal has to be masked (removed)
+  for (int bin = 0; bin < _nBins; ++bin)
   {
-    case FULL:
-      zeroFrame(frame, length);
-    break;
-    case RELATIVE:
-      maskFrameByScaling(frame, length, bin);
-    break;
-    case FACTOR:
-      maskFrameByFactor(frame, length, factor);
+    _spatialMask[bin] = (_bandCorrelation[bin] < _thresholds[bin]);
+    _temporalMask[bin] = (power[bin] < shortTimePower[bin]);
   }
-}
 
-void BinauralMaskingImpl::enhanceFrame(BaseType *frame, int length)
-{
-  wipp::multC(_enhanceFactor, frame, length);
+  const BaseType spatialGain = 1/_spatialMaskingFactor;
+  const BaseType temporalGain = 1/_temporalMaskingFactor;
+  for (int c = 0; c < _nchannels; ++c)
+  {
+    const BaseType *statistic = &_gainStatistics[c*_nBins];
+    BaseType *gains = &_bandGains[c*_nBins];
+    switch(_mmethod)
+    {
+      case FULL:
+	for (int bin = 0; bin < _nBins; ++bin)
+	  gains[bin] = 1.0/1000; // 1/1000 --> -60dB
+      break;
+      case RELATIVE:
+	//
+	//                ro * (1/N) *  sum_n(frame[n]²)
+	// factor = sqrt( ------------------------------ )
+	//                           Q[m-1]
+	//
+	// ro = scalingFactor
+	// Q[m-1] - low-pass filtered power in the previous frame
+	//
+	for (int bin = 0; bin < _nBins; ++bin)
+	  gains[bin] = sqrt(statistic[bin]*_scalingFactor/shortTimePower[bin]);
+      break;
+      case FACTOR:
+	for (int bin = 0; bin < _nBins; ++bin)
+	  gains[bin] = _spatialMask[bin] ? spatialGain : temporalGain;
+      break;
+    }
+
+    for (int bin = 0; bin < _nBins; ++bin)
+      gains[bin] = (_spatialMask[bin] || _temporalMask[bin]) ? gains[bin] : _enhanceFactor;
+  }
 }
 
 double BinauralMaskingImpl::localise(BaseType *left, BaseType *right, int length)
@@ -253,22 +345,13 @@ void BinauralMaskingImpl::calculateThresholds()
   _thresholds.resize(_nBins, 0);
   for (int bin = 0; bin<_nBins; ++bin)
   {
-    double wfreq =  _filterBankLeft.get()->getBinCenterFrequency(bin)*_sampleRate*2*M_PI;
+    double wfreq =  getBandCenterFrequency(bin)*2*M_PI;
     _thresholds[bin] = cos(wfreq*_microDistance*sin(_phi)/getSpeedOfSound()) * 0.9;
     TRACE_STREAM("BIN: " << bin << " F: " << wfreq/(2*M_PI) << " TH: " << _thresholds[bin]);
   }
 
 }
 
-// returns true if the signal has to be masked (removed)
-inline bool BinauralMaskingImpl::spatialMasking(BaseType *left, BaseType *right, int length, int bin)
-{
-  double ncorr = normaliseCorrelation(left, right, length);
-  //          TRACE_STREAM("bin: " << bin << " f: " << _filterBankLeft.get()->getBinCenterFrequency(bin)*_sampleRate << " -->  corr: " << ncorr << " vs. " <<  _thresholds.at(bin));
-  bool masking =  ( ncorr < _thresholds.at(bin));
-  return masking;
-}
-
 double BinauralMaskingImpl::normaliseCorrelation(BaseType *left, BaseType *right, int length)
 {
 
@@ -300,21 +383,11 @@ double BinauralMaskingImpl::normaliseCorrelation(BaseType *left, BaseType *right
 
 
 
-inline bool BinauralMaskingImpl::temportalMasking(BaseType *left, BaseType *right, int length, int bin)
+double BinauralMaskingImpl::getBandCenterFrequency(int bin) const
 {
-
-  //
-  // first order IIR low pass filter:
-  // Q[m] = labda*Q[m-1] + (1-lambda)*P[m]
-  //
-  // lambda = forgetingFactor
-  // Q[m-1] - previous short-time power
-  // P[m] - current frame power
-  //
-
-  BaseType power = getFramePower(left, right, length);
-  _shortTimePower[bin] = _shortTimePower[bin]*_forgetingFactor + (1 - _forgetingFactor)*power;
-  return (power < _shortTimePower[bin]);
+  if (_filterBankType == GAMMATONE_IIR)
+    return _gammatone->getCenterFrequency(bin);
+  return _filterBankLeft.get()->getBinCenterFrequency(bin)*_sampleRate;
 }
 
 inline double BinauralMaskingImpl::getFramePower(BaseType *left, BaseType *right, int length)
@@ -334,5 +407,19 @@ inline double BinauralMaskingImpl::getFramePower(BaseType *left, BaseType *right
   return power;
 }
 
+inline double BinauralMaskingImpl::getMeanPower(BaseType *frame, int length)
+{
+
+  //
+  //  (1/N) * sum_n( (frame[n])² )
+  //
+
+  BaseType vaux[length];
+  BaseType power;
+  wipp::sqr(frame, vaux, length);
+  wipp::mean(vaux, length, &power);
+  return power;
+}
+
 
 }
@@ -0,0 +1,179 @@
+/*
+* DecimatingFrontEnd.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/DecimatingFrontEnd.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/mcalogger.h>
+
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+DecimatingFrontEnd::DecimatingFrontEnd(int sampleRate, const ArrayDescription &microphones) :
+  DecimatingFrontEnd(sampleRate, microphones.size(), chooseFactor(sampleRate, microphones.getBandwidth()))
+{
+
+}
+
+DecimatingFrontEnd::DecimatingFrontEnd(int sampleRate, unsigned int nchannels, int factor) :
+  _sampleRate(sampleRate),
+  _nchannels(nchannels),
+  _factor(factor),
+  _ntaps(_tapsPerPhase*factor + 1),
+  _historyCapacity(0),
+  _phase(0),
+  _decimatedCapacity(0)
+{
+  if (_factor < 1 || _nchannels < 1)
+  {
+    std::ostringstream oss;
+    oss << "Decimation needs at least one channel and a factor of at least 1: "
+	<< _nchannels << " channels, factor " << _factor << ".";
+    throw(MCArrayException(oss.str()));
+  }
+
+  designFilter();
+  _history.resize(_nchannels);
+  _decimated.resize(_nchannels);
+  _decimatedPtrs.resize(_nchannels);
+
+  DEBUG_STREAM("Decimation from " << _sampleRate << " to " << getOutputSampleRate() << " Hz, "
+	       << _ntaps << " taps");
+}
+
+int DecimatingFrontEnd::chooseFactor(int sampleRate, double bandwidth)
+{
+  if (bandwidth <= 0)
+    return 1;
+
+  // The output Nyquist frequency has to be above bandwidth/_passbandFraction.
+  int factor = std::max(1, static_cast<int>(floor(_passbandFraction*sampleRate/(2*bandwidth))));
+  while (factor > 1 && sampleRate % factor != 0)
+    --factor;
+  return factor;
+}
+
+void DecimatingFrontEnd::designFilter()
+{
+  //
+  // h[n] = w[n] * sin(pi*(n-D)/M)/(pi*(n-D)),   D = (ntaps-1)/2
+  //
+  // with w the Blackman window, normalised to unit gain at DC.
+  //
+  _taps.reset(new BaseType[_ntaps]);
+  const int center = (_ntaps - 1)/2;
+  double sum = 0;
+  for (int n = 0; n < _ntaps; ++n)
+  {
+    double window = 0.42 - 0.5*cos(2*M_PI*n/(_ntaps - 1)) + 0.08*cos(4*M_PI*n/(_ntaps - 1));
+    double x = n - center;
+    double sinc = (n == center) ? 1.0/_factor : sin(M_PI*x/_factor)/(M_PI*x);
+    _taps[n] = window*sinc;
+    sum += _taps[n];
+  }
+
+  // Reversed, so that each output is a dot product with the history in memory order.
+  std::reverse(_taps.get(), _taps.get() + _ntaps);
+  for (int n = 0; n < _ntaps; ++n)
+    _taps[n] /= sum;
+}
+
+void DecimatingFrontEnd::addAnalyser(dsp::ShortTimeAnalysis *analyser)
+{
+  if (analyser->getNumberOfChannels() != _nchannels)
+  {
+    std::ostringstream oss;
+    oss << "Analyser with " << analyser->getNumberOfChannels() << " channels added to a decimating front end of "
+	<< _nchannels << " channels.";
+    throw(MCArrayException(oss.str()));
+  }
+  _analysers.push_back(analyser);
+}
+
+int DecimatingFrontEnd::process(const std::vector<double*> &input, int length)
+{
+  int maxLength = getMaxOutputLength(length);
+  if (maxLength > _decimatedCapacity)
+  {
+    for (unsigned int c = 0; c < _nchannels; ++c)
+    {
+      _decimated[c].reset(new BaseType[maxLength]);
+      _decimatedPtrs[c] = _decimated[c].get();
+    }
+    _decimatedCapacity = maxLength;
+  }
+
+  int decimatedLength = decimate(input, length, _decimatedPtrs);
+  if (decimatedLength > 0)
+  {
+    for (unsigned int a = 0; a < _analysers.size(); ++a)
+      _analysers[a]->process(_decimatedPtrs, decimatedLength);
+  }
+  return decimatedLength;
+}
+
+int DecimatingFrontEnd::decimate(const std::vector<double*> &input, int length, std::vector<double*> &output)
+{
+  const int historyLength = _ntaps - 1;
+  if (historyLength + length > _historyCapacity)
+  {
+    // The history is kept when the buffers grow, the first call starts from silence.
+    for (unsigned int c = 0; c < _nchannels; ++c)
+    {
+      SignalPtr history(new BaseType[historyLength + length]);
+      if (_history[c])
+	std::copy(_history[c].get(), _history[c].get() + historyLength, history.get());
+      else
+	std::fill(history.get(), history.get() + historyLength, 0);
+      _history[c] = history;
+    }
+    _historyCapacity = historyLength + length;
+  }
+
+  int produced = 0;
+  for (unsigned int c = 0; c < _nchannels; ++c)
+  {
+    BaseType *history = _history[c].get();
+    std::copy(input[c], input[c] + length, &history[historyLength]);
+
+    // Output n of the block is y[phase + n*M] = sum_k h[k]*x[phase + n*M - k].
+    const BaseType *taps = _taps.get();
+    produced = 0;
+    for (int i = _phase; i < length; i += _factor, ++produced)
+    {
+      const BaseType *x = &history[i];
+      BaseType y = 0;
+      for (int k = 0; k < _ntaps; ++k)
+	y += taps[k]*x[k];
+      output[c][produced] = y;
+    }
+
+    std::copy(&history[length], &history[length + historyLength], history);
+  }
+
+  // The first output of the next block is M samples after the last one of this block.
+  _phase = _phase + produced*_factor - length;
+  return produced;
+}
+
+}
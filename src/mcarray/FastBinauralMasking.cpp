@@ -30,6 +30,7 @@
 #include <wipp/wippsignal.h>
 #include <wipp/wippstats.h>
 
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <math.h>
@@ -48,30 +49,72 @@ namespace mca {
 
 
 // nBins + 1 is to store the residual of the FB.
+int FastBinauralMasking::Config::getFFTOrder(int sampleRate) const
+{
+    if (fftOrder > 0)
+	return fftOrder;
+    return calculateOrderFromSampleRate(sampleRate, frameRate);
+}
+
+FastBinauralMasking::FastBinauralMasking(int samplerate,
+					 double microDistance,
+					 float lowFreq,
+					 float highFreq,
+					 MaskingMethod mmethod,
+					 MaskingAlg algorithm,
+					 float frameRate) :
+    FastBinauralMasking(samplerate, microDistance, lowFreq, highFreq, Config(frameRate), mmethod, algorithm)
+{
+
+}
+
 FastBinauralMasking::FastBinauralMasking(int samplerate,
 					 double microDistance,
 					 float lowFreq,
 					 float highFreq,
+					 const Config &config,
+					 MaskingMethod mmethod,
+					 MaskingAlg algorithm) :
+    FastBinauralMasking(samplerate, ArrayDescription::make_linear_array_description(std::vector<double>{0, microDistance}),
+			lowFreq, highFreq, config, mmethod, algorithm)
+{
+
+}
+
+FastBinauralMasking::FastBinauralMasking(int samplerate,
+					 const ArrayDescription &microphones,
+					 float lowFreq,
+					 float highFreq,
+					 const Config &config,
 					 MaskingMethod mmethod,
 					 MaskingAlg algorithm) :
-    dsp::STFT(2 ,calculateOrderFromSampleRate(samplerate, _frameRate)),
+    dsp::STFT(microphones.size(), config.getFFTOrder(samplerate)),
     _sampleRate(samplerate),
-    _microDistance(microDistance),
+    _microphones(microphones),
+    _pairs(config.pairs.empty() ? getNearestNeighbourPairs(microphones) : config.pairs),
     _mmethod(mmethod),
     _algorithm(algorithm),
     _minFreq(lowFreq),
     _maxFreq(highFreq),
     _nchannels(getNumberOfChannels()),
-    _fftOrder(calculateOrderFromSampleRate(samplerate, _frameRate)),
+    _fftOrder(config.getFFTOrder(samplerate)),
     _oneSidedFFTLength(getOneSidedFFTLength()),
     _windowSize(getWindowSize()),
-    _firstCall(0)
+    _nBins(config.nBins),
+    // Same time constant as with the hop of the default order, which keeps its factor as it is.
+    _frameForgetingFactor(pow(_forgetingFactor, ldexp(1.0, _fftOrder - calculateOrderFromSampleRate(samplerate, _frameRate)))),
+    _maskOnly(config.maskOnly),
+    _firstCall(0),
+    _frameIndex(0)
 {
     init();
+    if (config.maskStreamCapacity > 0)
+	_maskStream.reset(new MaskStream(_nBins, _nchannels, config.maskStreamCapacity));
     TRACE_STREAM("FAST Binaural Localisation parameters: " << std::endl
 		 << "order: "  << _fftOrder
 		 << ", rate: " << _sampleRate
-		 << ", micro distance: " << _microDistance
+		 << ", channels: " << _nchannels
+		 << ", pairs: " << _pairs.size()
 		 << ", method: " << _mmethod << std::endl
 		 << "temporal factor: " << _temporalMaskingFactor
 		 << ", spatial factor: " << _spatialMaskingFactor
@@ -85,17 +128,41 @@ FastBinauralMasking::FastBinauralMasking(int samplerate,
 void FastBinauralMasking::init()
 {
 
-    if (_nchannels != 2)
+    if (_nchannels < 2)
+    {
+	std::ostringstream oss;
+	oss << "Masking needs at least two microphones, " << _nchannels << " given.";
+	throw(MCArrayException(oss.str()));
+    }
+
+    _pairDistances.clear();
+    for (size_t p = 0; p < _pairs.size(); ++p)
+    {
+	const MicrophonePair &pair = _pairs[p];
+	if (pair.first < 0 || pair.second < 0 || pair.first >= _nchannels || pair.second >= _nchannels
+		|| pair.first == pair.second)
+	{
+	    std::ostringstream oss;
+	    oss << "Invalid pair of microphones (" << pair.first << ", " << pair.second << ") for "
+		<< _nchannels << " channels.";
+	    throw(MCArrayException(oss.str()));
+	}
+	_pairDistances.push_back(_microphones.distance(pair.first, pair.second));
+    }
+
+    if (_nBins < 1)
     {
-	throw(MCArrayException("Binaural masking is only working for 2 channels."));
+	std::ostringstream oss;
+	oss << "Binaural masking needs at least one band, " << _nBins << " given.";
+	throw(MCArrayException(oss.str()));
     }
 
     _coeficientsLength = _nBins * ( (1 << (_fftOrder-1)) + 1 );
     int analisys_length = getAnalysisLength() + 2;
     _filterBank.reset(new dsp::FilterBankFFTWMelScale(_fftOrder, _nBins, _sampleRate, _minFreq, _maxFreq));
     _filterCoeficients.reset(new BaseTypeC[_coeficientsLength]);
-    BaseType coefs[_coeficientsLength];
-    int gotNCoefs = _filterBank->getFiltersCoeficients(coefs, _coeficientsLength);
+    _filterResponses.reset(new BaseType[_coeficientsLength]);
+    int gotNCoefs = _filterBank->getFiltersCoeficients(_filterResponses.get(), _coeficientsLength);
     if (gotNCoefs != _coeficientsLength)
     {
 	std::ostringstream oss;
@@ -105,17 +172,27 @@ void FastBinauralMasking::init()
     DEBUG_STREAM("number of coefs: " << _coeficientsLength << " order: " << _fftOrder);
     DEBUG_STREAM("BW: " << _minFreq << " - " << _maxFreq);
     //    ippsRealToCplx_64f(coefs, NULL, _filterCoeficients.get(), _coeficientsLength);
-    wipp::real2complex(coefs, NULL, reinterpret_cast<wipp::wipp_complex_t*>(_filterCoeficients.get()), _coeficientsLength);
+    wipp::real2complex(_filterResponses.get(), NULL, reinterpret_cast<wipp::wipp_complex_t*>(_filterCoeficients.get()), _coeficientsLength);
 
     _shortTimePower.reset(new BaseType[_nBins]);
     _noiseEstimatePower.reset(new BaseType[_nBins]);
-    _fftLeftFrame.reset(new BaseType[analisys_length]);
-    _fftRightFrame.reset(new BaseType[analisys_length]);
-    _outLeftFrame.reset(new BaseType[analisys_length]);
-    _outRightFrame.reset(new BaseType[analisys_length]);
+    _bandFrames.reset(new BaseType[_nchannels*analisys_length]);
+    _mixedFrame.reset(new BaseType[analisys_length]);
+    _channelEnergies.reset(new BaseType[_nchannels]);
+    _spectralGains.reset(new BaseType[_nchannels*_oneSidedFFTLength]);
+    _bandPower.reset(new BaseType[_nBins]);
+    _bandCorrelation.reset(new BaseType[_nBins]);
+    _gainStatistics.reset(new BaseType[_nchannels*_nBins]);
+    _bandGains.reset(new BaseType[_nchannels*_nBins]);
+    _spatialMask.reset(new unsigned char[_nBins]);
+    _temporalMask.reset(new unsigned char[_nBins]);
 
     wipp::setZeros(_shortTimePower.get()    , _nBins);
     wipp::setZeros(_noiseEstimatePower.get(), _nBins);
+    wipp::setZeros(_bandCorrelation.get(), _nBins);
+    std::fill(_bandGains.get(), _bandGains.get() + _nchannels*_nBins, 1);
+    std::fill(_spatialMask.get(), _spatialMask.get() + _nBins, 0);
+    std::fill(_temporalMask.get(), _temporalMask.get() + _nBins, 0);
 
     //          _gcc.reset(new GeneralisedCrossCorrelation(_analysisLength ,GeneralisedCrossCorrelation::ONESIDEDFFT));
 
@@ -123,6 +200,32 @@ void FastBinauralMasking::init()
 }
 
 
+void FastBinauralMasking::processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames)
+{
+    input.checkCompatibility(_nchannels, getAnalysisLength());
+
+    // Masking works in place, so the input is copied to the output first.
+    for (int c = 0; c < _nchannels; ++c)
+    {
+	wipp::copyBuffer(input.getChannel(c), outputFrames[c], input.getAnalysisLength());
+    }
+
+    // Masks are published with the number of the frame in the front end.
+    _frameIndex = input.getIndex();
+    std::vector<double*> noDataChannels;
+    processParametrisation(outputFrames, input.getAnalysisLength(), noDataChannels, 0);
+}
+
+void FastBinauralMasking::frameSynthesis(BaseType *outFrame, BaseType *analysis, int frameLength, int analysisLength, int channel)
+{
+    if (_maskOnly)
+    {
+	wipp::setZeros(outFrame, frameLength);
+	return;
+    }
+    dsp::STFT::frameSynthesis(outFrame, analysis, frameLength, analysisLength, channel);
+}
+
 void FastBinauralMasking::processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
 						 std::vector<double*> &dataChannels, int dataLength)
 {
@@ -139,66 +242,109 @@ void FastBinauralMasking::processParametrisation(std::vector<double*> &analysisF
     std::ostringstream oss;
     oss << std::setprecision(4);
 
-    wipp::setZeros(_outLeftFrame.get(), analysisLength);
-    wipp::setZeros(_outRightFrame.get(), analysisLength);
-
-    oss << "[";
+    // The statistics of every band are measured first, then the decisions and gains are taken
+    // for all the bands at once (calculateMask), and finally applied.
+    // Each channel is decomposed in bands once, and the energy of a band is shared by all the pairs.
+    const bool spatial = (_algorithm == BOTH || _algorithm == SPATIAL);
+    const int frameLength = getAnalysisLength() + 2;
     for (int bin = 0; bin < _nBins; ++bin) // Residual should not be processed (i<_nBins) instead of (i<=_nBins)
     {
-      wipp::mult(reinterpret_cast<wipp::wipp_complex_t*>(analysisFrames[0]),
-	  reinterpret_cast<wipp::wipp_complex_t*>(&_filterCoeficients.get()[bin*_oneSidedFFTLength]),
-	  reinterpret_cast<wipp::wipp_complex_t*>(_fftLeftFrame.get()),  _oneSidedFFTLength);
-      wipp::mult(reinterpret_cast<wipp::wipp_complex_t*>(analysisFrames[1]),
-	  reinterpret_cast<wipp::wipp_complex_t*>(&_filterCoeficients.get()[bin*_oneSidedFFTLength]),
-	  reinterpret_cast<wipp::wipp_complex_t*>(_fftRightFrame.get()), _oneSidedFFTLength);
-
-	// temporal masking needs to be executed always, because it has memory
-	bool tempMask, spatMask=false;
-
-	tempMask = temportalMasking(_fftLeftFrame.get(),  _fftRightFrame.get(), _windowSize, bin);
-	if (_algorithm == BOTH || _algorithm == SPATIAL)
+	for (int c = 0; c < _nchannels; ++c)
+	{
+	    BaseType *bandFrame = &_bandFrames[c*frameLength];
+	    wipp::mult(reinterpret_cast<wipp::wipp_complex_t*>(analysisFrames[c]),
+		       reinterpret_cast<wipp::wipp_complex_t*>(&_filterCoeficients.get()[bin*_oneSidedFFTLength]),
+		       reinterpret_cast<wipp::wipp_complex_t*>(bandFrame), _oneSidedFFTLength);
+	    _channelEnergies[c] = getEnergy(bandFrame);
+	    _gainStatistics[c*_nBins + bin] = (_mmethod == NOISY) ? getPower(bandFrame, _windowSize) : _channelEnergies[c];
+	}
+
+	//
+	//  (1/N) * sum_n( ((1/C)*sum_c(frame_c[n]))² )
+	//
+	wipp::copyBuffer(_bandFrames.get(), _mixedFrame.get(), _windowSize);
+	for (int c = 1; c < _nchannels; ++c)
+	    wipp::add(&_bandFrames[c*frameLength], _mixedFrame.get(), _windowSize);
+	wipp::divC(_nchannels, _mixedFrame.get(), _windowSize);
+	_bandPower[bin] = getPower(_mixedFrame.get(), _windowSize);
+
+	if (spatial)
 	{
-	    spatMask = spatialMasking(_fftLeftFrame.get(),  _fftRightFrame.get(), _windowSize, bin);
-	    if (_algorithm == SPATIAL)
+	    BaseType correlation = 0;
+	    for (size_t p = 0; p < _pairs.size(); ++p)
 	    {
-		tempMask = false;
+		int i = _pairs[p].first, j = _pairs[p].second;
+		correlation += normaliseFFTCorrelation(&_bandFrames[i*frameLength], &_bandFrames[j*frameLength],
+						       _channelEnergies[i], _channelEnergies[j]);
 	    }
+	    _bandCorrelation[bin] = correlation/_pairs.size();
 	}
+    }
+
+    calculateMask();
+
+    if (_maskStream)
+	_maskStream->push(_frameIndex, static_cast<double>(_frameIndex)*getWindowShift()/_sampleRate,
+			  _spatialMask.get(), _temporalMask.get(), _bandGains.get());
+    ++_frameIndex;
 
-	if (spatMask)
+    ++_firstCall;
+    if (_firstCall < 2)
+    {
+	wipp::copyBuffer(_shortTimePower.get(), _noiseEstimatePower.get(), _nBins);
+    }
+
+    // Without resynthesis the spectrum is left as it is.
+    if (_maskOnly)
+	return;
+
+    // The masked bands used to be added up, and since each band is X*H_b the output is
+    // X*sum_b(g_b*H_b). The gains are accumulated into a single real gain per FFT bin and channel instead.
+    // Masking scales the first _windowSize/2 bins of a band, the Nyquist bin keeps its unit gain.
+    int maskedLength = _windowSize/2;
+    wipp::setZeros(_spectralGains.get(), _nchannels*_oneSidedFFTLength);
+
+    oss << "[";
+    for (int bin = 0; bin < _nBins; ++bin)
+    {
+	if (_spatialMask[bin])
 	{
-	    maskFrame(_fftLeftFrame.get(),  _windowSize, _spatialMaskingFactor, bin);
-	    maskFrame(_fftRightFrame.get(), _windowSize, _spatialMaskingFactor, bin);
 	    oss << _filterBank.get()->getBinCenterFrequency(bin)*_sampleRate << " ";
 	    ++nspatialMaskedBins;
-
 	}
-	else if (tempMask)
+	else if (_temporalMask[bin])
 	{
-	    maskFrame(_fftLeftFrame.get(),  _windowSize, _temporalMaskingFactor, bin);
-	    maskFrame(_fftRightFrame.get(), _windowSize, _temporalMaskingFactor, bin);
 	    oss << _filterBank.get()->getBinCenterFrequency(bin)*_sampleRate <<  " ";
 	    ++ntempMaskedBins;
 	}
 	else
 	{
-	    enhanceFrame(_fftLeftFrame.get(),  _windowSize);
-	    enhanceFrame(_fftRightFrame.get(), _windowSize);
 	    ++nenhancedBins;
 	}
-	wipp::add(_fftLeftFrame.get(), _outLeftFrame.get(), analysisLength);
-	wipp::add(_fftRightFrame.get(), _outRightFrame.get(), analysisLength);
+
+	const BaseType *response = &_filterResponses[bin*_oneSidedFFTLength];
+	for (int c = 0; c < _nchannels; ++c)
+	{
+	    BaseType *spectralGain = &_spectralGains[c*_oneSidedFFTLength];
+	    BaseType gain = _bandGains[c*_nBins + bin];
+	    for (int k = 0; k < maskedLength; ++k)
+		spectralGain[k] += gain*response[k];
+	    for (int k = maskedLength; k < _oneSidedFFTLength; ++k)
+		spectralGain[k] += response[k];
+	}
     }
 
-    ++_firstCall;
-    if (_firstCall < 2)
+    for (int c = 0; c < _nchannels; ++c)
     {
-	wipp::copyBuffer(_shortTimePower.get(), _noiseEstimatePower.get(), _nBins);
+	BaseTypeC *spectrum = reinterpret_cast<BaseTypeC*>(analysisFrames[c]);
+	const BaseType *spectralGain = &_spectralGains[c*_oneSidedFFTLength];
+	for (int k = 0; k < analysisLength/2; ++k)
+	{
+	    spectrum[k].re *= spectralGain[k];
+	    spectrum[k].im *= spectralGain[k];
+	}
     }
 
-    wipp::copyBuffer(_outLeftFrame.get(),  analysisFrames[0], analysisLength);
-    wipp::copyBuffer(_outRightFrame.get(), analysisFrames[1], analysisLength);
-
 
 
     TRACE_STREAM("SM: " << nspatialMaskedBins << " bins, "
@@ -211,110 +357,114 @@ void FastBinauralMasking::processParametrisation(std::vector<double*> &analysisF
 
 
 
-void FastBinauralMasking::zeroFrame(BaseType *frame, int length)
+void FastBinauralMasking::calculateMask()
 {
-    wipp::divC(1000, frame, length); // 1/1000 --> -60dB
-}
+    // Every loop runs over independent bins, so they are vectorised.
+    const BaseType *power = _bandPower.get();
+    BaseType *shortTimePower = _shortTimePower.get();
 
+    //
+    // first order IIR low pass filter:
+    // Q[m] = labda*Q[m-1] + (1-lambda)*P[m]
+    //
+    // lambda = forgetingFactor
+    // Q[m-1] - previous short-time power
+    // P[m] - current frame power
+    //
+    for (int bin = 0; bin < _nBins; ++bin)
+	shortTimePower[bin] = shortTimePower[bin]*_frameForgetingFactor + (1 - _frameForgetingFactor)*power[bin];
+
+    // A bin is masked if its power falls below the memory (temporal masking) or if the
+    // normalised correlation falls below the threshold (spatial masking).
+    const bool spatial = (_algorithm == BOTH || _algorithm == SPATIAL);
+    const bool temporal = (_algorithm != SPATIAL);
+    for (int bin = 0; bin < _nBins; ++bin)
+    {
+	_spatialMask[bin] = spatial && (_bandCorrelation[bin] < _thresholds[bin]);
+	_temporalMask[bin] = temporal && (power[bin] < _rejectTemporalFactor*shortTimePower[bin]);
+    }
 
-void FastBinauralMasking::noisyFrame(BaseType *frame, int length, int bin)
-{
-    BaseType powerBin = getPower(frame,length);
-    BaseType noisePower = _noiseEstimatePower[bin];
-    BaseType factor = 1;
-    if (powerBin > 0)
-	factor = noisePower/powerBin;
-    //            BaseType mean=100;
-    SignalPtr constant;
-    constant.reset(new BaseType[_oneSidedFFTLength]);
-
-    if (_firstCall < 2)
-	return;
-
-    //            ippsMean_64f(_noiseEstimatePower.get(),_nBins, &mean);
-    //            ippsSet_64f(mean, constant.get(), _oneSidedFFTLength);
-    //            ippsRealToCplx_64f(constant.get(), NULL, reinterpret_cast<BaseTypeC*>(frame), _oneSidedFFTLength);
-    //            ippsMul_64fc_I(&_filterCoeficients.get()[bin*_oneSidedFFTLength],
-    //                         reinterpret_cast<BaseTypeC*>(frame), _oneSidedFFTLength);
-
-    //            ippsSet_64f(mean, frame, length*_maxFreq/_sampleRate);
-
-
-    wipp::multC(factor, frame, length);
-
-    //            ippsDiv_64f(&powerBin, &meanPower, &SNR, 1);
-
-    //            factor=5.623/SNR;             //5.623 --> 15 dB
-
-    //            wipp::multC(factor, frame, length);
-
-    //            if(factor>0)
-    //                wipp::divC(factor, frame, length);
-    //            else
-    //                wipp::multC(-factor, frame, length);
+    const BaseType spatialGain = 1/_spatialMaskingFactor;
+    const BaseType temporalGain = 1/_temporalMaskingFactor;
+    for (int c = 0; c < _nchannels; ++c)
+    {
+	const BaseType *statistic = &_gainStatistics[c*_nBins];
+	BaseType *gains = &_bandGains[c*_nBins];
+	switch(_mmethod)
+	{
+	    case FULL:
+		for (int bin = 0; bin < _nBins; ++bin)
+		    gains[bin] = 1.0/1000; // 1/1000 --> -60dB
+	    break;
+	    case RELATIVE:
+		//
+		//                ro * (1/N) *  sum_n(frame[n]²)
+		// factor = sqrt( ------------------------------ )
+		//                           Q[m-1]
+		//
+		// ro = scalingFactor
+		// Q[m-1] - low-pass filtered power in the previous frame
+		//
+		for (int bin = 0; bin < _nBins; ++bin)
+		    gains[bin] = (shortTimePower[bin] < 1e-10) ?
+			sqrt(_scalingFactor) : sqrt(statistic[bin]*_scalingFactor/std::max(shortTimePower[bin], 1e-10));
+	    break;
+	    case FACTOR:
+		for (int bin = 0; bin < _nBins; ++bin)
+		    gains[bin] = _spatialMask[bin] ? spatialGain : temporalGain;
+	    break;
+	    case NOISY:
+		for (int bin = 0; bin < _nBins; ++bin)
+		    gains[bin] = (_firstCall < 2 || statistic[bin] <= 0) ? 1 : _noiseEstimatePower[bin]/statistic[bin];
+	    break;
+	    case NOTHING:
+		for (int bin = 0; bin < _nBins; ++bin)
+		    gains[bin] = 1;
+	    break;
+	}
 
+	for (int bin = 0; bin < _nBins; ++bin)
+	    gains[bin] = (_spatialMask[bin] || _temporalMask[bin]) ? gains[bin] : _enhanceFactor;
+    }
 }
 
-
-
-void FastBinauralMasking::maskFrameByScaling(BaseType *frame, int length, int bin) // RELATIVE
+BaseType FastBinauralMasking::getEnergy(BaseType *frame)
 {
-
-    //
-    //                ro * (1/N) *  sum_n(frame[n]²)
-    // factor = sqrt( ------------------------------ )
-    //                           Q[m-1]
-    //
-    // ro = scalingFactor
-    // Q[m-1] - low-pass filtered power in the previous frame
-    //
-
     BaseType aux[_oneSidedFFTLength];
-    BaseType factor;
+    BaseType energy = 0;
 
     //I use magnitude because power is calculated in the Freq domain.
     wipp::magnitude(reinterpret_cast<wipp::wipp_complex_t*>(frame), aux, _oneSidedFFTLength); //  |·|
     wipp::sqr(aux, _oneSidedFFTLength); // frame[n]^2
-    wipp::mean(aux, _oneSidedFFTLength, &factor);   // (1/N)*sum_n
-
-    factor *= _scalingFactor;   // =* ro
-    if (_shortTimePower[bin] < 1e-10)
-	factor = _scalingFactor;
-    else
-	factor /= _shortTimePower[bin];   //  =/ Q[m-1]
-    factor = sqrt(factor);   // sqrt
-    wipp::multC(factor, frame, length);
+    wipp::mean(aux, _oneSidedFFTLength, &energy);   // (1/N)*sum_n
+    return energy;
 }
 
-void FastBinauralMasking::maskFrameByFactor(BaseType *frame, int length, float factor)
+std::vector<FastBinauralMasking::MicrophonePair> FastBinauralMasking::getNearestNeighbourPairs(const ArrayDescription &microphones)
 {
-    wipp::divC(factor, frame, length);
-}
-
-void FastBinauralMasking::maskFrame(BaseType *frame, int length,float factor, int bin)
-{
-    switch(_mmethod)
+    // Microphones of a uniform array have several nearest neighbours, which are all taken
+    // so that, i.e., a linear array is a chain of pairs.
+    std::vector<MicrophonePair> pairs;
+    int nmicrophones = microphones.size();
+    for (int i = 0; i < nmicrophones; ++i)
     {
-	case FULL:
-	    zeroFrame(frame, length);
-	break;
-	case RELATIVE:
-	    maskFrameByScaling(frame, length, bin);
-	break;
-	case FACTOR:
-	    maskFrameByFactor(frame, length, factor);
-	break;
-	case NOISY:
-	    noisyFrame(frame, length, bin);
-	break;
-	case NOTHING:
-	break;
-    }
-}
+	double nearest = -1;
+	for (int j = 0; j < nmicrophones; ++j)
+	{
+	    if (j != i && (nearest < 0 || microphones.distance(i, j) < nearest))
+		nearest = microphones.distance(i, j);
+	}
 
-void FastBinauralMasking::enhanceFrame(BaseType *frame, int length)
-{
-    wipp::multC(_enhanceFactor, frame, length);
+	for (int j = 0; j < nmicrophones; ++j)
+	{
+	    if (j == i || microphones.distance(i, j) > _neighbourTolerance*nearest)
+		continue;
+	    MicrophonePair pair(std::min(i, j), std::max(i, j));
+	    if (std::find(pairs.begin(), pairs.end(), pair) == pairs.end())
+		pairs.push_back(pair);
+	}
+    }
+    return pairs;
 }
 
 double FastBinauralMasking::localise(BaseType *left, BaseType *right, int length)
@@ -355,26 +505,19 @@ void FastBinauralMasking::calculateThresholds()
     // d/c - where d = distance between micros and c = speed of sound
     //
 
-    _thresholds.resize(_nBins, 0);
+    // Spatial masking compares the mean correlation of the pairs with the mean of their thresholds.
+    _thresholds.assign(_nBins, 0);
     for (int bin = 0; bin<_nBins; ++bin)
     {
 	double wfreq =  _filterBank.get()->getBinCenterFrequency(bin)*_sampleRate*2*M_PI;
-	_thresholds[bin] = cos(wfreq*_microDistance*sin(_phi)/getSpeedOfSound());
+	for (size_t p = 0; p < _pairDistances.size(); ++p)
+	    _thresholds[bin] += cos(wfreq*_pairDistances[p]*sin(_phi)/getSpeedOfSound());
+	_thresholds[bin] /= _pairDistances.size();
 	TRACE_STREAM("BIN: " << bin << " F: " << wfreq/(2*M_PI) << " TH: " << _thresholds[bin]);
     }
 
 }
 
-// returns true if the signal has to be masked (removed)
-inline bool FastBinauralMasking::spatialMasking(BaseType *left, BaseType *right, int length, int bin)
-{
-    //          double ncorr = normaliseFFTCorrelation(left, right, length);
-    double ncorr = generalisedCrossCorrelation(left, right, length);
-    TRACE_STREAM("bin: " << bin << " f: " << _filterBank.get()->getBinCenterFrequency(bin)*_sampleRate << " -->  corr: " << ncorr << " vs. " <<  _thresholds.at(bin));
-    bool masking =  ( ncorr < _thresholds.at(bin));
-    return masking;
-}
-
 double FastBinauralMasking::normaliseCorrelation(BaseType *left, BaseType *right, int length)
 {
 
@@ -428,10 +571,14 @@ double FastBinauralMasking::normaliseFFTCorrelation(BaseType *left, BaseType *ri
 	throw(MCArrayException(oss.str()));
     }
 
+    return normaliseFFTCorrelation(left, right, getEnergy(left), getEnergy(right));
+}
+
+double FastBinauralMasking::normaliseFFTCorrelation(BaseType *left, BaseType *right, BaseType leftEnergy, BaseType rightEnergy)
+{
     BaseTypeC vauxC[_oneSidedFFTLength];
-    BaseType vaux[_oneSidedFFTLength];
     wipp::wipp_complex_t meanC;
-    BaseType numer, denom, mean;
+    BaseType numer, denom;
 
     // Cross-Correlation
     wipp::conj(reinterpret_cast<wipp::wipp_complex_t*>(left), reinterpret_cast<wipp::wipp_complex_t*>(vauxC), _oneSidedFFTLength);
@@ -443,16 +590,7 @@ double FastBinauralMasking::normaliseFFTCorrelation(BaseType *left, BaseType *ri
 	return 0;
 
     // Energy from Parseval's theorem
-    wipp::magnitude(reinterpret_cast<wipp::wipp_complex_t*>(left), vaux, _oneSidedFFTLength);
-    wipp::sqr(vaux, _oneSidedFFTLength);
-    wipp::mean(vaux, _oneSidedFFTLength, &denom);
-
-    wipp::magnitude(reinterpret_cast<wipp::wipp_complex_t*>(right), vaux, _oneSidedFFTLength);
-    wipp::sqr(vaux, _oneSidedFFTLength);
-    wipp::mean(vaux, _oneSidedFFTLength, &mean);
-
-    denom = denom * mean;
-    denom = sqrt(denom);
+    denom = sqrt(leftEnergy*rightEnergy);
     if (denom == 0)
 	return 1;
     else
@@ -474,50 +612,6 @@ double FastBinauralMasking::generalisedCrossCorrelation(BaseType *left, BaseType
 }
 
 
-inline bool FastBinauralMasking::temportalMasking(BaseType *left, BaseType *right, int length, int bin)
-{
-
-    //
-    // first order IIR low pass filter:
-    // Q[m] = labda*Q[m-1] + (1-lambda)*P[m]
-    //
-    // lambda = forgetingFactor
-    // Q[m-1] - previous short-time power
-    // P[m] - current frame power
-    //
-
-    BaseType power = getFramePower(left, right, length);
-    _shortTimePower[bin] = _shortTimePower[bin]*_forgetingFactor + (1 - _forgetingFactor)*power;
-    TRACE_STREAM("Q[m]=" << _shortTimePower[bin] << ", " << power);
-    return (power < _rejectTemporalFactor*_shortTimePower[bin]);
-}
-
-
-inline double FastBinauralMasking::getFramePower(BaseType *left, BaseType *right, int length)
-{
-
-    //
-    //  (1/N) * sum_n( ((left[n]+right[n])/2)² )
-    //
-
-    //          if (length != 2*(_oneSidedFFTLength-1))
-    //            throw(SpeechException("Mismatch in vector lengths"));
-
-    BaseType halfRight[length];
-    BaseType halfLeft[length];
-    BaseType mixed[length];
-
-    wipp::copyBuffer(left, halfRight, length);
-    wipp::copyBuffer(right, halfLeft, length);
-    wipp::divC(2, halfLeft, length);
-    wipp::divC(2, halfRight, length);
-    wipp::add(halfRight, halfLeft, mixed, length);
-
-    return getPower(mixed, length);
-}
-
-
-
 inline double FastBinauralMasking::getPower(BaseType *frame, int length)
 {
     //
@@ -0,0 +1,204 @@
+/*
+* GammatoneFilterBank.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/GammatoneFilterBank.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
+
+#include <wipp/wipputils.h>
+
+#include <algorithm>
+#include <complex>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+namespace {
+
+// ERB-rate scale and bandwidth of Glasberg and Moore (1990).
+double erbRate(double frequency)
+{
+  return 21.4*log10(1 + 0.00437*frequency);
+}
+
+double erbRateToFrequency(double rate)
+{
+  return (pow(10, rate/21.4) - 1)/0.00437;
+}
+
+double erb(double frequency)
+{
+  return 24.7 + 0.108*frequency;
+}
+
+}
+
+GammatoneFilterBank::GammatoneFilterBank(int sampleRate, int nbands, float lowFreq, float highFreq) :
+  _sampleRate(sampleRate),
+  _nbands(nbands),
+  _delays(std::max(0, nbands), 0),
+  _delayLength(lrint(_synthesisDelay*sampleRate) + 1)
+{
+  if (_nbands < 1)
+  {
+    std::ostringstream oss;
+    oss << "Gammatone filter bank needs at least one band, " << _nbands << " given.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  if (lowFreq <= 0 || highFreq < lowFreq || 2*highFreq >= _sampleRate)
+  {
+    std::ostringstream oss;
+    oss << "Invalid band for a gammatone filter bank: (" << lowFreq << ", " << highFreq << ") at " << _sampleRate << " Hz.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  _centerFrequencies.reset(new BaseType[_nbands]);
+  _poleRe.reset(new BaseType[_nbands]);
+  _poleIm.reset(new BaseType[_nbands]);
+  _inputGainRe.reset(new BaseType[_nbands]);
+  _inputGainIm.reset(new BaseType[_nbands]);
+  _gain.reset(new BaseType[_nbands]);
+  _stateRe.reset(new BaseType[_order*2*_nbands]);
+  _stateIm.reset(new BaseType[_order*2*_nbands]);
+  _synthesisStateRe.reset(new BaseType[_nchannels*_order*_nbands]);
+  _synthesisStateIm.reset(new BaseType[_nchannels*_order*_nbands]);
+  _bands.reset(new BaseType[2*_nbands]);
+  _delayLine.reset(new BaseType[_nchannels*_delayLength*_nbands]);
+
+  double firstRate = erbRate(lowFreq);
+  double rateStep = (_nbands > 1) ? (erbRate(highFreq) - firstRate)/(_nbands - 1) : 0;
+  for (int b = 0; b < _nbands; ++b)
+  {
+    double frequency = erbRateToFrequency(firstRate + b*rateStep);
+    double radius = exp(-2*M_PI*1.019*erb(frequency)/_sampleRate);
+    double w = 2*M_PI*frequency/_sampleRate;
+    _centerFrequencies[b] = frequency;
+    _poleRe[b] = radius*cos(w);
+    _poleIm[b] = radius*sin(w);
+    _gain[b] = 1 - radius;
+
+    // h[n] = gain^4 * C(n+3,3) * p^n, its envelope (n+1)(n+2)(n+3)*radius^n peaks at the first decrease.
+    int delay = getDelay();
+    int peak = 0;
+    while (peak < delay && (peak + 4)*radius > (peak + 1))
+      ++peak;
+    _delays[b] = delay - peak;
+    _inputGainRe[b] = _gain[b]*cos(w*peak);
+    _inputGainIm[b] = -_gain[b]*sin(w*peak);
+  }
+
+  calculateSynthesisGain();
+  reset();
+}
+
+void GammatoneFilterBank::analyse(const BaseType *left, const BaseType *right, int length,
+				  BaseType *leftEnergy, BaseType *rightEnergy, BaseType *crossEnergy)
+{
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
+  const BaseType *l = _bands.get();
+  const BaseType *r = &_bands[_nbands];
+
+  wipp::setZeros(leftEnergy, _nbands);
+  wipp::setZeros(rightEnergy, _nbands);
+  wipp::setZeros(crossEnergy, _nbands);
+  for (int n = 0; n < length; ++n)
+  {
+    const BaseType input[2] = {left[n], right[n]};
+    kernels.resonatorCascade(input, 2, _nbands, _order, _poleRe.get(), _poleIm.get(), _inputGainRe.get(), _inputGainIm.get(),
+			     _gain.get(), _stateRe.get(), _stateIm.get(), _bands.get());
+    for (int b = 0; b < _nbands; ++b)
+    {
+      leftEnergy[b] += l[b]*l[b];
+      rightEnergy[b] += r[b]*r[b];
+      crossEnergy[b] += l[b]*r[b];
+    }
+  }
+}
+
+void GammatoneFilterBank::synthesise(const BaseType *input, const BaseType *gains, int length, BaseType *output, int channel)
+{
+  if (channel < 0 || channel >= _nchannels)
+  {
+    std::ostringstream oss;
+    oss << "Gammatone filter bank synthesises " << _nchannels << " channels, channel " << channel << " given.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
+  BaseType *stateRe = &_synthesisStateRe[channel*_order*_nbands];
+  BaseType *stateIm = &_synthesisStateIm[channel*_order*_nbands];
+  BaseType *delayLine = &_delayLine[channel*_delayLength*_nbands];
+  int &slot = _delayPosition[channel];
+
+  for (int n = 0; n < length; ++n)
+  {
+    // The input sample is consumed before the output one is written, so they can share the buffer.
+    kernels.resonatorCascade(&input[n], 1, _nbands, _order, _poleRe.get(), _poleIm.get(), _inputGainRe.get(), _inputGainIm.get(),
+			     _gain.get(), stateRe, stateIm, &delayLine[slot*_nbands]);
+    BaseType sum = 0;
+    for (int b = 0; b < _nbands; ++b)
+      sum += gains[b]*delayLine[((slot + _delayLength - _delays[b]) % _delayLength)*_nbands + b];
+    output[n] = _synthesisGain*sum;
+    slot = (slot + 1) % _delayLength;
+  }
+}
+
+size_t GammatoneFilterBank::getStateSize() const
+{
+  return sizeof(BaseType)*(2*_order*2*_nbands + 2*_nchannels*_order*_nbands + 2*_nbands + _nchannels*_delayLength*_nbands);
+}
+
+void GammatoneFilterBank::reset()
+{
+  wipp::setZeros(_stateRe.get(), _order*2*_nbands);
+  wipp::setZeros(_stateIm.get(), _order*2*_nbands);
+  wipp::setZeros(_synthesisStateRe.get(), _nchannels*_order*_nbands);
+  wipp::setZeros(_synthesisStateIm.get(), _nchannels*_order*_nbands);
+  wipp::setZeros(_delayLine.get(), _nchannels*_delayLength*_nbands);
+  std::fill(_delayPosition, _delayPosition + _nchannels, 0);
+}
+
+void GammatoneFilterBank::calculateSynthesisGain()
+{
+  // A real input e^{jwn} + e^{-jwn} leaves a band as H_b(w)e^{jwn} + H_b(-w)e^{-jwn}, so its real
+  // response is H_b(w) + conj(H_b(-w)), with H_b(w) = c_b*(gain/(1 - p_b*e^{-jw}))^order, where c_b
+  // is the rotation of the first resonator, and then delayed by e^{-jw*delay_b}.
+  double meanResponse = 0;
+  for (int k = 0; k < _nbands; ++k)
+  {
+    double w = 2*M_PI*_centerFrequencies[k]/_sampleRate;
+    std::complex<double> response(0, 0);
+    for (int b = 0; b < _nbands; ++b)
+    {
+      std::complex<double> pole(_poleRe[b], _poleIm[b]);
+      std::complex<double> rotation(_inputGainRe[b]/_gain[b], _inputGainIm[b]/_gain[b]);
+      std::complex<double> positive = rotation*pow(_gain[b]/(1.0 - pole*std::polar(1.0, -w)), _order);
+      std::complex<double> negative = rotation*pow(_gain[b]/(1.0 - pole*std::polar(1.0, w)), _order);
+      response += std::polar(1.0, -w*_delays[b])*(positive + std::conj(negative));
+    }
+    meanResponse += std::abs(response);
+  }
+  _synthesisGain = _nbands/meanResponse;
+}
+
+}
@@ -0,0 +1,312 @@
+/*
+* KernelDispatch.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/KernelDispatch.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/mcalogger.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MCA_KERNEL_DISPATCH 1
+#define MCA_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define MCA_KERNEL_INLINE inline
+#endif
+
+namespace mca {
+
+namespace {
+
+const int L = KernelDispatch::_lanes;
+
+// Kernel bodies, inlined in each variant so that they are vectorised for its target.
+// The lane loops are independent, so they vectorise without reassociating the sums.
+
+MCA_KERNEL_INLINE BaseType energyBody(const BaseType *x, int length)
+{
+  BaseType acc[L] = {0};
+  int n = length - length % L;
+  for (int i = 0; i < n; i += L)
+    for (int l = 0; l < L; ++l)
+      acc[l] += x[i + l]*x[i + l];
+
+  BaseType energy = 0;
+  for (int i = n; i < length; ++i)
+    energy += x[i]*x[i];
+  for (int l = 0; l < L; ++l)
+    energy += acc[l];
+  return energy;
+}
+
+MCA_KERNEL_INLINE BaseType filteredEnergyBody(const BaseTypeC *left, const BaseTypeC *right, const BaseType *filter, int length)
+{
+  BaseType acc[L] = {0};
+  int n = length - length % L;
+  for (int i = 0; i < n; i += L)
+  {
+    for (int l = 0; l < L; ++l)
+    {
+      const BaseTypeC &a = left[i + l];
+      const BaseTypeC &b = right[i + l];
+      acc[l] += filter[i + l]*filter[i + l]*(a.re*a.re + a.im*a.im + b.re*b.re + b.im*b.im);
+    }
+  }
+
+  BaseType energy = 0;
+  for (int i = n; i < length; ++i)
+    energy += filter[i]*filter[i]*(left[i].re*left[i].re + left[i].im*left[i].im + right[i].re*right[i].re + right[i].im*right[i].im);
+  for (int l = 0; l < L; ++l)
+    energy += acc[l];
+  return energy;
+}
+
+MCA_KERNEL_INLINE void splitMultiplyAccumulateBody(const BaseType *aRe, const BaseType *aIm, const BaseType *bRe, const BaseType *bIm,
+						   int length, BaseType *yRe, BaseType *yIm)
+{
+  // Element-wise, every iteration is independent.
+  for (int i = 0; i < length; ++i)
+  {
+    yRe[i] += aRe[i]*bRe[i] - aIm[i]*bIm[i];
+    yIm[i] += aRe[i]*bIm[i] + aIm[i]*bRe[i];
+  }
+}
+
+MCA_KERNEL_INLINE void splitScaleAccumulateBody(BaseType aRe, BaseType aIm, const BaseType *bRe, const BaseType *bIm,
+						int length, BaseType *yRe, BaseType *yIm)
+{
+  for (int i = 0; i < length; ++i)
+  {
+    yRe[i] += aRe*bRe[i] - aIm*bIm[i];
+    yIm[i] += aRe*bIm[i] + aIm*bRe[i];
+  }
+}
+
+// T is the sample type, lanes the number of partial sums (float vectors hold twice the elements).
+template<typename T, int lanes>
+MCA_KERNEL_INLINE void splitCorrelationBody(const T *re, const T *im, const T *cosine, const T *sine,
+					    int length, T *cosSum, T *sinSum)
+{
+  T cosAcc[lanes] = {0}, sinAcc[lanes] = {0};
+  int n = length - length % lanes;
+  for (int i = 0; i < n; i += lanes)
+  {
+    for (int l = 0; l < lanes; ++l)
+    {
+      cosAcc[l] += re[i + l]*cosine[i + l];
+      sinAcc[l] += im[i + l]*sine[i + l];
+    }
+  }
+
+  T c = 0, s = 0;
+  for (int i = n; i < length; ++i)
+  {
+    c += re[i]*cosine[i];
+    s += im[i]*sine[i];
+  }
+  for (int l = 0; l < lanes; ++l)
+  {
+    c += cosAcc[l];
+    s += sinAcc[l];
+  }
+  *cosSum = c;
+  *sinSum = s;
+}
+
+MCA_KERNEL_INLINE void resonatorCascadeBody(const BaseType *input, int nchannels, int nbands, int stages, const BaseType *poleRe,
+					    const BaseType *poleIm, const BaseType *inputGainRe, const BaseType *inputGainIm,
+					    const BaseType *gain, BaseType *stateRe, BaseType *stateIm, BaseType *output)
+{
+  // The bands are the independent lanes, the stages of a band run one after the other.
+  const int lanes = nchannels*nbands;
+  for (int c = 0; c < nchannels; ++c)
+  {
+    const BaseType x = input[c];
+    BaseType *re = &stateRe[c*nbands];
+    BaseType *im = &stateIm[c*nbands];
+    for (int b = 0; b < nbands; ++b)
+    {
+      BaseType yRe = poleRe[b]*re[b] - poleIm[b]*im[b] + inputGainRe[b]*x;
+      im[b] = poleRe[b]*im[b] + poleIm[b]*re[b] + inputGainIm[b]*x;
+      re[b] = yRe;
+    }
+  }
+
+  for (int s = 1; s < stages; ++s)
+  {
+    for (int c = 0; c < nchannels; ++c)
+    {
+      const BaseType *xRe = &stateRe[(s - 1)*lanes + c*nbands];
+      const BaseType *xIm = &stateIm[(s - 1)*lanes + c*nbands];
+      BaseType *re = &stateRe[s*lanes + c*nbands];
+      BaseType *im = &stateIm[s*lanes + c*nbands];
+      for (int b = 0; b < nbands; ++b)
+      {
+	BaseType yRe = poleRe[b]*re[b] - poleIm[b]*im[b] + gain[b]*xRe[b];
+	im[b] = poleRe[b]*im[b] + poleIm[b]*re[b] + gain[b]*xIm[b];
+	re[b] = yRe;
+      }
+    }
+  }
+
+  const BaseType *last = &stateRe[(stages - 1)*lanes];
+  for (int l = 0; l < lanes; ++l)
+    output[l] = 2*last[l];
+}
+
+// One variant of every kernel for the given target attribute.
+#define MCA_DEFINE_KERNELS(NAME, SET, TARGET) \
+  TARGET BaseType energy##NAME(const BaseType *x, int length) \
+  { return energyBody(x, length); } \
+  TARGET BaseType filteredEnergy##NAME(const BaseTypeC *left, const BaseTypeC *right, const BaseType *filter, int length) \
+  { return filteredEnergyBody(left, right, filter, length); } \
+  TARGET void splitMultiplyAccumulate##NAME(const BaseType *aRe, const BaseType *aIm, const BaseType *bRe, const BaseType *bIm, \
+					    int length, BaseType *yRe, BaseType *yIm) \
+  { splitMultiplyAccumulateBody(aRe, aIm, bRe, bIm, length, yRe, yIm); } \
+  TARGET void splitScaleAccumulate##NAME(BaseType aRe, BaseType aIm, const BaseType *bRe, const BaseType *bIm, \
+					 int length, BaseType *yRe, BaseType *yIm) \
+  { splitScaleAccumulateBody(aRe, aIm, bRe, bIm, length, yRe, yIm); } \
+  TARGET void splitCorrelation##NAME(const BaseType *re, const BaseType *im, const BaseType *cosine, const BaseType *sine, \
+				     int length, BaseType *cosSum, BaseType *sinSum) \
+  { splitCorrelationBody<BaseType, L>(re, im, cosine, sine, length, cosSum, sinSum); } \
+  TARGET void splitCorrelation32##NAME(const BaseType32 *re, const BaseType32 *im, const BaseType32 *cosine, const BaseType32 *sine, \
+				       int length, BaseType32 *cosSum, BaseType32 *sinSum) \
+  { splitCorrelationBody<BaseType32, 2*L>(re, im, cosine, sine, length, cosSum, sinSum); } \
+  TARGET void resonatorCascade##NAME(const BaseType *input, int nchannels, int nbands, int stages, const BaseType *poleRe, \
+				     const BaseType *poleIm, const BaseType *inputGainRe, const BaseType *inputGainIm, \
+				     const BaseType *gain, BaseType *stateRe, BaseType *stateIm, BaseType *output) \
+  { resonatorCascadeBody(input, nchannels, nbands, stages, poleRe, poleIm, inputGainRe, inputGainIm, gain, \
+			 stateRe, stateIm, output); } \
+  const KernelDispatch::Kernels kernels##NAME = {KernelDispatch::SET, &energy##NAME, &filteredEnergy##NAME, \
+						 &splitMultiplyAccumulate##NAME, &splitScaleAccumulate##NAME, &splitCorrelation##NAME, \
+						 &splitCorrelation32##NAME, &resonatorCascade##NAME};
+
+MCA_DEFINE_KERNELS(Scalar, SCALAR, )
+#ifdef MCA_KERNEL_DISPATCH
+MCA_DEFINE_KERNELS(SSE4, SSE4, __attribute__((target("sse4.2"))))
+MCA_DEFINE_KERNELS(AVX2, AVX2, __attribute__((target("avx2,fma"))))
+MCA_DEFINE_KERNELS(AVX512, AVX512, __attribute__((target("avx512f,avx512dq,avx2,fma"))))
+#endif
+
+#undef MCA_DEFINE_KERNELS
+
+}
+
+const KernelDispatch::Kernels &KernelDispatch::get()
+{
+  // Selected once, the first time a kernel is needed.
+  static const Kernels &kernels = select();
+  return kernels;
+}
+
+const KernelDispatch::Kernels &KernelDispatch::get(InstructionSet instructionSet)
+{
+  if (instructionSet > getSupportedInstructionSet())
+  {
+    std::ostringstream oss;
+    oss << "Instruction set " << getName(instructionSet) << " is not supported by this CPU, the best one is "
+	<< getName(getSupportedInstructionSet()) << ".";
+    throw(MCArrayException(oss.str()));
+  }
+
+  switch (instructionSet)
+  {
+#ifdef MCA_KERNEL_DISPATCH
+    case AVX512: return kernelsAVX512;
+    case AVX2: return kernelsAVX2;
+    case SSE4: return kernelsSSE4;
+#endif
+    default: return kernelsScalar;
+  }
+}
+
+KernelDispatch::InstructionSet KernelDispatch::getSupportedInstructionSet()
+{
+#ifdef MCA_KERNEL_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+    return AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SSE4;
+#endif
+  return SCALAR;
+}
+
+const char *KernelDispatch::getName(InstructionSet instructionSet)
+{
+  switch (instructionSet)
+  {
+    case AVX512: return "avx512";
+    case AVX2: return "avx2";
+    case SSE4: return "sse4";
+    default: return "scalar";
+  }
+}
+
+KernelDispatch::InstructionSet KernelDispatch::parseInstructionSet(const std::string &name)
+{
+  std::string lower(name);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+  for (InstructionSet set : {SCALAR, SSE4, AVX2, AVX512})
+  {
+    if (lower == getName(set))
+      return set;
+  }
+
+  std::ostringstream oss;
+  oss << "Unknown instruction set: " << name << ". Valid values are scalar, sse4, avx2 and avx512.";
+  throw(MCArrayException(oss.str()));
+}
+
+const KernelDispatch::Kernels &KernelDispatch::select()
+{
+  InstructionSet instructionSet = getSupportedInstructionSet();
+
+  const char *forced = getenv("MCARRAY_SIMD");
+  if (forced != NULL && *forced != '\0')
+  {
+    try
+    {
+      InstructionSet requested = parseInstructionSet(forced);
+      if (requested > instructionSet)
+      {
+	WARN_STREAM("MCARRAY_SIMD=" << forced << " is not supported by this CPU, using " << getName(instructionSet));
+      }
+      else
+	instructionSet = requested;
+    }
+    catch (MCArrayException &e)
+    {
+      WARN_STREAM(e.what() << " Using " << getName(instructionSet));
+    }
+  }
+
+  DEBUG_STREAM("Kernels built for " << getName(instructionSet));
+  return get(instructionSet);
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+* MaskStream.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/MaskStream.h>
+#include <mcarray/mcarray_exception.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace mca {
+
+MaskStream::MaskStream(int nbins, unsigned int nchannels, int capacity) :
+  _nbins(nbins),
+  _nchannels(nchannels),
+  _capacity(capacity),
+  _first(0),
+  _nframes(0),
+  _droppedFrames(0)
+{
+  if (_nbins < 1 || _nchannels < 1 || _capacity < 1)
+  {
+    std::ostringstream oss;
+    oss << "A mask stream needs at least one band, channel and frame: "
+	<< _nbins << " bands, " << _nchannels << " channels, " << _capacity << " frames.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  _indices.reset(new unsigned long[_capacity]);
+  _timestamps.reset(new double[_capacity]);
+  _masks.reset(new unsigned char[_capacity*_nbins]);
+  _gains.reset(new BaseType[_capacity*_nchannels*_nbins]);
+}
+
+void MaskStream::push(unsigned long index, double timestamp,
+		      const unsigned char *spatialMask, const unsigned char *temporalMask, const BaseType *gains)
+{
+  if (_nframes == _capacity)
+  {
+    _first = (_first + 1) % _capacity;
+    --_nframes;
+    ++_droppedFrames;
+  }
+
+  int s = slot(_nframes);
+  ++_nframes;
+
+  _indices[s] = index;
+  _timestamps[s] = timestamp;
+  unsigned char *mask = &_masks[s*_nbins];
+  for (int bin = 0; bin < _nbins; ++bin)
+    mask[bin] = spatialMask[bin] | temporalMask[bin];
+  std::copy(gains, gains + _nchannels*_nbins, &_gains[s*_nchannels*_nbins]);
+}
+
+void MaskStream::discard(int nframes)
+{
+  if (nframes < 0 || nframes > _nframes)
+  {
+    std::ostringstream oss;
+    oss << "Cannot discard " << nframes << " frames from a mask stream with " << _nframes << " frames.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  _first = (_first + nframes) % _capacity;
+  _nframes -= nframes;
+}
+
+}
@@ -28,28 +28,12 @@
 #include <wipp/wippstats.h>
 #include <wipp/wipputils.h>
 
-namespace mca{
-
-class null_deleter
-{
-    null_deleter()
-    {
-      return;
-    }
-  public:
-    ~null_deleter()
-    {
-      return;
-    }
-    void operator()(BaseType* v)
-    {
-      return;
-    }
-    friend class MultibandBinarualLocalisation;
-};
+#include <algorithm>
 
+namespace mca{
 
-MultibandBinarualLocalisation::MultibandBinarualLocalisation(int sampleRate, ArrayDescription microphonePositions, int nbins, bool usePowerFloor) :
+MultibandBinarualLocalisation::MultibandBinarualLocalisation(int sampleRate, ArrayDescription microphonePositions, int nbins, bool usePowerFloor, int nthreads,
+							     TauMatrix::Evaluation tauEvaluation) :
     SoundLocalisationImpl(microphonePositions),
     dsp::SubBandSTFTAnalysis(nbins,
 			     sampleRate,
@@ -66,8 +50,11 @@ MultibandBinarualLocalisation::MultibandBinarualLocalisation(int sampleRate, Arr
     _minFreq(100.0F/_sampleRate),
     _maxFreq(maxFreqForSpatialAliasing(_microphoneDistance)/_sampleRate),
     _usePowerFloor(usePowerFloor),
-    _gcc(getAnalysisLength()/2, _gcc.ONESIDEDFFT)
+    _tauEvaluation(tauEvaluation),
+    _framePower(0),
+    _frameHasSignal(false)
 {
+    initPowerFloor(_frameRate, _noiseMarginDB);
 
     if (_microphonePositions.size() != 2)
     {
@@ -80,12 +67,11 @@ MultibandBinarualLocalisation::MultibandBinarualLocalisation(int sampleRate, Arr
     _prob[0] = -1;
 
     _binDOAs.reset(new BaseType[_numberOfBins]);
+    _binCorrelations.reset(new BaseType[_numberOfBins]);
     _energyInDOA.reset(new BaseType[_numSteps]);
     _energies.reset(new BaseType[_numberOfBins]);
     _magnitude.reset(new BaseType[getAnalysisLength()/2]);
     _power.reset(new BaseType[getAnalysisLength()/2]);
-    _correlations.reset(new BaseTypeC[_numSteps]);
-    _correlationsReal.reset(new BaseType[_numSteps]);
     _mixedChannel.reset(new BaseTypeC[getAnalysisLength()]);
     _samplesDelay.reset(new BaseType[_numSteps]);
 
@@ -105,41 +91,72 @@ MultibandBinarualLocalisation::MultibandBinarualLocalisation(int sampleRate, Arr
 	wipp::setZeros(_prevCorrelationsReal[bin].get(), _numSteps);
     }
 
+    generateSubbandTauMatrices();
+
+    // Subbands are assigned to workers statically, so there is no point in having more workers than subbands.
+    int nworkers = std::max(1, std::min(nthreads, _numberOfBins));
+    if (nworkers > 1)
+    {
+	_workerPool.reset(new WorkerPool(nworkers));
+    }
+    for (int worker = 0; worker < nworkers; ++worker)
+    {
+	_workerEnergyInDOA.push_back(SignalPtr(new BaseType[_numSteps]));
+	_workerCorrelations.push_back(SignalPtr(new BaseType[_numSteps]));
+	_workerSubbands.push_back(SignalVector());
+	_workerSubbandPtrs.push_back(std::vector<double*>());
+	for (int c = 0; c < 2; ++c)
+	{
+	    _workerSubbands[worker].push_back(SignalPtr(new BaseType[getAnalysisLength()]));
+	    _workerSubbandPtrs[worker].push_back(_workerSubbands[worker][c].get());
+	}
+    }
+
     DEBUG_STREAM("MD: " << _microphoneDistance << " Fmin: " << _filterBank->getBinCenterFrequency(0)*_sampleRate << " Fmax: "
 		 << _filterBank->getBinCenterFrequency(_filterBank->getNBins()-1)*_sampleRate
-		 << " DOA step: " << toDegrees(_doaStep) << " Nbins: " << _numberOfBins);
+		 << " DOA step: " << toDegrees(_doaStep) << " Nbins: " << _numberOfBins << " Workers: " << nworkers);
 
     //        _plot.reset(new Gnuplot("lines"));
 }
 
-BaseType MultibandBinarualLocalisation::setPowerFloor(std::vector<BaseType*> &analysisFrames, int analysisLength, int nchannels, int sampleRate)
+void MultibandBinarualLocalisation::generateSubbandTauMatrices()
 {
-  null_deleter deleter;
-  SignalVector af;
-  for (size_t i = 0; i < analysisFrames.size(); ++i)
-  {
-    af.push_back(boost::shared_array<double>(analysisFrames[i], deleter));
-  }
-  setPowerFloor(af, analysisLength, nchannels, sampleRate);
-}
+    int complexAnalysisLength = getAnalysisLength()/2;
+    int coeficientsLength = _numberOfBins*complexAnalysisLength;
+    SignalPtr coefs(new BaseType[coeficientsLength]);
 
+    bool useSupport = (_filterBank->getFiltersCoeficients(coefs.get(), coeficientsLength) == coeficientsLength);
+    if (!useSupport)
+    {
+	WARN_STREAM("Unable to get the subband filters, tau matrices will cover the whole spectrum.");
+    }
 
-BaseType MultibandBinarualLocalisation::setPowerFloor(SignalVector &analysisFrames, int analysisLength, int nchannels, int sampleRate)
-{
-    int neededSamples = _durationToEstimatePowerFloor*sampleRate;
-    double power = dsp::SignalPower::FFTPower(analysisFrames, analysisLength)*(2*analysisLength-2);
-    _powerFloor += power;
-    _samplesConsumedForNoise += (2*analysisLength-2); // length is one-sided FFT length here.
-    if (_samplesConsumedForNoise >= neededSamples)
+    for (int bin = 0; bin < _numberOfBins; ++bin)
     {
-	_noiseEstimated = true;
-	_powerFloor /= _samplesConsumedForNoise;
-	_powerFloor = 10*log10(_powerFloor) + _noiseMarginDB;
+	int firstBin = 0;
+	int lastBin = complexAnalysisLength;
 
-	DEBUG_STREAM("POWER floor: " << _powerFloor);
-    }
+	// The support of the subband is the range of FFT bins where its filter is not zero.
+	if (useSupport)
+	{
+	    const BaseType *filter = &coefs[bin*complexAnalysisLength];
+	    while (firstBin < lastBin && filter[firstBin] <= 0)
+		++firstBin;
+	    while (lastBin > firstBin && filter[lastBin-1] <= 0)
+		--lastBin;
+	}
+
+	_subbandFilters.push_back(SignalPtr(new BaseType[lastBin - firstBin + 1]));
+	if (useSupport)
+	    wipp::copyBuffer(&coefs[bin*complexAnalysisLength + firstBin], _subbandFilters[bin].get(), lastBin - firstBin);
+	else
+	    wipp::set(1.0, _subbandFilters[bin].get(), lastBin - firstBin);
 
-    return _powerFloor;
+	_subbandTauMatrices.push_back(std::shared_ptr<TauMatrix>(
+					  new TauMatrix(_samplesDelay.get(), _numSteps, firstBin, lastBin, complexAnalysisLength, _tauEvaluation)));
+
+	TRACE_STREAM("BIN: " << bin << " support: [" << firstBin << ", " << lastBin << ")");
+    }
 }
 
 void MultibandBinarualLocalisation::processSetup(std::vector<double *> &analysisFrames, int analysisLength,
@@ -147,81 +164,133 @@ void MultibandBinarualLocalisation::processSetup(std::vector<double *> &analysis
 {
     wipp::setZeros(_energyInDOA.get(), _numSteps);
     wipp::setZeros(_binDOAs.get(),     _numberOfBins);
+    wipp::setZeros(_binCorrelations.get(), _numberOfBins);
     wipp::setZeros(_energies.get(),     _numberOfBins);
+    for (size_t worker = 0; worker < _workerEnergyInDOA.size(); ++worker)
+	wipp::setZeros(_workerEnergyInDOA[worker].get(), _numSteps);
+
+    //  I need to estimate noise Floor based on energies, because _analysisFrames do
+    // contain frequencies above maxFreq and thus it containes more energy.
+    // Or filter the signal in the parent class.
+
+    // Getting signal power and tracking the noise floor with it.
+    // Subbands are not analysed in frames below the floor.
+    _framePower = dsp::SignalPower::FFTLogPower(analysisFrames, analysisLength);
+    _frameHasSignal = updatePowerFloor(_framePower) || !_usePowerFloor;
 }
 
-void MultibandBinarualLocalisation::processOneSubband(std::vector<BaseType*> &analysisFrame, int length, int bin)
+void MultibandBinarualLocalisation::processParametrisation(std::vector<double *> &analysisFrames, int analysisLength,
+							   std::vector<double *> &dataChannels, int dataLength)
+{
+    processSetup(analysisFrames, analysisLength, dataChannels, dataLength);
+
+    if (_frameHasSignal)
+    {
+	if (_workerPool)
+	{
+	    const BaseTypeC *left = reinterpret_cast<const BaseTypeC*>(analysisFrames[0]);
+	    const BaseTypeC *right= reinterpret_cast<const BaseTypeC*>(analysisFrames[1]);
+	    int nworkers = _workerPool->size();
+
+	    // Worker w processes subbands w, w+nworkers, ... Each subband only writes its own
+	    // entries and the worker's partial energy per DOA, so workers share no state.
+	    _workerPool->run([&](int worker) {
+		for (int bin = worker; bin < _numberOfBins; bin += nworkers)
+		    processSubband(left, right, calculateSubbandPower(left, right, bin, analysisLength, worker), bin, worker);
+	    });
+	}
+	else
+	{
+	    for (int bin = 0; bin < _numberOfBins; ++bin)
+		processOneSubband(analysisFrames, analysisLength, bin);
+	}
+
+	// Traced here and not by the workers, the logger is not meant to be used from several threads.
+	for (int bin = 0; bin < _numberOfBins; ++bin)
+	{
+	    TRACE_STREAM("BIN: " << bin << " " << _filterBank->getBinCenterFrequency(bin)*_sampleRate << "Hz, E: "
+			 << _energies[bin] << ", DOA: " << toDegrees(_binDOAs[bin]) << " samples "
+			 << doaToDelayFarField(_binDOAs[bin], _microphoneDistance)*_sampleRate
+			 << ", C: " << _binCorrelations[bin]
+			 );
+	}
+    }
+
+    processSumamry(analysisFrames, analysisLength, dataChannels, dataLength);
+}
+
+BaseType MultibandBinarualLocalisation::calculateSubbandPower(const BaseTypeC *left, const BaseTypeC *right, int bin, int analysisLength,
+							      int worker)
 {
-    null_deleter deleter;
-    SignalVector af;
-    for (size_t i = 0; i < analysisFrame.size(); ++i)
+    // The subband is filtered as the parent class does, the filter is zero outside its support.
+    const BaseType *filter = _subbandFilters[bin].get();
+    int firstBin = _subbandTauMatrices[bin]->getFirstBin();
+    int nbins = _subbandTauMatrices[bin]->getLastBin() - firstBin;
+    std::vector<double*> &subband = _workerSubbandPtrs[worker];
+    const BaseTypeC *spectra[2] = {left, right};
+
+    for (int c = 0; c < 2; ++c)
     {
-      af.push_back(boost::shared_array<double>(analysisFrame[i], deleter));
+	wipp::setZeros(subband[c], analysisLength);
+	BaseTypeC *filtered = reinterpret_cast<BaseTypeC*>(subband[c]);
+	for (int k = 0; k < nbins; ++k)
+	{
+	    filtered[firstBin + k].re = filter[k]*spectra[c][firstBin + k].re;
+	    filtered[firstBin + k].im = filter[k]*spectra[c][firstBin + k].im;
+	}
     }
-    processOneSubband(af, length, bin);
+    return dsp::SignalPower::FFTPower(subband, analysisLength);
 }
 
-void MultibandBinarualLocalisation::processOneSubband(const SignalVector &analysisFrame, int length, int bin)
+void MultibandBinarualLocalisation::processOneSubband(std::vector<BaseType*> &analysisFrame, int length, int bin)
 {
-    // Calculate the phase of the FFT of the window.
-    // Calculate the DOA estimation for the current subband, using the GCC function.
-    dsp::Complex *left = reinterpret_cast<dsp::Complex*>(analysisFrame[0].get());
-    dsp::Complex *right= reinterpret_cast<dsp::Complex*>(analysisFrame[1].get());
+    const BaseTypeC *left = reinterpret_cast<const BaseTypeC*>(analysisFrame[0]);
+    const BaseTypeC *right= reinterpret_cast<const BaseTypeC*>(analysisFrame[1]);
+
+    processSubband(left, right, calculateSubbandPower(left, right, bin, length, 0), bin, 0);
+}
 
-    int complexAnalysisLength = length/2;
+void MultibandBinarualLocalisation::processSubband(const BaseTypeC *left, const BaseTypeC *right, BaseType energy, int bin, int worker)
+{
+    // Calculate the DOA estimation for the current subband, using the GCC function
+    // evaluated only over the bins where the subband filter is not zero.
+    BaseType *correlations = _workerCorrelations[worker].get();
     BaseType max;
     size_t idx;
 
-    _gcc.calculateCorrelationsForTauVector(left, right, reinterpret_cast<dsp::Complex*>(_correlations.get()), complexAnalysisLength,
-					   _samplesDelay.get(), _numSteps, _gcc.ONESIDEDFFT);
+    _subbandTauMatrices[bin]->calculateCorrelations(left, right, correlations);
 
-
-    wipp::real(reinterpret_cast<wipp::wipp_complex_t*>(_correlations.get()), _correlationsReal.get(), _numSteps);
-    wipp::multC((1-_corrMemoryFactor), _correlationsReal.get(), _numSteps);
+    wipp::multC((1-_corrMemoryFactor), correlations, _numSteps);
     wipp::multC(_corrMemoryFactor, _prevCorrelationsReal[bin].get(), _numSteps);
-    wipp::add(_prevCorrelationsReal[bin].get(), _correlationsReal.get(), _numSteps);
-    wipp::copyBuffer(_correlationsReal.get(), _prevCorrelationsReal[bin].get(), _numSteps);
-    wipp::maxidx(_correlationsReal.get(), _numSteps, &max, &idx);
+    wipp::add(_prevCorrelationsReal[bin].get(), correlations, _numSteps);
+    wipp::copyBuffer(correlations, _prevCorrelationsReal[bin].get(), _numSteps);
+    wipp::maxidx(correlations, _numSteps, &max, &idx);
 
     _binDOAs[bin] = doaIdx2angle(idx);
+    _binCorrelations[bin] = max;
 
-    _energies[bin] = dsp::SignalPower::FFTPower(analysisFrame, length);
-
-    _energyInDOA[idx] += _energies[bin];
+    _energies[bin] = energy;
 
-    TRACE_STREAM("BIN: " << bin << " " << _filterBank->getBinCenterFrequency(bin)*_sampleRate << "Hz, E: "
-		 << _energies[bin] << ", Idx: " << idx << " DOA: " << toDegrees(doaIdx2angle(idx)) << " samples " << doaToDelayFarField(doaIdx2angle(idx), _microphoneDistance)*_sampleRate
-		 << ", C: " << max
-		 );
+    _workerEnergyInDOA[worker][idx] += _energies[bin];
 }
 
 void MultibandBinarualLocalisation::processSumamry(std::vector<double *> &analysisFrames, int analysisLength,
 						   std::vector<double *> &dataChannels, int dataLength)
 {
+    // Merge the partial energies always in the same order, so that the result
+    // does not depend on how threads are scheduled.
+    for (size_t worker = 0; worker < _workerEnergyInDOA.size(); ++worker)
+	wipp::add(_workerEnergyInDOA[worker].get(), _energyInDOA.get(), _numSteps);
+
     if (_ptrCallback)
     {
 	BaseType DOA = 0;
-	BaseType power = 0;
+	BaseType power = _framePower;
 	BaseType maxEnergy;
 	size_t idx;
 
-	//  I need to estimate noise Floor based on energies, because _analysisFrames do
-	// contain frequencies above maxFreq and thus it containes more energy.
-	// Or filter the signal in the parent class.
-
-	// Getting signal power, and setting as floor if the first signal frame is processed.
-	if (!_noiseEstimated)
-	{
-	    power = setPowerFloor(analysisFrames, analysisLength/2, 2, _sampleRate);
-	}
-	else
-	{
-	    //              ippsMean_64f(_energies.get(), _numberOfBins, &power);
-	    power = dsp::SignalPower::FFTPower(analysisFrames, analysisLength);
-	}
-
 	// Only if singal power exceeds the floor power, the DOA is obtained
-	if (power > _powerFloor || !_usePowerFloor)
+	if (_frameHasSignal)
 	{
 	    wipp::sum(_energyInDOA.get(), _numSteps, &(_prob[0]));
 	    wipp::maxidx(_energyInDOA.get(), _numSteps, &maxEnergy, &idx);
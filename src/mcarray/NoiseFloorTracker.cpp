@@ -0,0 +1,96 @@
+/*
+* NoiseFloorTracker.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/NoiseFloorTracker.h>
+#include <mcarray/mcarray_exception.h>
+
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+NoiseFloorTracker::NoiseFloorTracker(int windowLength, double marginDB, double smoothing) :
+  _windowLength(windowLength),
+  _marginDB(marginDB),
+  _smoothing(smoothing),
+  _candidates(std::max(1, windowLength)),
+  _candidateFrames(std::max(1, windowLength))
+{
+  if (_windowLength < 1 || _smoothing < 0 || _smoothing >= 1)
+  {
+    std::ostringstream oss;
+    oss << "Wrong noise floor tracker parameters, window length: " << _windowLength
+	<< " frames, smoothing: " << _smoothing;
+    throw(MCArrayException(oss.str()));
+  }
+  reset();
+}
+
+int NoiseFloorTracker::getWindowLength(double duration, double frameRate)
+{
+  // The tolerance avoids an extra frame due to rounding errors when frameRate divides duration.
+  return std::max(1, static_cast<int>(ceil(duration/frameRate - 1e-6)));
+}
+
+void NoiseFloorTracker::reset()
+{
+  _smoothedPower = 0;
+  _frame = 0;
+  _first = 0;
+  _ncandidates = 0;
+  _estimated = false;
+  _floor = 0;
+}
+
+bool NoiseFloorTracker::update(BaseType powerDB)
+{
+  double power = pow(10, powerDB/10);
+  _smoothedPower = (_frame == 0) ? power : _smoothing*_smoothedPower + (1 - _smoothing)*power;
+  BaseType smoothedDB = 10*log10(_smoothedPower + 1e-20);
+
+  // The oldest candidate leaves the window.
+  if (_ncandidates > 0 && _candidateFrames[_first] + _windowLength <= _frame)
+  {
+    _first = (_first + 1) % _windowLength;
+    --_ncandidates;
+  }
+
+  // Candidates greater than the new power can not be the minimum any more.
+  while (_ncandidates > 0 && _candidates[(_first + _ncandidates - 1) % _windowLength] >= smoothedDB)
+    --_ncandidates;
+
+  int last = (_first + _ncandidates) % _windowLength;
+  _candidates[last] = smoothedDB;
+  _candidateFrames[last] = _frame;
+  ++_ncandidates;
+  ++_frame;
+
+  if (_frame >= static_cast<unsigned long>(_windowLength))
+  {
+    _estimated = true;
+    _floor = _candidates[_first] + _marginDB;
+  }
+
+  return _estimated && powerDB > _floor;
+}
+
+}
@@ -0,0 +1,270 @@
+/*
+* ProcessingGraph.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/ProcessingGraph.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/mcalogger.h>
+
+#include <wipp/wipputils.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace mca {
+
+// -------- FrameBufferPool -------------------------------------------------
+
+FrameBufferPool::FrameBufferPool(unsigned int nbuffers, unsigned int nchannels, int length) :
+  _length(length),
+  _channels(nbuffers),
+  _channelPtrs(nbuffers),
+  _references(nbuffers, 0)
+{
+  for (unsigned int b = 0; b < nbuffers; ++b)
+  {
+    for (unsigned int c = 0; c < nchannels; ++c)
+    {
+      _channels[b].push_back(SignalPtr(new BaseType[_length]));
+      _channelPtrs[b].push_back(_channels[b].back().get());
+    }
+  }
+
+  // Lower buffers are taken first.
+  _free.reserve(nbuffers);
+  for (int b = nbuffers - 1; b >= 0; --b)
+    _free.push_back(b);
+}
+
+int FrameBufferPool::acquire(int references)
+{
+  if (_free.empty())
+  {
+    std::ostringstream oss;
+    oss << "All the " << _references.size() << " buffers of the pool are in use.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  int buffer = _free.back();
+  _free.pop_back();
+  _references[buffer] = std::max(1, references);
+  return buffer;
+}
+
+void FrameBufferPool::release(int buffer)
+{
+  if (_references[buffer] <= 0)
+  {
+    std::ostringstream oss;
+    oss << "Buffer " << buffer << " of the pool released more times than it was referenced.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  if (--_references[buffer] == 0)
+    _free.push_back(buffer);
+}
+
+// -------- ProcessingGraph -------------------------------------------------
+
+ProcessingGraph::ProcessingGraph(unsigned int nchannels, int maxBlockLength) :
+  _nchannels(nchannels),
+  _maxBlockLength(maxBlockLength),
+  _outputNode(INPUT),
+  _outputLatency(0),
+  _built(false)
+{
+  _input.resize(_nchannels);
+}
+
+int ProcessingGraph::addProcessor(dsp::ShortTimeProcess *processor, int source)
+{
+  int node = addNode(processor, NULL, source);
+  _outputNode = node;
+  return node;
+}
+
+int ProcessingGraph::addAnalyser(dsp::ShortTimeAnalysis *analyser, int source)
+{
+  return addNode(NULL, analyser, source);
+}
+
+int ProcessingGraph::addNode(dsp::ShortTimeProcess *processor, dsp::ShortTimeAnalysis *analyser, int source)
+{
+  if (_built)
+    throw(MCArrayException("Nodes cannot be added to a graph that is already built."));
+
+  Node node;
+  node.processor = processor;
+  node.analyser = analyser;
+  node.source = resolveSource(source);
+  node.latency = 0;
+  node.readers = 0;
+
+  unsigned int nchannels = processor ? processor->getNumberOfChannels() : analyser->getNumberOfChannels();
+  if (nchannels != _nchannels)
+  {
+    std::ostringstream oss;
+    oss << "Node " << _nodes.size() << " works with " << nchannels << " channels but the graph has "
+	<< _nchannels << " channels.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  _nodes.push_back(node);
+  return _nodes.size() - 1;
+}
+
+int ProcessingGraph::resolveSource(int source) const
+{
+  if (source == OUTPUT)
+    return _outputNode;
+
+  if (source != INPUT && (source < 0 || source >= static_cast<int>(_nodes.size()) || !_nodes[source].processor))
+  {
+    std::ostringstream oss;
+    oss << "Node " << source << " is not a processor of the graph and cannot be used as a source.";
+    throw(MCArrayException(oss.str()));
+  }
+  return source;
+}
+
+void ProcessingGraph::build()
+{
+  if (_built)
+    return;
+
+  // Latency of the signal read by each node and number of readers of each processor.
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    Node &node = _nodes[i];
+    if (node.source != INPUT)
+    {
+      const Node &source = _nodes[node.source];
+      node.latency = source.latency + source.processor->getMaxLatency();
+      ++_nodes[node.source].readers;
+    }
+  }
+
+  if (_outputNode != INPUT)
+    _outputLatency = _nodes[_outputNode].latency + _nodes[_outputNode].processor->getMaxLatency();
+
+  // Intermediate buffers alive at the same time, in the same order process() takes and releases them.
+  std::vector<int> pendingReaders(_nodes.size());
+  int alive = 0, maxAlive = 0, bufferLength = 0;
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    const Node &node = _nodes[i];
+    pendingReaders[i] = node.readers;
+    if (node.processor && static_cast<int>(i) != _outputNode)
+    {
+      maxAlive = std::max(maxAlive, ++alive);
+      bufferLength = std::max(bufferLength, _maxBlockLength + node.latency + node.processor->getMaxLatency());
+      if (node.readers == 0)
+	--alive;
+    }
+    if (node.source != INPUT && node.source != _outputNode && --pendingReaders[node.source] == 0)
+      --alive;
+  }
+
+  _pool.reset(new FrameBufferPool(maxAlive, _nchannels, bufferLength));
+  _nodeBuffers.assign(_nodes.size(), -1);
+  _nodeLengths.assign(_nodes.size(), 0);
+  _built = true;
+
+  DEBUG_STREAM("Processing graph of " << _nodes.size() << " nodes built with "
+	       << maxAlive << " intermediate buffers and a latency of " << _outputLatency << " samples.");
+}
+
+int ProcessingGraph::getLatency(int node) const
+{
+  if (node < 0 || node >= static_cast<int>(_nodes.size()))
+  {
+    std::ostringstream oss;
+    oss << "Node " << node << " is not part of the graph.";
+    throw(MCArrayException(oss.str()));
+  }
+  return _nodes[node].latency;
+}
+
+void ProcessingGraph::releaseSource(int node)
+{
+  if (node != INPUT && _nodeBuffers[node] >= 0)
+    _pool->release(_nodeBuffers[node]);
+}
+
+int ProcessingGraph::process(const std::vector<double*> &input, int length, std::vector<double*> &output, int outputLength)
+{
+  if (!_built)
+    throw(MCArrayException("The processing graph has to be built before processing."));
+
+  if (length > _maxBlockLength || input.size() != _nchannels || output.size() != _nchannels)
+  {
+    std::ostringstream oss;
+    oss << "Graph of " << _nchannels << " channels and blocks of at most " << _maxBlockLength << " samples, but "
+	<< input.size() << " input channels, " << output.size() << " output channels and "
+	<< length << " samples given.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  // Nodes reading the input get it in place.
+  std::copy(input.begin(), input.end(), _input.begin());
+
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    const Node &node = _nodes[i];
+    std::vector<double*> &source = (node.source == INPUT) ? _input :
+				    (node.source == _outputNode) ? output : _pool->getChannels(_nodeBuffers[node.source]);
+    int sourceLength = (node.source == INPUT) ? length : _nodeLengths[node.source];
+
+    if (node.processor)
+    {
+      std::vector<double*> *target = &output;
+      int targetLength = outputLength;
+      if (static_cast<int>(i) != _outputNode)
+      {
+	_nodeBuffers[i] = _pool->acquire(node.readers);
+	target = &_pool->getChannels(_nodeBuffers[i]);
+	targetLength = _pool->getLength();
+      }
+
+      _nodeLengths[i] = (sourceLength > 0) ? node.processor->process(source, sourceLength, *target, targetLength) : 0;
+
+      if (static_cast<int>(i) != _outputNode && node.readers == 0)
+	_pool->release(_nodeBuffers[i]);
+    }
+    else if (sourceLength > 0)
+    {
+      node.analyser->process(source, sourceLength);
+    }
+
+    if (node.source != _outputNode)
+      releaseSource(node.source);
+  }
+
+  if (_outputNode == INPUT)
+  {
+    for (unsigned int c = 0; c < _nchannels; ++c)
+      wipp::copyBuffer(input[c], output[c], length);
+    return length;
+  }
+
+  return _nodeLengths[_outputNode];
+}
+
+}
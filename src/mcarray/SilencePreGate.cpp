@@ -0,0 +1,97 @@
+/*
+* SilencePreGate.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/SilencePreGate.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
+
+#include <wipp/wipputils.h>
+
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+SilencePreGate::SilencePreGate(unsigned int nchannels, int frameLength, double marginDB) :
+  _nchannels(nchannels),
+  _maxFrameLength(frameLength),
+  _marginDB(marginDB),
+  _frameLength(0),
+  _storedChannels(0),
+  _energy(0),
+  _offset(0),
+  _calibratedFrames(0)
+{
+  for (unsigned int c = 0; c < _nchannels; ++c)
+    _frames.push_back(SignalPtr(new BaseType[_maxFrameLength]));
+}
+
+void SilencePreGate::storeFrame(const BaseType *frame, int frameLength, unsigned int channel)
+{
+  if (frameLength > _maxFrameLength || channel >= _nchannels)
+  {
+    std::ostringstream oss;
+    oss << "Frame of channel " << channel << " and length " << frameLength << " given to a gate of "
+	<< _nchannels << " channels and frames of " << _maxFrameLength << " samples.";
+    throw(MCArrayException(oss.str()));
+  }
+
+  wipp::copyBuffer(frame, _frames[channel].get(), frameLength);
+  _energy += KernelDispatch::get().energy(frame, frameLength);
+  _frameLength = frameLength;
+  ++_storedChannels;
+}
+
+BaseType SilencePreGate::getTimePower() const
+{
+  return 10*log10(_energy/(_nchannels*_frameLength) + 1e-20);
+}
+
+BaseType SilencePreGate::getEstimatedPower() const
+{
+  return getTimePower() + _offset;
+}
+
+bool SilencePreGate::isSilent(const NoiseFloorTracker &floor) const
+{
+  return _calibratedFrames >= _calibrationFrames && floor.isEstimated()
+      && getEstimatedPower() + _marginDB < floor.getFloor();
+}
+
+void SilencePreGate::calibrate(BaseType spectralPower)
+{
+  // Silent frames (no energy) say nothing about the offset.
+  if (_energy <= 0)
+    return;
+
+  double offset = spectralPower - getTimePower();
+  _offset = (_calibratedFrames == 0) ? offset : _offsetMemoryFactor*_offset + (1 - _offsetMemoryFactor)*offset;
+  if (_calibratedFrames < _calibrationFrames)
+    ++_calibratedFrames;
+}
+
+void SilencePreGate::clear()
+{
+  _storedChannels = 0;
+  _energy = 0;
+}
+
+}
@@ -32,8 +32,7 @@ SoundLocalisationImpl::SoundLocalisationImpl(ArrayDescription microphonePosition
   _ptrCallback(NULL),
   _microphonePositions(microphonePositions),
   _powerFloor(0),
-  _noiseEstimated(false),
-  _samplesConsumedForNoise(0)
+  _noiseEstimated(false)
 {
   _observationModel.reset(new SoundLocalisationObservationModel(this));
   _predictionModel.reset(new SoundLocalisationPredicitonModel(0, 0));
@@ -52,6 +51,23 @@ void SoundLocalisationImpl::setCallback(LocalisationCallback &callback)
   _ptrCallback = &callback;
 }
 
+void SoundLocalisationImpl::initPowerFloor(double frameRate, double marginDB)
+{
+  _noiseFloor.reset(new NoiseFloorTracker(NoiseFloorTracker::getWindowLength(_durationToEstimatePowerFloor, frameRate), marginDB));
+  _powerFloor = 0;
+  _noiseEstimated = false;
+}
+
+bool SoundLocalisationImpl::updatePowerFloor(BaseType power)
+{
+  bool signal = _noiseFloor->update(power);
+  if (!_noiseEstimated && _noiseFloor->isEstimated())
+    DEBUG_STREAM("POWER floor: " << _noiseFloor->getFloor());
+  _noiseEstimated = _noiseFloor->isEstimated();
+  _powerFloor = _noiseFloor->getFloor();
+  return signal;
+}
+
 void SoundLocalisationImpl::setProbability(const double* , double *probs, int size)
 {
   wipp::set(static_cast<double>(1)/size, probs, size);
@@ -48,11 +48,14 @@ class null_deleter
     friend class SourceLocalisation;
 };
 
-SourceLocalisation::SourceLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor) :
-  STFTAnalysis(microphonePositions.size(), dsp::ShortTimeProcess::calculateOrderFromSampleRate(sampleRate, _frameRate)),
-  _sampleRate(sampleRate)
+SourceLocalisation::SourceLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor,
+				       SteeringBeamforming::LocalisationMethod method, float frameRate) :
+  STFTAnalysis(microphonePositions.size(), dsp::ShortTimeProcess::calculateOrderFromSampleRate(sampleRate, frameRate)),
+  _sampleRate(sampleRate),
+  _preGate(microphonePositions.size(), getWindowSize())
 {
-  _impl.reset(new BeamformingSeparationAndLocalisation(sampleRate, getAnalysisLength(), microphonePositions, numOfSources, usePowerFloor));
+  _impl.reset(new BeamformingSeparationAndLocalisation(sampleRate, getAnalysisLength(), microphonePositions, numOfSources, usePowerFloor,
+						       Beamformer::DELAY_AND_SUM, method));
 
   for (unsigned int c = 0; c < getNumberOfChannels(); c++)
   {
@@ -64,6 +67,24 @@ SourceLocalisation::SourceLocalisation(int sampleRate, ArrayDescription micropho
 void SourceLocalisation::processParametrisation(std::vector<double *> &analysisFrames, int analysisLength,
 						std::vector<double *> &dataChannels, int dataLength)
 {
+  // The FFT is skipped if the frame is clearly below the noise floor,
+  // then only the noise floor is updated.
+  const NoiseFloorTracker *floor = _impl->getNoiseFloorTracker();
+  if (_preGate.hasFrame() && floor && _preGate.isSilent(*floor))
+  {
+    _impl->processSilentFrame(_preGate.getEstimatedPower());
+    _preGate.clear();
+    return;
+  }
+
+  bool timeFrames = _preGate.hasFrame();
+  if (timeFrames)
+  {
+    for (unsigned int c = 0; c < analysisFrames.size(); ++c)
+      STFTAnalysis::frameAnalysis(const_cast<BaseType*>(_preGate.getFrame(c)), analysisFrames[c],
+				  _preGate.getFrameLength(), analysisLength, c);
+  }
+
   // Apply noise reduction
     //  _noiseReduction.processFrame(_analysisFrames, _denoisedFrames);
     //  _noiseReduction.getWienerCoefs(_wienerCoefs);
@@ -75,9 +96,32 @@ void SourceLocalisation::processParametrisation(std::vector<double *> &analysisF
   {
     af.push_back(boost::shared_array<double>(*it, deleter));
   }
-  _impl->processFrameLocalisation(af, _subBandWeights);
+  BaseType power = _impl->processFrameLocalisation(af, _subBandWeights);
   //          _impl->processFrameLocalisation(_denoisedFrames, _wienerCoefs);
 
+  if (timeFrames)
+    _preGate.calibrate(power);
+  _preGate.clear();
+
+}
+
+void SourceLocalisation::frameAnalysis(BaseType *inFrame, BaseType *, int frameLength, int, int channel)
+{
+  _preGate.storeFrame(inFrame, frameLength, channel);
+}
+
+void SourceLocalisation::consumeSpectrum(const SpectralFrame &frame)
+{
+  frame.checkCompatibility(getNumberOfChannels(), getAnalysisLength());
+
+  // Localisation only reads the analysis frames.
+  SignalVector af;
+  null_deleter deleter;
+  for (unsigned int c = 0; c < frame.getNumberOfChannels(); ++c)
+  {
+    af.push_back(boost::shared_array<double>(const_cast<BaseType*>(frame.getChannel(c)), deleter));
+  }
+  _impl->processFrameLocalisation(af, _subBandWeights);
 }
 
 void SourceLocalisation::setCallback(LocalisationCallback *callback)
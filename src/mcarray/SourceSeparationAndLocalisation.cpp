@@ -48,13 +48,14 @@ class null_deleter
     friend class SourceSeparationAndLocalisation;
 };
 
-SourceSeparationAndLocalisation::SourceSeparationAndLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor) :
-  STFT(microphonePositions.size(), calculateOrderFromSampleRate(sampleRate, _frameRate)),
+SourceSeparationAndLocalisation::SourceSeparationAndLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor,
+								 Beamformer::BeamformerType beamformerType, float frameRate) :
+  STFT(microphonePositions.size(), calculateOrderFromSampleRate(sampleRate, frameRate)),
   _sampleRate(sampleRate)
 //  _noiseReduction(sampleRate, microphonePositions.size(), _analysisLength),
 // _wienerFilterLength(_noiseReduction.getWienerFilterLength())
 {
-  _impl.reset(new BeamformingSeparationAndLocalisation(sampleRate, getAnalysisLength(), microphonePositions, numOfSources, usePowerFloor));
+  _impl.reset(new BeamformingSeparationAndLocalisation(sampleRate, getAnalysisLength(), microphonePositions, numOfSources, usePowerFloor, beamformerType));
 
   for (unsigned int c = 0; c < getNumberOfChannels(); c++)
   {
@@ -93,6 +94,23 @@ void SourceSeparationAndLocalisation::processParametrisation(
   //          _impl->processFrameSeparation(_denoisedFrames, _analysisFrames);
 }
 
+void SourceSeparationAndLocalisation::processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames)
+{
+  input.checkCompatibility(getNumberOfChannels(), getAnalysisLength());
+
+  // Separation works in place, so the input is copied to the output first.
+  SignalVector sf;
+  null_deleter deleter;
+  for (unsigned int c = 0; c < input.getNumberOfChannels(); ++c)
+  {
+    wipp::copyBuffer(input.getChannel(c), outputFrames[c], input.getAnalysisLength());
+    sf.push_back(boost::shared_array<double>(outputFrames[c], deleter));
+  }
+
+  std::vector<double*> noDataChannels;
+  processParametrisation(sf, input.getAnalysisLength(), noDataChannels, 0);
+}
+
 void SourceSeparationAndLocalisation::setCallback(LocalisationCallback *callback)
 {
   _impl->setCallback(callback);
@@ -103,6 +121,16 @@ void SourceSeparationAndLocalisation::setCallback(LocalisationCallback &callback
   _impl->setCallback(callback);
 }
 
+void SourceSeparationAndLocalisation::setLocalisationRate(const BeamformingSeparationAndLocalisation::LocalisationRate &rate)
+{
+  _impl->setLocalisationRate(rate);
+}
+
+void SourceSeparationAndLocalisation::setSourceCounting(bool enable)
+{
+  _impl->setSourceCounting(enable);
+}
+
 //----------------- SourceLocalisation ---------------------------------------------------
 
 //SourceLocalisation::SourceLocalisation(int sampleRate, ArrayDescription microphonePositions, unsigned int numOfSources, bool usePowerFloor) :
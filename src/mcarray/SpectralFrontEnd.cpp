@@ -0,0 +1,206 @@
+/*
+* SpectralFrontEnd.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/SpectralFrontEnd.h>
+#include <mcarray/mcarray_exception.h>
+
+#include <wipp/wipputils.h>
+
+#include <sstream>
+
+namespace mca {
+
+// -------- SpectralFrame ---------------------------------------------------
+
+SpectralFrame::SpectralFrame(const std::vector<double*> &analysisFrames, int analysisLength, unsigned long index) :
+  _channels(analysisFrames.begin(), analysisFrames.end()),
+  _analysisLength(analysisLength),
+  _index(index)
+{
+
+}
+
+void SpectralFrame::checkCompatibility(unsigned int nchannels, int analysisLength) const
+{
+  if (getNumberOfChannels() != nchannels || _analysisLength != analysisLength)
+  {
+    std::ostringstream oss;
+    oss << "Spectrum of " << getNumberOfChannels() << " channels and length " << _analysisLength
+	<< " given, but " << nchannels << " channels of length " << analysisLength << " expected. "
+	<< "Check that all modules use the same frame rate.";
+    throw(MCArrayException(oss.str()));
+  }
+}
+
+// -------- SpectralBlock ---------------------------------------------------
+
+SpectralBlock::SpectralBlock(const std::vector<double*> &blocks, int analysisLength, int nframes, unsigned long firstIndex) :
+  _blocks(blocks.begin(), blocks.end()),
+  _analysisLength(analysisLength),
+  _nframes(nframes),
+  _firstIndex(firstIndex),
+  _frame(blocks, analysisLength, firstIndex)
+{
+
+}
+
+const SpectralFrame &SpectralBlock::getFrame(int frame) const
+{
+  for (unsigned int c = 0; c < _blocks.size(); ++c)
+    _frame._channels[c] = getChannel(frame, c);
+  _frame._index = _firstIndex + frame;
+  return _frame;
+}
+
+void SpectralBlock::checkCompatibility(unsigned int nchannels, int analysisLength) const
+{
+  _frame.checkCompatibility(nchannels, analysisLength);
+}
+
+// -------- Consumers and processors ----------------------------------------
+
+void SpectrumConsumer::consumeSpectra(const SpectralBlock &block)
+{
+  for (int f = 0; f < block.getNumberOfFrames(); ++f)
+    consumeSpectrum(block.getFrame(f));
+}
+
+void SpectrumProcessor::processSpectra(const SpectralBlock &input, std::vector<double*> &outputBlocks)
+{
+  std::vector<double*> outputFrames(outputBlocks.size());
+  for (int f = 0; f < input.getNumberOfFrames(); ++f)
+  {
+    for (size_t c = 0; c < outputBlocks.size(); ++c)
+      outputFrames[c] = outputBlocks[c] + f*input.getAnalysisLength();
+    processSpectrum(input.getFrame(f), outputFrames);
+  }
+}
+
+// -------- SpectralFrontEnd ------------------------------------------------
+
+SpectralFrontEnd::SpectralFrontEnd(int sampleRate, unsigned int nchannels, float frameRate) :
+  dsp::STFT(nchannels, calculateOrderFromSampleRate(sampleRate, frameRate)),
+  _frameRate(frameRate),
+  _frameIndex(0),
+  _blockCapacity(0)
+{
+  for (int i = 0; i < 2; ++i)
+  {
+    for (unsigned int c = 0; c < nchannels; ++c)
+    {
+      _processedFrames[i].push_back(SignalPtr(new BaseType[getAnalysisLength()]));
+      _processedFramesPtrs[i].push_back(_processedFrames[i].back().get());
+    }
+  }
+}
+
+void SpectralFrontEnd::addConsumer(SpectrumConsumer *consumer)
+{
+  _consumers.push_back(consumer);
+  _processors.push_back(NULL);
+}
+
+void SpectralFrontEnd::addProcessor(SpectrumProcessor *processor)
+{
+  _consumers.push_back(NULL);
+  _processors.push_back(processor);
+}
+
+void SpectralFrontEnd::processParametrisation(std::vector<double*> &analysisFrames, int analysisLength,
+					      std::vector<double*> &dataChannels, int dataLength)
+{
+  std::vector<double*> *current = &analysisFrames;
+  int next = 0;
+
+  for (size_t stage = 0; stage < _consumers.size(); ++stage)
+  {
+    SpectralFrame frame(*current, analysisLength, _frameIndex);
+    if (_consumers[stage])
+    {
+      _consumers[stage]->consumeSpectrum(frame);
+    }
+    else
+    {
+      _processors[stage]->processSpectrum(frame, _processedFramesPtrs[next]);
+      current = &_processedFramesPtrs[next];
+      next = 1 - next;
+    }
+  }
+
+  // The synthesis is done from analysisFrames.
+  if (current != &analysisFrames)
+  {
+    for (size_t c = 0; c < analysisFrames.size(); ++c)
+      wipp::copyBuffer((*current)[c], analysisFrames[c], analysisLength);
+  }
+
+  ++_frameIndex;
+}
+
+void SpectralFrontEnd::processSpectra(const std::vector<double*> &blocks, int nframes, std::vector<double*> &outputBlocks)
+{
+  int analysisLength = getAnalysisLength();
+  if (nframes > _blockCapacity)
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      _processedBlocks[i].clear();
+      _processedBlocksPtrs[i].clear();
+      for (size_t c = 0; c < blocks.size(); ++c)
+      {
+	_processedBlocks[i].push_back(SignalPtr(new BaseType[nframes*analysisLength]));
+	_processedBlocksPtrs[i].push_back(_processedBlocks[i].back().get());
+      }
+    }
+    _blockCapacity = nframes;
+  }
+
+  const std::vector<double*> *current = &blocks;
+  int next = 0;
+
+  for (size_t stage = 0; stage < _consumers.size(); ++stage)
+  {
+    SpectralBlock block(*current, analysisLength, nframes, _frameIndex);
+    if (_consumers[stage])
+    {
+      _consumers[stage]->consumeSpectra(block);
+    }
+    else
+    {
+      _processors[stage]->processSpectra(block, _processedBlocksPtrs[next]);
+      current = &_processedBlocksPtrs[next];
+      next = 1 - next;
+    }
+  }
+
+  if (current != &outputBlocks)
+  {
+    for (size_t c = 0; c < outputBlocks.size(); ++c)
+    {
+      if ((*current)[c] != outputBlocks[c])
+	wipp::copyBuffer((*current)[c], outputBlocks[c], nframes*analysisLength);
+    }
+  }
+
+  _frameIndex += nframes;
+}
+
+}
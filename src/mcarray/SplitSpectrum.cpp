@@ -0,0 +1,67 @@
+/*
+* SplitSpectrum.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/SplitSpectrum.h>
+
+#include <wipp/wipputils.h>
+
+namespace mca {
+
+SplitSpectrum::SplitSpectrum(unsigned int nchannels, int complexLength) :
+  _complexLength(complexLength)
+{
+  for (unsigned int c = 0; c < nchannels; ++c)
+  {
+    _real.push_back(SignalPtr(new BaseType[_complexLength + 1]));
+    _imag.push_back(SignalPtr(new BaseType[_complexLength + 1]));
+    setZeros(c);
+  }
+}
+
+void SplitSpectrum::deinterleave(const BaseTypeC *spectrum, unsigned int channel)
+{
+  BaseType *re = _real[channel].get();
+  BaseType *im = _imag[channel].get();
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    re[k] = spectrum[k].re;
+    im[k] = spectrum[k].im;
+  }
+}
+
+void SplitSpectrum::interleave(unsigned int channel, BaseTypeC *spectrum) const
+{
+  const BaseType *re = _real[channel].get();
+  const BaseType *im = _imag[channel].get();
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    spectrum[k].re = re[k];
+    spectrum[k].im = im[k];
+  }
+}
+
+void SplitSpectrum::setZeros(unsigned int channel)
+{
+  wipp::setZeros(_real[channel].get(), _complexLength);
+  wipp::setZeros(_imag[channel].get(), _complexLength);
+}
+
+}
@@ -0,0 +1,110 @@
+/*
+* SteeredResponsePower.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/SteeredResponsePower.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
+
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+SteeredResponsePower::SteeredResponsePower(const SignalVector &delays, int numSteps, int complexLength) :
+  _nchannels(delays.size()),
+  _numSteps(numSteps),
+  _complexLength(complexLength)
+{
+  if (complexLength < 2)
+  {
+    std::ostringstream oss;
+    oss << "One-sided FFT length has to be at least 2: " << complexLength;
+    throw(MCArrayException(oss.str()));
+  }
+
+  _tableRe.reset(new BaseType[_complexLength*_nchannels*_numSteps]);
+  _tableIm.reset(new BaseType[_complexLength*_nchannels*_numSteps]);
+  _responseRe.reset(new BaseType[_numSteps]);
+  _responseIm.reset(new BaseType[_numSteps]);
+
+  // w_k = 2*pi*k/N, with N = 2*(complexLength-1) the length of the FFT.
+  double w0 = M_PI/(complexLength-1);
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    for (int c = 0; c < _nchannels; ++c)
+    {
+      BaseType *re = &_tableRe[(k*_nchannels + c)*_numSteps];
+      BaseType *im = &_tableIm[(k*_nchannels + c)*_numSteps];
+      for (int t = 0; t < _numSteps; ++t)
+      {
+	double phase = w0*k*delays[c][t];
+	re[t] = cos(phase);
+	im[t] = sin(phase);
+      }
+    }
+  }
+}
+
+void SteeredResponsePower::calculateResponse(const SignalVector &analysisFrames, BaseType *response)
+{
+  BaseType * __restrict sumRe = _responseRe.get();
+  BaseType * __restrict sumIm = _responseIm.get();
+  BaseType * __restrict out = response;
+  BaseType activeChannels = 0;
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
+
+  for (int t = 0; t < _numSteps; ++t)
+    out[t] = 0;
+
+  for (int k = 0; k < _complexLength; ++k)
+  {
+    for (int t = 0; t < _numSteps; ++t)
+    {
+      sumRe[t] = 0;
+      sumIm[t] = 0;
+    }
+
+    for (int c = 0; c < _nchannels; ++c)
+    {
+      const BaseTypeC &x = reinterpret_cast<const BaseTypeC*>(analysisFrames[c].get())[k];
+      double magnitude = sqrt(x.re*x.re + x.im*x.im);
+      if (magnitude <= 1e-20)
+	continue;
+
+      // PHAT weighting: only the phase of each channel is kept.
+      double xr = x.re/magnitude;
+      double xi = x.im/magnitude;
+      ++activeChannels;
+
+      kernels.splitScaleAccumulate(xr, xi, &_tableRe[(k*_nchannels + c)*_numSteps], &_tableIm[(k*_nchannels + c)*_numSteps],
+				   _numSteps, sumRe, sumIm);
+    }
+
+    for (int t = 0; t < _numSteps; ++t)
+      out[t] += sumRe[t]*sumRe[t] + sumIm[t]*sumIm[t];
+  }
+
+  // Remove the auto-correlation terms, one per channel and bin.
+  for (int t = 0; t < _numSteps; ++t)
+    out[t] = (out[t] - activeChannels)/2;
+}
+
+}
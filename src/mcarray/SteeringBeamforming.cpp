@@ -20,28 +20,43 @@
 * along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <mcarray/SteeringBeamforming.h>
+#include <mcarray/SteeredResponsePower.h>
+#include <mcarray/TauMatrix.h>
 #include <mcarray/mcalogger.h>
 
-#include <dspone/algorithm/gralCrossCorrelation.h>
 #include <dspone/filter/MedianFilter.h>
 
 #include <wipp/wipputils.h>
 #include <wipp/wippsignal.h>
 #include <wipp/wippstats.h>
 
+#include <algorithm>
+
 namespace mca {
 
-SteeringBeamforming::SteeringBeamforming(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels) :
+SteeringBeamforming::SteeringBeamforming(int sampleRate, ArrayDescription microphonePositions, int fftCCSLength, unsigned int nchannels,
+					 LocalisationMethod method) :
   _sampleRate(sampleRate),
   _fftCCSLength(fftCCSLength),
   _complexFFTCCSLength(fftCCSLength/2),
   _nchannels(nchannels),
   _doaStep(5*M_PI/180),
   _numSteps(round(M_PI/_doaStep) + 1),
-  _microphonePositions(microphonePositions)
+  _method(method),
+  _numPairs(nchannels*(nchannels-1)/2),
+  _microphonePositions(microphonePositions),
+  _activeSources(0)
 {
   allocate();
-  generateLookupTable();
+  if (_method == SRP_PHAT)
+    generateSteeringTable();
+  else
+    generateLookupTable();
+}
+
+SteeringBeamforming::~SteeringBeamforming()
+{
+
 }
 
 void SteeringBeamforming::allocate()
@@ -52,7 +67,6 @@ void SteeringBeamforming::allocate()
   _firstDerivative.reset(new BaseType[_numSteps-1]);
   _filteredFirstDerivative.reset(new BaseType[_numSteps-1]);
   _secondDerivative.reset(new BaseType[_numSteps-2]);
-  _complexCorrelation.reset(new BaseTypeC[_numSteps]);
 }
 
 void SteeringBeamforming::generateLookupTable()
@@ -80,12 +94,15 @@ void SteeringBeamforming::generateLookupTable()
       // cross-correlation for one delay (DOA).
       _correlations.push_back(SignalPtr(new BaseType[_numSteps]));
 
-      // For each micro pair, create a GCC object and precompute the delay matrix according to 'delaysForMicroPair'
-      _gcc.push_back(std::shared_ptr<dsp::GeneralisedCrossCorrelation>
-		     (new dsp::GeneralisedCrossCorrelation(_complexFFTCCSLength, dsp::GeneralisedCrossCorrelation::ONESIDEDFFT)));
-
-      _gcc.back()->precomputeTauMatrix(delaysForMicroPair.get(), _numSteps, _complexFFTCCSLength,
-				       dsp::GeneralisedCrossCorrelation::ONESIDEDFFT);
+      // For each micro pair, precompute the delay matrix according to 'delaysForMicroPair'
+      // (or only its rotation phasors, which is enough to generate it frame by frame).
+      TauMatrix::Evaluation evaluation = (_method == PAIRWISE_GCC_RECURRENCE) ? TauMatrix::RECURRENCE : TauMatrix::TABLE;
+      int firstBin = 0, lastBin = _complexFFTCCSLength;
+      if (_method == PAIRWISE_GCC_BAND_LIMITED)
+	getUsefulBand(distance, _sampleRate, _complexFFTCCSLength, firstBin, lastBin);
+      _gcc.push_back(std::shared_ptr<TauMatrix>(new TauMatrix(delaysForMicroPair.get(), _numSteps,
+							      firstBin, lastBin, _complexFFTCCSLength, evaluation)));
+      TRACE_STREAM("Micro Pair [" << i << ", " << j << "]. GCC band: [" << firstBin << ", " << lastBin << ")");
 
       // row 'k' of _microPairIdx contains the indexs of the two microphones of the micro pair 'k'.
       _microPairIdx.push_back({i, j});
@@ -93,6 +110,25 @@ void SteeringBeamforming::generateLookupTable()
   }
 }
 
+void SteeringBeamforming::generateSteeringTable()
+{
+  // Delay of each channel with respect to the first one, for each DOA. For a pair (i, j)
+  // delays[i] - delays[j] is the delay used for that pair in generateLookupTable.
+  SignalVector delays;
+  for (unsigned int c = 0; c < _nchannels; ++c)
+  {
+    double position = _microphonePositions.getX(c) - _microphonePositions.getX(0);
+    delays.push_back(SignalPtr(new BaseType[_numSteps]));
+    for (int doa = 0; doa < _numSteps; ++doa)
+      delays[c][doa] = -doaToDelayFarFieldSamples(doaIdx2angle(doa, _doaStep), position, _sampleRate);
+  }
+
+  _srp.reset(new SteeredResponsePower(delays, _numSteps, _complexFFTCCSLength));
+
+  // A single vector with the correlations of all pairs already summed.
+  _correlations.push_back(SignalPtr(new BaseType[_numSteps]));
+}
+
 void SteeringBeamforming::processFrame(const SignalVector &analysisFrames, SignalPtr DOA, SignalPtr prob, int numOfSources, SignalVector &wienerCoefs)
 {
   computeCorrelations(analysisFrames, wienerCoefs);
@@ -103,23 +139,22 @@ void SteeringBeamforming::processFrame(const SignalVector &analysisFrames, Signa
 
 void SteeringBeamforming::computeCorrelations(const SignalVector &analysisFrames, SignalVector &wienerCoefs)
 {
+  if (_method == SRP_PHAT)
+  {
+    _srp->calculateResponse(analysisFrames, _correlations[0].get());
+    return;
+  }
+
   // Compute the correlation for each micro pair.
   for (unsigned int pairIdx = 0; pairIdx < _correlations.size(); ++pairIdx)
   {
     // Take the frames of the micro pair 'pairIdx' using the information in '_microPairIdx'.
-    dsp::Complex *frameA = reinterpret_cast<dsp::Complex*>(analysisFrames[_microPairIdx[pairIdx][0]].get());
-    dsp::Complex *frameB = reinterpret_cast<dsp::Complex*>(analysisFrames[_microPairIdx[pairIdx][1]].get());
+    const BaseTypeC *frameA = reinterpret_cast<const BaseTypeC*>(analysisFrames[_microPairIdx[pairIdx][0]].get());
+    const BaseTypeC *frameB = reinterpret_cast<const BaseTypeC*>(analysisFrames[_microPairIdx[pairIdx][1]].get());
 
-    // Compute the correlations using the precomputed delays matrix.
+    // Compute the correlations using the precomputed delays matrix and store them in _correlations vector.
     // Wiener coefs are not used yet, but are accessible from here.
-    _gcc[pairIdx]->calculateCorrelationsForPrecomputedTauMatrix(frameA, frameB,
-								reinterpret_cast<dsp::Complex*>(_complexCorrelation.get()),
-								_complexFFTCCSLength,
-								_numSteps,
-								dsp::GeneralisedCrossCorrelation::ONESIDEDFFT);
-
-    // Store the real part of the correlation in _correlations vector.
-    wipp::real(reinterpret_cast<wipp::wipp_complex_t*>(_complexCorrelation.get()), _correlations[pairIdx].get(), _numSteps);
+    _gcc[pairIdx]->calculateCorrelations(frameA, frameB, _correlations[pairIdx].get());
 
     for (int i = 0; i < _numSteps; ++i)
     {
@@ -148,8 +183,7 @@ void SteeringBeamforming::selectDOA(SignalPtr DOA, SignalPtr prob, int numOfSour
 
   double max;
   size_t maxIdx;
-  int numPairs = _correlations.size();
-  const double minEnergyInDOA = -15*numPairs; // Min possible value of energyInDOA (ad-hoc).
+  const double minEnergyInDOA = -15*_numPairs; // Min possible value of energyInDOA (ad-hoc).
 
   // Min-max normalization
   wipp::subC(minEnergyInDOA, _energyInDOA.get(), _numSteps);
@@ -182,6 +216,11 @@ void SteeringBeamforming::selectDOA(SignalPtr DOA, SignalPtr prob, int numOfSour
   // Find "numOfSources" maximums in _secondDerivative. Peaks with more energy will be found first.
   // Negative peaks (minimums) will not be found (0 > negative_peak). When all positive peaks are found,
   // then prob = 0.
+  // The sources that follow the first one are active while their peaks are prominent enough, with
+  // hysteresis so that a source does not come and go between frames. A first peak without
+  // prominence (a flat energy) cannot be a reference, and only the first source is then active.
+  BaseType firstProminence = 0;
+  int activeSources = 0;
   for (int s = 0; s < numOfSources; ++s)
   {
     //    ippsMaxIndx_64f(_secondDerivative.get(), _numSteps-2, &max, &maxIdx);
@@ -191,7 +230,32 @@ void SteeringBeamforming::selectDOA(SignalPtr DOA, SignalPtr prob, int numOfSour
     DOA[s] = doaIdx2angle(maxIdx+1, _doaStep);
     //@TODO: Estimate the probability in a reliable manner.
     prob[s] = max;
+
+    if (s == 0)
+    {
+      firstProminence = peakProminence(maxIdx+1);
+      activeSources = 1;
+    }
+    else if (activeSources == s && max > 0 && firstProminence > 0)
+    {
+      double threshold = (s < _activeSources) ? _releaseProminence : _activationProminence;
+      if (peakProminence(maxIdx+1) >= threshold*firstProminence)
+	++activeSources;
+    }
   }
+  _activeSources = activeSources;
+}
+
+BaseType SteeringBeamforming::peakProminence(int peak) const
+{
+  BaseType height = _energyInDOA[peak];
+  BaseType leftMin = height, rightMin = height;
+  for (int i = peak - 1; i >= 0 && _energyInDOA[i] <= height; --i)
+    leftMin = std::min(leftMin, _energyInDOA[i]);
+  for (int i = peak + 1; i < _numSteps && _energyInDOA[i] <= height; ++i)
+    rightMin = std::min(rightMin, _energyInDOA[i]);
+
+  return height - std::max(leftMin, rightMin);
 }
 
 
@@ -0,0 +1,163 @@
+/*
+* TauMatrix.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/TauMatrix.h>
+#include <mcarray/mcarray_exception.h>
+#include <mcarray/KernelDispatch.h>
+
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+namespace mca {
+
+TauMatrix::TauMatrix(const BaseType *tau, int tauLength, int firstBin, int lastBin, int complexLength, Evaluation evaluation) :
+  _tauLength(tauLength),
+  _firstBin(std::max(0, firstBin)),
+  _lastBin(std::min(complexLength, lastBin)),
+  _nbins(std::max(0, _lastBin - _firstBin)),
+  _evaluation(evaluation),
+  _paddedLength((tauLength + _lanes - 1)/_lanes*_lanes)
+{
+  if (complexLength < 2)
+  {
+    std::ostringstream oss;
+    oss << "One-sided FFT length has to be at least 2: " << complexLength;
+    throw(MCArrayException(oss.str()));
+  }
+
+  _crossRe.reset(new BaseType[_nbins + 1]);
+  _crossIm.reset(new BaseType[_nbins + 1]);
+
+  // w_k = 2*pi*k/N, with N = 2*(complexLength-1) the length of the FFT.
+  double w0 = M_PI/(complexLength-1);
+
+  if (_evaluation == RECURRENCE)
+  {
+    // Padding delays do not rotate and their correlations are discarded.
+    _firstRe.reset(new BaseType[_paddedLength]);
+    _firstIm.reset(new BaseType[_paddedLength]);
+    _rotationRe.reset(new BaseType[_paddedLength]);
+    _rotationIm.reset(new BaseType[_paddedLength]);
+    for (int t = 0; t < _paddedLength; ++t)
+    {
+      double delay = (t < _tauLength) ? tau[t] : 0;
+      _firstRe[t] = cos(w0*_firstBin*delay);
+      _firstIm[t] = sin(w0*_firstBin*delay);
+      _rotationRe[t] = cos(w0*delay);
+      _rotationIm[t] = sin(w0*delay);
+    }
+    return;
+  }
+
+  _cos.reset(new BaseType[_tauLength*_nbins + 1]);
+  _sin.reset(new BaseType[_tauLength*_nbins + 1]);
+  for (int t = 0; t < _tauLength; ++t)
+    calculatePhaseTerms(tau[t], _firstBin, _nbins, complexLength, &_cos[t*_nbins], &_sin[t*_nbins]);
+}
+
+void TauMatrix::calculateCrossSpectrum(const BaseTypeC *left, const BaseTypeC *right)
+{
+  calculatePhatCrossSpectrum(left, right, _firstBin, _nbins, _crossRe.get(), _crossIm.get());
+}
+
+void TauMatrix::calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations)
+{
+  calculateCorrelations(left, right, correlations, 0, _tauLength);
+}
+
+void TauMatrix::calculateCorrelations(const BaseTypeC *left, const BaseTypeC *right, BaseType *correlations,
+				      int firstDelay, int lastDelay)
+{
+  firstDelay = std::max(0, firstDelay);
+  lastDelay = std::min(_tauLength, lastDelay);
+  calculateCrossSpectrum(left, right);
+
+  if (_evaluation == RECURRENCE)
+  {
+    calculateRecurrenceCorrelations(correlations, firstDelay, lastDelay);
+    return;
+  }
+
+  // Re{S*e^{jwt}} = S.re*cos(wt) - S.im*sin(wt)
+  const KernelDispatch::Kernels &kernels = KernelDispatch::get();
+  for (int t = firstDelay; t < lastDelay; ++t)
+  {
+    BaseType cosSum, sinSum;
+    kernels.splitCorrelation(_crossRe.get(), _crossIm.get(), &_cos[t*_nbins], &_sin[t*_nbins], _nbins, &cosSum, &sinSum);
+    correlations[t] = cosSum - sinSum;
+  }
+}
+
+void TauMatrix::calculateRecurrenceCorrelations(BaseType *correlations, int firstDelay, int lastDelay) const
+{
+  BaseType re[_lanes], im[_lanes], corr[_lanes];
+
+  // Whole groups of _lanes delays are evaluated, only the ones in the range are written.
+  for (int t0 = firstDelay/_lanes*_lanes; t0 < lastDelay; t0 += _lanes)
+  {
+    const BaseType *rotationRe = &_rotationRe[t0];
+    const BaseType *rotationIm = &_rotationIm[t0];
+    for (int l = 0; l < _lanes; ++l)
+    {
+      re[l] = _firstRe[t0 + l];
+      im[l] = _firstIm[t0 + l];
+      corr[l] = 0;
+    }
+
+    for (int k = 0; k < _nbins; ++k)
+    {
+      const BaseType sre = _crossRe[k];
+      const BaseType sim = _crossIm[k];
+      // Re{S*e^{jwt}} = S.re*cos(wt) - S.im*sin(wt), then rotate to the next bin.
+      for (int l = 0; l < _lanes; ++l)
+      {
+	corr[l] += sre*re[l] - sim*im[l];
+	BaseType rotated = re[l]*rotationRe[l] - im[l]*rotationIm[l];
+	im[l] = re[l]*rotationIm[l] + im[l]*rotationRe[l];
+	re[l] = rotated;
+      }
+
+      // Rounding errors of the products make the magnitude drift away from 1.
+      if ((k + 1) % _renormalisationPeriod == 0)
+      {
+	for (int l = 0; l < _lanes; ++l)
+	{
+	  BaseType gain = 1/sqrt(re[l]*re[l] + im[l]*im[l]);
+	  re[l] *= gain;
+	  im[l] *= gain;
+	}
+      }
+    }
+
+    for (int l = std::max(0, firstDelay - t0); l < _lanes && t0 + l < lastDelay; ++l)
+      correlations[t0 + l] = corr[l];
+  }
+}
+
+size_t TauMatrix::getTableSize() const
+{
+  if (_evaluation == RECURRENCE)
+    return 4*sizeof(BaseType)*_paddedLength;
+  return 2*sizeof(BaseType)*_tauLength*_nbins;
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+* WorkerPool.cpp
+* Copyright 2016 (c) Jordi Adell
+* Created on: 2015
+* 	Author: Jordi Adell - adellj@gmail.com
+*
+* This file is part of MCARRAY
+*
+* MCARRAY is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* MCARRAY is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with MCARRAY.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <mcarray/WorkerPool.h>
+#include <mcarray/mcarray_exception.h>
+
+#include <sstream>
+
+namespace mca {
+
+WorkerPool::WorkerPool(int nworkers) :
+  _job(0),
+  _generation(0),
+  _pending(0),
+  _stop(false)
+{
+  if (nworkers < 1)
+  {
+    std::ostringstream oss;
+    oss << "Number of workers has to be at least 1: " << nworkers;
+    throw(MCArrayException(oss.str()));
+  }
+
+  for (int worker = 1; worker < nworkers; ++worker)
+    _threads.push_back(std::thread(&WorkerPool::workerLoop, this, worker));
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _start.notify_all();
+
+  for (size_t i = 0; i < _threads.size(); ++i)
+    _threads[i].join();
+}
+
+void WorkerPool::run(const std::function<void(int)> &job)
+{
+  if (_threads.empty())
+  {
+    job(0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = &job;
+    _pending = _threads.size();
+    ++_generation;
+  }
+  _start.notify_all();
+
+  job(0);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this]{return _pending == 0;});
+  _job = 0;
+}
+
+void WorkerPool::workerLoop(int worker)
+{
+  unsigned long generation = 0;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    _start.wait(lock, [this, generation]{return _stop || _generation != generation;});
+    if (_stop)
+      return;
+
+    generation = _generation;
+    const std::function<void(int)> *job = _job;
+
+    lock.unlock();
+    (*job)(worker);
+    lock.lock();
+
+    if (--_pending == 0)
+      _done.notify_one();
+  }
+}
+
+}
@@ -24,6 +24,8 @@
 #include <wipp/wippsignal.h>
 #include <wipp/wippstats.h>
 
+#include <algorithm>
+
 namespace mca{
 
 
@@ -88,6 +90,17 @@ float maxFreqForSpatialAliasing(float microphoneDistance)
   return (getSpeedOfSound()/(2*microphoneDistance));
 }
 
+void getUsefulBand(float microphoneDistance, int sampleRate, int complexLength, int &firstBin, int &lastBin, float minFreq)
+{
+  // bin k is at k*sampleRate/N Hz, with N = 2*(complexLength-1) the length of the FFT.
+  double binsPerHz = 2.0*(complexLength-1)/sampleRate;
+  firstBin = std::min(std::max(0, static_cast<int>(ceil(minFreq*binsPerHz))), complexLength-1);
+  lastBin = complexLength;
+  if (microphoneDistance > 0)
+    lastBin = std::min(static_cast<double>(complexLength), floor(maxFreqForSpatialAliasing(microphoneDistance)*binsPerHz) + 1);
+  lastBin = std::max(lastBin, firstBin + 1);
+}
+
 SignalPtr toDegrees(SignalPtr radians, int length)
 {
   SignalPtr degrees;
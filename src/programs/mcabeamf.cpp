@@ -15,6 +15,7 @@
 #include <iostream>
 #include <fstream>
 #include <functional>
+#include <cstdlib>
 
 using namespace std::placeholders;
 
@@ -26,6 +27,7 @@ void usage(int argc, char *argv[])
   std::cout << "      -o file    Output file" << std::endl;
   std::cout << "      -a file    Array description [not implemented]" << std::endl;
   std::cout << "      -d file    Print DOA in file [use - for stdout]" << std::endl;
+  std::cout << "      -k frames  Localise every k frames, separate every frame [default 1]" << std::endl;
   std::cout << "      -h         This help message" << std::endl;
   std::cout << std::endl;
 }
@@ -127,10 +129,11 @@ int main(int argc, char *argv[])
 {
 
   int c;
-  const char shortopts[] = "i:o:a:d:gh";
+  const char shortopts[] = "i:o:a:d:k:gh";
   extern char *optarg;
   std::string input_file, output_file, array_description_file, doa_file;
   bool use_gui = false;
+  int localisation_period = 1;
 
   while ( (c = getopt(argc, argv, shortopts)) != -1)
   {
@@ -147,6 +150,9 @@ int main(int argc, char *argv[])
       case 'd':
 	doa_file = optarg;
       break;
+      case 'k':
+	localisation_period = atoi(optarg);
+      break;
       case 'g':
 	use_gui = true;
       break;
@@ -192,6 +198,7 @@ int main(int argc, char *argv[])
   int sampleRate = sf_info_in.samplerate;
   McBeamCallback callback(*os);
   mca::SourceSeparationAndLocalisation sss(sampleRate, array_description, 1, false);
+  sss.setLocalisationRate(mca::BeamformingSeparationAndLocalisation::LocalisationRate(localisation_period));
 
 
 #ifdef DSPONE_GUI
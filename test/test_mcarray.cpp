@@ -33,6 +33,22 @@
 #include <mcarray/FastBinauralMasking.h>
 #include <mcarray/microhponeArrayHelpers.h>
 #include <mcarray/ArrayDescription.h>
+#include <mcarray/TauMatrix.h>
+#include <mcarray/SteeredResponsePower.h>
+#include <mcarray/Beamformer.h>
+#include <mcarray/AdaptiveBeamformer.h>
+#include <mcarray/WorkerPool.h>
+#include <mcarray/SpectralFrontEnd.h>
+#include <mcarray/ProcessingGraph.h>
+#include <mcarray/NoiseFloorTracker.h>
+#include <mcarray/SilencePreGate.h>
+#include <mcarray/BinauralGCC.h>
+#include <mcarray/KernelDispatch.h>
+#include <mcarray/SplitSpectrum.h>
+#include <mcarray/GammatoneFilterBank.h>
+#include <mcarray/MaskStream.h>
+#include <mcarray/DecimatingFrontEnd.h>
+#include <mcarray/mcarray_exception.h>
 
 #include <dspone/algorithm/fft.h>
 #include <dspone/filter/BandPassFIRFilter.h>
@@ -80,6 +96,8 @@ void testLocalisationAndSeparationCore(std::string file, dsp::ShortTimeProcess *
 void assertLocalisationMessage(double doa, double prob, double power);
 void testLocalisationCore(std::string file, dsp::ShortTimeAnalysis *loc, std::vector<unsigned int> channels,
 			  int sampleRate, bool useAntiAliasingFilter);
+void makeTestSpectra(unsigned int nchannels, int analysisLength, SignalVector &spectrum, SignalVector &output,
+		     std::vector<double*> &spectrumPtrs, std::vector<double*> &outputPtrs);
 
 
 
@@ -228,6 +246,85 @@ class TestInteractiveLocalisationStatisticsCallback : public LocalisationCallbac
 };
 
 
+// Spectral stages used to check the order of the frames in block processing.
+class TestIndexConsumer : public SpectrumConsumer
+{
+  public:
+    std::vector<unsigned long> indices; /**< index of every frame consumed */
+    std::vector<BaseType> values; /**< first value of the first channel of every frame */
+
+    virtual void consumeSpectrum(const SpectralFrame &frame)
+    {
+      indices.push_back(frame.getIndex());
+      values.push_back(frame.getChannel(0)[0]);
+    }
+};
+
+class TestGainProcessor : public SpectrumProcessor
+{
+  public:
+    virtual void processSpectrum(const SpectralFrame &input, std::vector<double*> &outputFrames)
+    {
+      for (unsigned int c = 0; c < input.getNumberOfChannels(); ++c)
+	wipp::multC(2.0, input.getChannel(c), outputFrames[c], input.getAnalysisLength());
+    }
+};
+
+
+// Keeps every localisation result, to compare the results of two configurations.
+class TestRecordingLocalisationCallback : public LocalisationCallback
+{
+  public:
+    std::vector<double> doas; /**< first DOA of every call */
+    std::vector<double> probs; /**< first probability of every call */
+    std::vector<double> powers; /**< frame power of every call */
+
+    virtual void setDOA(SignalPtr doa, SignalPtr prob, double power, int numOfSources)
+    {
+      doas.push_back(doa[0]);
+      probs.push_back(prob[0]);
+      powers.push_back(power);
+    }
+};
+
+
+// Direction of a source for a pair, from the GCC-PHAT of Hann-windowed frames accumulated over
+// the whole signal and evaluated with TauMatrix on a 0.1 degree grid. The spectra are computed
+// with a plain DFT, the frames are short enough.
+double estimatePairDOA(const SignalVector &input, int length, int sampleRate, int frameLength, double microphoneDistance)
+{
+  const int complexLength = frameLength/2 + 1;
+  const int numSteps = 1801;
+  std::vector<BaseType> tau(numSteps), correlations(numSteps), accumulated(numSteps, 0);
+  for (int i = 0; i < numSteps; ++i)
+    tau[i] = doaToDelayFarFieldSamples(toRadians(0.1*(i - numSteps/2)), microphoneDistance, sampleRate);
+  TauMatrix tauMatrix(tau.data(), numSteps, 1, complexLength - 1, complexLength);
+
+  std::vector<BaseTypeC> left(complexLength), right(complexLength);
+  for (int offset = 0; offset + frameLength <= length; offset += frameLength/2)
+  {
+    for (int k = 0; k < complexLength; ++k)
+    {
+      left[k].re = left[k].im = right[k].re = right[k].im = 0;
+      for (int n = 0; n < frameLength; ++n)
+      {
+	double window = 0.5 - 0.5*cos(2*M_PI*n/frameLength);
+	double phase = -2*M_PI*k*n/frameLength;
+	left[k].re += window*input[0][offset + n]*cos(phase);
+	left[k].im += window*input[0][offset + n]*sin(phase);
+	right[k].re += window*input[1][offset + n]*cos(phase);
+	right[k].im += window*input[1][offset + n]*sin(phase);
+      }
+    }
+    tauMatrix.calculateCorrelations(left.data(), right.data(), correlations.data());
+    for (int i = 0; i < numSteps; ++i)
+      accumulated[i] += correlations[i];
+  }
+  int best = std::max_element(accumulated.begin(), accumulated.end()) - accumulated.begin();
+  return 0.1*(best - numSteps/2);
+}
+
+
 //actual test functions.
 
 TEST(MicrophoneArrayTest, testTemporalMasking)
@@ -256,6 +353,11 @@ TEST(MicrophoneArrayTest, testSpatialMasking)
   {
     testSpatialMaskingCore(&masking);
   }
+
+  BinauralMaskingImpl gammatoneMasking(16000, 0.086, 500, 5000, BinauralMaskingImpl::FULL, BinauralMaskingImpl::GAMMATONE_IIR);
+  {
+    testSpatialMaskingCore(&gammatoneMasking);
+  }
   //::testing::UnitTest::elapsed_time()
 }
 
@@ -515,6 +617,1515 @@ TEST(MicrophoneArrayTest, testInteractiveLocalisation)
 }
 
 
+TEST(MicrophoneArrayTest, testTauMatrix)
+{
+  const int complexLength = 513;
+  const int numSteps = 21;
+  const double delay = 3.0; // left channel delayed by 3 samples
+  const double w0 = M_PI/(complexLength-1);
+
+  BaseType tau[numSteps];
+  for (int t = 0; t < numSteps; ++t)
+    tau[t] = t - numSteps/2;
+
+  BaseTypeC left[complexLength];
+  BaseTypeC right[complexLength];
+  for (int k = 0; k < complexLength; ++k)
+  {
+    double magnitude = 1 + k % 7;
+    right[k].re = magnitude;
+    right[k].im = 0;
+    left[k].re = magnitude*cos(w0*k*delay);
+    left[k].im = -magnitude*sin(w0*k*delay);
+  }
+
+  BaseType correlations[numSteps];
+  BaseType max;
+  size_t idx;
+
+  // Full band
+  TauMatrix full(tau, numSteps, 0, complexLength, complexLength);
+  full.calculateCorrelations(left, right, correlations);
+  wipp::maxidx(correlations, numSteps, &max, &idx);
+  EXPECT_DOUBLE_EQ(tau[idx], delay);
+  EXPECT_NEAR(max, complexLength, 1e-6);
+
+  // Band limited, only the bins in the band contribute.
+  TauMatrix band(tau, numSteps, 40, 120, complexLength);
+  band.calculateCorrelations(left, right, correlations);
+  wipp::maxidx(correlations, numSteps, &max, &idx);
+  EXPECT_DOUBLE_EQ(tau[idx], delay);
+  EXPECT_NEAR(max, 80, 1e-6);
+}
+
+
+TEST(MicrophoneArrayTest, testSteeredResponsePower)
+{
+  const int complexLength = 257;
+  const int nchannels = 4;
+  const int numSteps = 37;
+  const int source = 25;
+  const double w0 = M_PI/(complexLength-1);
+
+  // Delays of a linear array with 4 cm between microphones, in samples at 16 kHz.
+  SignalVector delays;
+  for (int c = 0; c < nchannels; ++c)
+  {
+    delays.push_back(SignalPtr(new BaseType[numSteps]));
+    for (int t = 0; t < numSteps; ++t)
+      delays[c][t] = -doaToDelayFarFieldSamples(doaIdx2angle(t, M_PI/(numSteps-1)), 0.04*c, 16000);
+  }
+
+  // Channel c receives the source delayed D_c samples.
+  SignalVector frames;
+  for (int c = 0; c < nchannels; ++c)
+  {
+    frames.push_back(SignalPtr(new BaseType[2*complexLength]));
+    BaseTypeC *x = reinterpret_cast<BaseTypeC*>(frames[c].get());
+    for (int k = 0; k < complexLength; ++k)
+    {
+      double magnitude = 1 + (k*(c+3)) % 5;
+      double phase = 0.3*k*k - w0*k*delays[c][source];
+      x[k].re = magnitude*cos(phase);
+      x[k].im = magnitude*sin(phase);
+    }
+  }
+
+  BaseType response[numSteps];
+  SteeredResponsePower srp(delays, numSteps, complexLength);
+  srp.calculateResponse(frames, response);
+
+  // Same as the sum of the GCC-PHAT of all pairs.
+  BaseType expected[numSteps] = {0};
+  BaseType correlations[numSteps];
+  BaseType tau[numSteps];
+  for (int i = 0; i < nchannels; ++i)
+  {
+    for (int j = i + 1; j < nchannels; ++j)
+    {
+      for (int t = 0; t < numSteps; ++t)
+	tau[t] = delays[i][t] - delays[j][t];
+      TauMatrix pair(tau, numSteps, 0, complexLength, complexLength);
+      pair.calculateCorrelations(reinterpret_cast<BaseTypeC*>(frames[i].get()),
+				 reinterpret_cast<BaseTypeC*>(frames[j].get()), correlations);
+      for (int t = 0; t < numSteps; ++t)
+	expected[t] += correlations[t];
+    }
+  }
+
+  for (int t = 0; t < numSteps; ++t)
+    EXPECT_NEAR(response[t], expected[t], 1e-6);
+
+  BaseType max;
+  size_t idx;
+  wipp::maxidx(response, numSteps, &max, &idx);
+  EXPECT_EQ(idx, source);
+  EXPECT_NEAR(max, 6*complexLength, 1e-6);
+}
+
+TEST(MicrophoneArrayTest, testWorkerPool)
+{
+  const int nworkers = 4;
+  const int length = 1000;
+  WorkerPool pool(nworkers);
+  EXPECT_EQ(pool.size(), nworkers);
+
+  std::vector<int> visits(length, 0);
+  std::vector<double> partials(nworkers, 0);
+
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    pool.run([&](int worker) {
+      for (int i = worker; i < length; i += nworkers)
+      {
+	++visits[i];
+	partials[worker] += i;
+      }
+    });
+  }
+
+  double total = 0;
+  for (int worker = 0; worker < nworkers; ++worker)
+    total += partials[worker];
+
+  for (int i = 0; i < length; ++i)
+    EXPECT_EQ(visits[i], 10);
+  EXPECT_DOUBLE_EQ(total, 10*length*(length-1)/2.0);
+
+  EXPECT_THROW(WorkerPool(0), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testSpectralFrontEnd)
+{
+  const int sampleRate = 16000;
+  const float frameRate = 0.025;
+  FastBinauralMasking masking(sampleRate, 0.15, 200, 4000, BinauralMasking::RELATIVE,
+			      BinauralMasking::BOTH, frameRate);
+  const int analysisLength = masking.getAnalysisLength();
+
+  SignalVector spectrum, output;
+  std::vector<double*> spectrumPtrs, outputPtrs;
+  makeTestSpectra(2, analysisLength, spectrum, output, spectrumPtrs, outputPtrs);
+
+  SpectralFrame frame(spectrumPtrs, analysisLength, 7);
+  EXPECT_EQ(frame.getNumberOfChannels(), 2u);
+  EXPECT_EQ(frame.getAnalysisLength(), analysisLength);
+  EXPECT_EQ(frame.getIndex(), 7u);
+  EXPECT_EQ(frame.getChannel(1), spectrumPtrs[1]);
+  EXPECT_NO_THROW(frame.checkCompatibility(2, analysisLength));
+  EXPECT_THROW(frame.checkCompatibility(3, analysisLength), MCArrayException);
+  EXPECT_THROW(frame.checkCompatibility(2, analysisLength + 2), MCArrayException);
+
+  EXPECT_NO_THROW(masking.processSpectrum(frame, outputPtrs));
+
+  // A module created with a different frame rate cannot process the frame.
+  FastBinauralMasking defaultMasking(sampleRate, 0.15, 200, 4000);
+  EXPECT_THROW(defaultMasking.processSpectrum(frame, outputPtrs), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testProcessingGraph)
+{
+  const int sampleRate = 16000;
+  const int length = 4096;
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.15});
+
+  FastBinauralMasking first(sampleRate, 0.15, 200, 4000), second(sampleRate, 0.15, 200, 4000);
+  FastBinauralMasking firstRef(sampleRate, 0.15, 200, 4000), secondRef(sampleRate, 0.15, 200, 4000);
+  FreqGCCBinauralLocalisation localisation(sampleRate, positions, false);
+
+  ProcessingGraph graph(2, length);
+  int firstNode = graph.addProcessor(&first);
+  graph.addProcessor(&second);
+  int locNode = graph.addAnalyser(&localisation, firstNode);
+  graph.build();
+
+  EXPECT_EQ(graph.getMaxLatency(), first.getMaxLatency() + second.getMaxLatency());
+  EXPECT_EQ(graph.getLatency(locNode), first.getMaxLatency());
+  EXPECT_EQ(graph.getNumberOfBuffers(), 1u);
+  EXPECT_THROW(graph.addProcessor(&first), MCArrayException);
+
+  const int outLength = graph.getMaxOutputLength();
+  SignalVector input, output, intermediate, reference;
+  std::vector<double*> inputPtrs, outputPtrs, intermediatePtrs, referencePtrs;
+  for (int c = 0; c < 2; ++c)
+  {
+    input.push_back(SignalPtr(new BaseType[length]));
+    output.push_back(SignalPtr(new BaseType[outLength]));
+    intermediate.push_back(SignalPtr(new BaseType[outLength]));
+    reference.push_back(SignalPtr(new BaseType[outLength]));
+    inputPtrs.push_back(input.back().get());
+    outputPtrs.push_back(output.back().get());
+    intermediatePtrs.push_back(intermediate.back().get());
+    referencePtrs.push_back(reference.back().get());
+  }
+
+  for (int block = 0; block < 4; ++block)
+  {
+    for (int i = 0; i < length; ++i)
+    {
+      input[0][i] = 1000*sin(0.05*(i + block*length)) + (rand()%100);
+      input[1][i] = 1000*sin(0.05*(i + block*length + 3)) + (rand()%100);
+    }
+
+    int produced = graph.process(inputPtrs, length, outputPtrs, outLength);
+    int intermediateLength = firstRef.process(inputPtrs, length, intermediatePtrs, outLength);
+    int expected = secondRef.process(intermediatePtrs, intermediateLength, referencePtrs, outLength);
+
+    ASSERT_EQ(produced, expected);
+    for (int c = 0; c < 2; ++c)
+      for (int i = 0; i < produced; ++i)
+	EXPECT_DOUBLE_EQ(output[c][i], reference[c][i]);
+  }
+}
+
+TEST(MicrophoneArrayTest, testRuntimeConfiguration)
+{
+  const int sampleRate = 16000;
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.15});
+
+  FastBinauralMasking::Config shortFrames;
+  shortFrames.fftOrder = 9;
+  shortFrames.nBins = 20;
+  FastBinauralMasking::Config longFrames(0.1);
+  longFrames.fftOrder = 10;
+
+  FastBinauralMasking shortMasking(sampleRate, 0.15, 200, 4000, shortFrames);
+  FastBinauralMasking longMasking(sampleRate, 0.15, 200, 4000, longFrames);
+  EXPECT_EQ(shortMasking.getNumberOfBins(), 20);
+  EXPECT_EQ(longMasking.getNumberOfBins(), 45);
+  EXPECT_EQ(longMasking.getAnalysisLength() - 2, 2*(shortMasking.getAnalysisLength() - 2));
+
+  FastBinauralMasking::Config noBins;
+  noBins.nBins = 0;
+  EXPECT_THROW(FastBinauralMasking(sampleRate, 0.15, 200, 4000, noBins), MCArrayException);
+
+  FreqGCCBinauralLocalisation::Config coarseGrid;
+  coarseGrid.fftOrder = 9;
+  coarseGrid.doaStep = 10*M_PI/180;
+  FreqGCCBinauralLocalisation coarse(sampleRate, positions, coarseGrid, false);
+  EXPECT_EQ(coarse.getAnalysisLength(), shortMasking.getAnalysisLength());
+
+  FreqGCCBinauralLocalisation::Config noGrid;
+  noGrid.doaStep = 0;
+  EXPECT_THROW(FreqGCCBinauralLocalisation(sampleRate, positions, noGrid), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testNoiseFloorTracker)
+{
+  const int windowLength = 10;
+  const double margin = 3;
+  NoiseFloorTracker tracker(windowLength, margin);
+
+  // No decision until the first window is complete.
+  for (int frame = 0; frame < windowLength - 1; ++frame)
+    EXPECT_FALSE(tracker.update(70));
+  EXPECT_FALSE(tracker.isEstimated());
+
+  for (int frame = 0; frame < 4*windowLength; ++frame)
+    EXPECT_FALSE(tracker.update(40));
+  EXPECT_TRUE(tracker.isEstimated());
+  EXPECT_NEAR(tracker.getFloor(), 40 + margin, 0.1);
+  EXPECT_TRUE(tracker.update(60));
+
+  // The floor follows an increase of the background noise after one window...
+  for (int frame = 0; frame < 2*windowLength; ++frame)
+    tracker.update(55);
+  EXPECT_NEAR(tracker.getFloor(), 55 + margin, 0.1);
+  EXPECT_FALSE(tracker.update(57));
+
+  // ...and a decrease as soon as the smoothed power goes down.
+  for (int frame = 0; frame < 3*windowLength; ++frame)
+    tracker.update(30);
+  EXPECT_LT(tracker.getFloor(), 31 + margin);
+
+  tracker.reset();
+  EXPECT_FALSE(tracker.isEstimated());
+  EXPECT_EQ(NoiseFloorTracker::getWindowLength(3, 0.025), 120);
+  EXPECT_THROW(NoiseFloorTracker(0, margin), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testSilencePreGate)
+{
+  const int frameLength = 256;
+  const double offset = 5; // spectral power minus time-domain power
+  BaseType loud[frameLength], quiet[frameLength];
+  wipp::set(100.0, loud, frameLength); // 40 dB
+  wipp::set(1.0, quiet, frameLength);  // 0 dB
+
+  NoiseFloorTracker floor(5, 3);
+  for (int frame = 0; frame < 10; ++frame)
+    floor.update(30 + offset);
+  ASSERT_TRUE(floor.isEstimated());
+
+  SilencePreGate gate(2, frameLength);
+  EXPECT_FALSE(gate.hasFrame());
+  gate.storeFrame(quiet, frameLength, 0);
+  EXPECT_FALSE(gate.hasFrame());
+  gate.storeFrame(quiet, frameLength, 1);
+  EXPECT_TRUE(gate.hasFrame());
+  EXPECT_EQ(gate.getFrame(1)[frameLength-1], 1.0);
+
+  // Nothing is gated until the offset to the spectral power is learned.
+  EXPECT_FALSE(gate.isSilent(floor));
+
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    gate.clear();
+    gate.storeFrame(loud, frameLength, 0);
+    gate.storeFrame(loud, frameLength, 1);
+    EXPECT_FALSE(gate.isSilent(floor));
+    gate.calibrate(40 + offset);
+  }
+
+  gate.clear();
+  gate.storeFrame(quiet, frameLength, 0);
+  gate.storeFrame(quiet, frameLength, 1);
+  EXPECT_NEAR(gate.getEstimatedPower(), offset, 1e-6);
+  EXPECT_TRUE(gate.isSilent(floor));
+
+  EXPECT_THROW(gate.storeFrame(quiet, frameLength, 2), MCArrayException);
+  EXPECT_THROW(gate.storeFrame(quiet, frameLength + 1, 0), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testBinauralGCC)
+{
+  const int complexLength = 513;
+  const int numSteps = 61;
+
+  BaseTypeC left[complexLength];
+  BaseTypeC right[complexLength];
+  srand(36);
+  for (int k = 0; k < complexLength; ++k)
+  {
+    left[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    left[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  }
+
+  // Symmetric delays of a DOA grid and a shifted (non symmetric) grid.
+  BaseType symmetric[numSteps], shifted[numSteps];
+  for (int t = 0; t < numSteps; ++t)
+  {
+    symmetric[t] = doaToDelayFarFieldSamples(doaIdx2angle(t, M_PI/(numSteps-1)), 0.15, 16000);
+    shifted[t] = 0.37*t - 4;
+  }
+
+  BaseType expected[numSteps], correlations[numSteps];
+  for (BaseType *tau : {symmetric, shifted})
+  {
+    TauMatrix reference(tau, numSteps, 0, complexLength, complexLength);
+    BinauralGCC gcc(tau, numSteps, 0, complexLength, complexLength);
+    EXPECT_EQ(gcc.isSymmetric(), tau == symmetric);
+
+    reference.calculateCorrelations(left, right, expected);
+    gcc.calculateCorrelations(left, right, correlations);
+    for (int t = 0; t < numSteps; ++t)
+      EXPECT_NEAR(correlations[t], expected[t], 1e-4);
+  }
+
+  // Half of the rows stored in float instead of all of them in complex double.
+  BinauralGCC gcc(symmetric, numSteps, 0, complexLength, complexLength);
+  EXPECT_LT(gcc.getTableSize(), numSteps*complexLength*sizeof(BaseTypeC)/3);
+}
+
+TEST(MicrophoneArrayTest, testTauMatrixRecurrence)
+{
+  const int complexLength = 1025;
+  const int numSteps = 37;
+
+  BaseTypeC left[complexLength];
+  BaseTypeC right[complexLength];
+  srand(37);
+  for (int k = 0; k < complexLength; ++k)
+  {
+    left[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    left[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  }
+
+  BaseType tau[numSteps];
+  for (int t = 0; t < numSteps; ++t)
+    tau[t] = doaToDelayFarFieldSamples(doaIdx2angle(t, M_PI/(numSteps-1)), 0.3, 48000);
+
+  BaseType expected[numSteps], correlations[numSteps];
+  for (int firstBin : {0, 37})
+  {
+    TauMatrix table(tau, numSteps, firstBin, complexLength, complexLength, TauMatrix::TABLE);
+    TauMatrix recurrence(tau, numSteps, firstBin, complexLength, complexLength, TauMatrix::RECURRENCE);
+    EXPECT_EQ(recurrence.getEvaluation(), TauMatrix::RECURRENCE);
+
+    table.calculateCorrelations(left, right, expected);
+    recurrence.calculateCorrelations(left, right, correlations);
+    for (int t = 0; t < numSteps; ++t)
+      EXPECT_NEAR(correlations[t], expected[t], 1e-9);
+
+    // Only a few phasors per delay, independently of the number of bins.
+    EXPECT_LE(recurrence.getTableSize(), 4*sizeof(BaseType)*(numSteps + 8));
+  }
+}
+
+TEST(MicrophoneArrayTest, testKernelDispatch)
+{
+  EXPECT_EQ(KernelDispatch::parseInstructionSet("AVX2"), KernelDispatch::AVX2);
+  EXPECT_EQ(KernelDispatch::parseInstructionSet(KernelDispatch::getName(KernelDispatch::SSE4)), KernelDispatch::SSE4);
+  EXPECT_THROW(KernelDispatch::parseInstructionSet("neon"), MCArrayException);
+  EXPECT_LE(KernelDispatch::get().instructionSet, KernelDispatch::getSupportedInstructionSet());
+
+  const int length = 203; // not a multiple of the lanes
+  BaseType x[length], filter[length];
+  BaseTypeC a[length], b[length];
+  BaseType32 re[length], im[length], cosine[length], sine[length];
+  srand(38);
+  for (int k = 0; k < length; ++k)
+  {
+    x[k] = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    filter[k] = rand()/static_cast<double>(RAND_MAX);
+    a[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    a[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    b[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    b[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    re[k] = a[k].re;
+    im[k] = a[k].im;
+    cosine[k] = b[k].re;
+    sine[k] = b[k].im;
+  }
+  SplitSpectrum split(2, length);
+  split.deinterleave(a, 0);
+  split.deinterleave(b, 1);
+
+  // Plain sums as reference.
+  BaseType energy = 0, filteredEnergy = 0;
+  BaseTypeC dot = {0, 0};
+  for (int k = 0; k < length; ++k)
+  {
+    energy += x[k]*x[k];
+    filteredEnergy += filter[k]*filter[k]*(a[k].re*a[k].re + a[k].im*a[k].im + b[k].re*b[k].re + b[k].im*b[k].im);
+    dot.re += a[k].re*b[k].re - a[k].im*b[k].im;
+    dot.im += a[k].re*b[k].im + a[k].im*b[k].re;
+  }
+
+  // Every variant the CPU supports gives the same results.
+  for (int set = KernelDispatch::SCALAR; set <= KernelDispatch::getSupportedInstructionSet(); ++set)
+  {
+    const KernelDispatch::Kernels &kernels = KernelDispatch::get(static_cast<KernelDispatch::InstructionSet>(set));
+    EXPECT_EQ(kernels.instructionSet, set);
+
+    EXPECT_NEAR(kernels.energy(x, length), energy, 1e-10);
+    EXPECT_NEAR(kernels.filteredEnergy(a, b, filter, length), filteredEnergy, 1e-10);
+
+    BaseType cosSum, sinSum;
+    kernels.splitCorrelation(split.getReal(0), split.getImag(0), split.getReal(1), split.getImag(1), length, &cosSum, &sinSum);
+    EXPECT_NEAR(cosSum - sinSum, dot.re, 1e-10);
+    BaseType32 cosSum32, sinSum32;
+    kernels.splitCorrelation32(re, im, cosine, sine, length, &cosSum32, &sinSum32);
+    EXPECT_NEAR(cosSum32 - sinSum32, dot.re, 1e-4);
+
+    // Accumulated twice over zeros, every element is twice the product.
+    BaseType yRe[length], yIm[length];
+    wipp::setZeros(yRe, length);
+    wipp::setZeros(yIm, length);
+    for (int i = 0; i < 2; ++i)
+      kernels.splitMultiplyAccumulate(split.getReal(0), split.getImag(0), split.getReal(1), split.getImag(1), length, yRe, yIm);
+    for (int k = 0; k < length; ++k)
+    {
+      EXPECT_NEAR(yRe[k], 2*(a[k].re*b[k].re - a[k].im*b[k].im), 1e-12);
+      EXPECT_NEAR(yIm[k], 2*(a[k].re*b[k].im + a[k].im*b[k].re), 1e-12);
+    }
+
+    // Scaled by the first element of a, on top of the previous result.
+    kernels.splitScaleAccumulate(a[0].re, a[0].im, split.getReal(1), split.getImag(1), length, yRe, yIm);
+    for (int k = 0; k < length; ++k)
+    {
+      EXPECT_NEAR(yRe[k], 2*(a[k].re*b[k].re - a[k].im*b[k].im) + a[0].re*b[k].re - a[0].im*b[k].im, 1e-12);
+      EXPECT_NEAR(yIm[k], 2*(a[k].re*b[k].im + a[k].im*b[k].re) + a[0].re*b[k].im + a[0].im*b[k].re, 1e-12);
+    }
+
+    // Impulse response of two resonators, h[n] = inputGain*gain*(n+1)*pole^n, on 2 channels of nbands lanes.
+    const int nbands = 11;
+    BaseType poleRe[nbands], poleIm[nbands], inputGainRe[nbands], inputGainIm[nbands], gain[nbands];
+    BaseType stateRe[2*2*nbands], stateIm[2*2*nbands], bands[2*nbands];
+    for (int l = 0; l < nbands; ++l)
+    {
+      poleRe[l] = 0.9*cos(0.1*l);
+      poleIm[l] = 0.9*sin(0.1*l);
+      inputGainRe[l] = 0.2*cos(0.3*l);
+      inputGainIm[l] = 0.2*sin(0.3*l);
+      gain[l] = 0.1;
+    }
+    wipp::setZeros(stateRe, 2*2*nbands);
+    wipp::setZeros(stateIm, 2*2*nbands);
+    for (int n = 0; n < 20; ++n)
+    {
+      BaseType input[2] = {(n == 0) ? 1.0 : 0.0, (n == 0) ? -1.0 : 0.0};
+      kernels.resonatorCascade(input, 2, nbands, 2, poleRe, poleIm, inputGainRe, inputGainIm, gain, stateRe, stateIm, bands);
+      for (int l = 0; l < nbands; ++l)
+      {
+	BaseType response = 2*0.2*0.1*(n + 1)*pow(0.9, n)*cos(0.3*l + 0.1*l*n);
+	EXPECT_NEAR(bands[l], response, 1e-12);
+	EXPECT_NEAR(bands[nbands + l], -response, 1e-12);
+      }
+    }
+  }
+
+  if (KernelDispatch::getSupportedInstructionSet() < KernelDispatch::AVX512)
+  {
+    EXPECT_THROW(KernelDispatch::get(KernelDispatch::AVX512), MCArrayException);
+  }
+}
+
+TEST(MicrophoneArrayTest, testSplitSpectrum)
+{
+  const int length = 9;
+  BaseTypeC spectrum[length], back[length];
+  for (int k = 0; k < length; ++k)
+  {
+    spectrum[k].re = k;
+    spectrum[k].im = -2*k;
+  }
+
+  SplitSpectrum split(3, length);
+  EXPECT_EQ(split.getNumberOfChannels(), 3u);
+  EXPECT_EQ(split.getLength(), length);
+  EXPECT_EQ(split.getReal(2)[length-1], 0);
+
+  split.deinterleave(spectrum, 1);
+  EXPECT_EQ(split.getReal(1)[4], 4);
+  EXPECT_EQ(split.getImag(1)[4], -8);
+  EXPECT_EQ(split.getReal(0)[4], 0);
+
+  split.interleave(1, back);
+  for (int k = 0; k < length; ++k)
+  {
+    EXPECT_EQ(back[k].re, spectrum[k].re);
+    EXPECT_EQ(back[k].im, spectrum[k].im);
+  }
+
+  split.setZeros(1);
+  EXPECT_EQ(split.getImag(1)[4], 0);
+}
+
+TEST(MicrophoneArrayTest, testSpectralBlock)
+{
+  const int nframes = 5;
+  const int analysisLength = 10;
+
+  SignalVector blocks;
+  std::vector<double*> blockPtrs;
+  for (int c = 0; c < 2; ++c)
+  {
+    blocks.push_back(SignalPtr(new BaseType[nframes*analysisLength]));
+    blockPtrs.push_back(blocks.back().get());
+    for (int i = 0; i < nframes*analysisLength; ++i)
+      blocks[c][i] = i/analysisLength; // every value is the frame number
+  }
+
+  SpectralBlock block(blockPtrs, analysisLength, nframes, 20);
+  EXPECT_EQ(block.getNumberOfFrames(), nframes);
+  EXPECT_EQ(block.getChannel(3, 1), &blocks[1][3*analysisLength]);
+  EXPECT_EQ(block.getFrame(2).getIndex(), 22u);
+  EXPECT_EQ(block.getFrame(4).getChannel(0), &blocks[0][4*analysisLength]);
+  EXPECT_THROW(block.checkCompatibility(2, analysisLength + 2), MCArrayException);
+
+  // By default, frames are passed one by one and in order.
+  TestIndexConsumer consumer;
+  consumer.consumeSpectra(block);
+  ASSERT_EQ(consumer.indices.size(), static_cast<size_t>(nframes));
+  for (int f = 0; f < nframes; ++f)
+  {
+    EXPECT_EQ(consumer.indices[f], 20u + f);
+    EXPECT_EQ(consumer.values[f], f);
+  }
+
+  // The front end runs every stage over the whole block, frames are numbered after the ones already processed.
+  const int sampleRate = 16000;
+  const float frameRate = 0.025;
+  SpectralFrontEnd frontEnd(sampleRate, 2, frameRate);
+  const int frontEndLength = frontEnd.getAnalysisLength();
+  TestIndexConsumer before, after;
+  TestGainProcessor gain;
+  frontEnd.addConsumer(&before);
+  frontEnd.addProcessor(&gain);
+  frontEnd.addConsumer(&after);
+
+  SignalVector spectra, output;
+  std::vector<double*> spectraPtrs, outputPtrs;
+  for (int c = 0; c < 2; ++c)
+  {
+    spectra.push_back(SignalPtr(new BaseType[nframes*frontEndLength]));
+    output.push_back(SignalPtr(new BaseType[nframes*frontEndLength]));
+    spectraPtrs.push_back(spectra.back().get());
+    outputPtrs.push_back(output.back().get());
+    wipp::set(1.0, spectra.back().get(), nframes*frontEndLength);
+  }
+  frontEnd.processSpectra(spectraPtrs, nframes, outputPtrs);
+  frontEnd.processSpectra(spectraPtrs, 2, spectraPtrs);
+
+  ASSERT_EQ(before.indices.size(), static_cast<size_t>(nframes + 2));
+  ASSERT_EQ(after.indices.size(), static_cast<size_t>(nframes + 2));
+  EXPECT_EQ(after.indices.back(), static_cast<unsigned long>(nframes + 1));
+  EXPECT_EQ(before.values[0], 1);
+  EXPECT_EQ(after.values[0], 2);
+  EXPECT_EQ(output[1][nframes*frontEndLength - 1], 2);
+  EXPECT_EQ(spectra[0][frontEndLength], 2);
+  EXPECT_EQ(spectra[0][2*frontEndLength], 1);
+
+  // Correlations of a batch of frames are the ones of each frame.
+  const int complexLength = 257;
+  const int numSteps = 31;
+  BaseType tau[numSteps];
+  for (int t = 0; t < numSteps; ++t)
+    tau[t] = doaToDelayFarFieldSamples(doaIdx2angle(t, M_PI/(numSteps-1)), 0.15, 16000);
+  BinauralGCC gcc(tau, numSteps, 0, complexLength, complexLength);
+
+  SignalCPtr left(new BaseTypeC[nframes*complexLength]), right(new BaseTypeC[nframes*complexLength]);
+  srand(40);
+  for (int i = 0; i < nframes*complexLength; ++i)
+  {
+    left[i].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    left[i].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[i].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[i].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  }
+  const BaseTypeC *leftFrames[nframes], *rightFrames[nframes];
+  for (int f = 0; f < nframes; ++f)
+  {
+    leftFrames[f] = &left[f*complexLength];
+    rightFrames[f] = &right[f*complexLength];
+  }
+
+  BaseType batch[nframes*numSteps], single[numSteps];
+  gcc.calculateCorrelations(leftFrames, rightFrames, nframes, batch);
+  for (int f = 0; f < nframes; ++f)
+  {
+    gcc.calculateCorrelations(leftFrames[f], rightFrames[f], single);
+    for (int t = 0; t < numSteps; ++t)
+      EXPECT_DOUBLE_EQ(batch[f*numSteps + t], single[t]);
+  }
+}
+
+TEST(MicrophoneArrayTest, testMaskingSpectralGain)
+{
+  const int sampleRate = 16000;
+  FastBinauralMasking masking(sampleRate, 0.15, 200, 4000, BinauralMasking::FACTOR);
+  const int analysisLength = masking.getAnalysisLength();
+  const int complexLength = analysisLength/2;
+
+  SignalVector spectrum, output;
+  std::vector<double*> spectrumPtrs, outputPtrs;
+  makeTestSpectra(2, analysisLength, spectrum, output, spectrumPtrs, outputPtrs);
+
+  // Identical channels come from the front and the first frame is above its short-time power,
+  // so no band is masked.
+  SpectralFrame frame(spectrumPtrs, analysisLength, 0);
+  masking.processSpectrum(frame, outputPtrs);
+
+  // The masked bands are applied as one real gain per FFT bin: the phase of every bin is kept
+  // and both channels get the same gain.
+  const BaseTypeC *input = reinterpret_cast<const BaseTypeC*>(spectrum[0].get());
+  for (int c = 0; c < 2; ++c)
+  {
+    const BaseTypeC *masked = reinterpret_cast<const BaseTypeC*>(output[c].get());
+    for (int k = 0; k < complexLength; ++k)
+    {
+      EXPECT_NEAR(masked[k].im*input[k].re - masked[k].re*input[k].im, 0, 1e-9);
+      EXPECT_DOUBLE_EQ(masked[k].re, output[0][2*k]);
+      EXPECT_DOUBLE_EQ(masked[k].im, output[0][2*k + 1]);
+    }
+    // The filter bank does not reach the DC bin.
+    EXPECT_NEAR(masked[0].re, 0, 1e-12);
+  }
+}
+
+TEST(MicrophoneArrayTest, testGammatoneFilterBank)
+{
+  const int sampleRate = 16000;
+  const int nbands = 45;
+  const int length = 1600;
+  GammatoneFilterBank bank(sampleRate, nbands, 200, 4000);
+  EXPECT_EQ(bank.getNumberOfBands(), nbands);
+  EXPECT_NEAR(bank.getCenterFrequency(0), 200, 1e-6);
+  EXPECT_NEAR(bank.getCenterFrequency(nbands - 1), 4000, 1e-6);
+  for (int b = 1; b < nbands; ++b)
+    EXPECT_GT(bank.getCenterFrequency(b), bank.getCenterFrequency(b - 1));
+
+  // The bands are never stored, the state is far smaller than a frame per band and channel.
+  EXPECT_LT(bank.getStateSize(), sizeof(BaseType)*2*length*nbands/10);
+
+  BaseType tone[length], noise[length], output[length], inPlace[length];
+  BaseType leftEnergy[nbands], rightEnergy[nbands], crossEnergy[nbands], gains[nbands];
+  for (int n = 0; n < length; ++n)
+  {
+    tone[n] = sin(2*M_PI*1000*n/sampleRate);
+    noise[n] = sin(2*M_PI*5000*n/sampleRate);
+  }
+
+  // The tone falls in the band closest to it, and identical channels are fully correlated.
+  bank.analyse(tone, tone, length, leftEnergy, rightEnergy, crossEnergy);
+  int loudest = std::max_element(leftEnergy, leftEnergy + nbands) - leftEnergy;
+  EXPECT_LT(fabs(bank.getCenterFrequency(loudest) - 1000), 50);
+  for (int b = 0; b < nbands; ++b)
+  {
+    EXPECT_DOUBLE_EQ(leftEnergy[b], rightEnergy[b]);
+    EXPECT_DOUBLE_EQ(leftEnergy[b], crossEnergy[b]);
+  }
+
+  // With unit gains the bands add up to the input in the pass band, and remove what is out of it.
+  std::fill(gains, gains + nbands, 1);
+  bank.reset();
+  bank.synthesise(tone, gains, length, output);
+  BaseType inputPower = 0, outputPower = 0;
+  for (int n = length/2; n < length; ++n)
+  {
+    inputPower += tone[n - bank.getDelay()]*tone[n - bank.getDelay()];
+    outputPower += output[n]*output[n];
+  }
+  EXPECT_LT(fabs(10*log10(outputPower/inputPower)), 3);
+  BaseType residual = 0;
+  for (int n = length/2; n < length; ++n)
+    residual += (output[n] - tone[n - bank.getDelay()])*(output[n] - tone[n - bank.getDelay()]);
+  EXPECT_LT(residual, inputPower);
+
+  bank.reset();
+  bank.synthesise(noise, gains, length, output);
+  outputPower = 0;
+  for (int n = length/2; n < length; ++n)
+    outputPower += output[n]*output[n];
+  EXPECT_LT(10*log10(outputPower/inputPower), -20);
+
+  // Gains scale the bands, and the output can overwrite the input.
+  for (int b = 0; b < nbands; ++b)
+    gains[b] = 0.5 + 0.01*b;
+  bank.reset();
+  bank.synthesise(tone, gains, length, output);
+  wipp::copyBuffer(tone, inPlace, length);
+  bank.reset();
+  bank.synthesise(inPlace, gains, length, inPlace);
+  for (int n = 0; n < length; ++n)
+    EXPECT_DOUBLE_EQ(inPlace[n], output[n]);
+
+  // The state carries over from one block to the next, so filtering by hops is filtering at once.
+  // Each channel has its own synthesis state, interleaving them does not change either output.
+  const int hop = 160;
+  BaseType blockEnergy[3][nbands], hopEnergy[3][nbands], hopOutput[length], otherOutput[length];
+  bank.reset();
+  bank.analyse(tone, noise, length, blockEnergy[0], blockEnergy[1], blockEnergy[2]);
+  bank.reset();
+  std::fill(&hopEnergy[0][0], &hopEnergy[0][0] + 3*nbands, 0);
+  for (int n = 0; n < length; n += hop)
+  {
+    bank.analyse(&tone[n], &noise[n], hop, leftEnergy, rightEnergy, crossEnergy);
+    for (int b = 0; b < nbands; ++b)
+    {
+      hopEnergy[0][b] += leftEnergy[b];
+      hopEnergy[1][b] += rightEnergy[b];
+      hopEnergy[2][b] += crossEnergy[b];
+    }
+  }
+  for (int k = 0; k < 3; ++k)
+    for (int b = 0; b < nbands; ++b)
+      EXPECT_NEAR(hopEnergy[k][b], blockEnergy[k][b], 1e-9*(1 + fabs(blockEnergy[k][b])));
+
+  bank.reset();
+  for (int n = 0; n < length; n += hop)
+  {
+    bank.synthesise(&tone[n], gains, hop, &hopOutput[n], 0);
+    bank.synthesise(&noise[n], gains, hop, &otherOutput[n], 1);
+  }
+  for (int n = 0; n < length; ++n)
+    EXPECT_NEAR(hopOutput[n], output[n], 1e-12);
+  bank.reset();
+  bank.synthesise(noise, gains, length, output, 1);
+  for (int n = 0; n < length; ++n)
+    EXPECT_NEAR(otherOutput[n], output[n], 1e-12);
+  EXPECT_THROW(bank.synthesise(tone, gains, length, output, 2), MCArrayException);
+
+  std::fill(gains, gains + nbands, 0);
+  bank.reset();
+  bank.synthesise(tone, gains, length, output);
+  for (int n = 0; n < length; ++n)
+    EXPECT_EQ(output[n], 0);
+
+  EXPECT_THROW(GammatoneFilterBank(sampleRate, 0, 200, 4000), MCArrayException);
+  EXPECT_THROW(GammatoneFilterBank(sampleRate, nbands, 200, 8000), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testMaskingDecisions)
+{
+  const int sampleRate = 16000;
+  FastBinauralMasking masking(sampleRate, 0.15, 200, 4000, BinauralMasking::FULL);
+  const int analysisLength = masking.getAnalysisLength();
+  const int nbins = masking.getNumberOfBins();
+
+  SignalVector spectrum, output;
+  std::vector<double*> spectrumPtrs, outputPtrs;
+  makeTestSpectra(2, analysisLength, spectrum, output, spectrumPtrs, outputPtrs);
+
+  // Identical channels are never masked by spatial masking, and the first frame is above its memory.
+  SpectralFrame first(spectrumPtrs, analysisLength, 0);
+  masking.processSpectrum(first, outputPtrs);
+  for (int bin = 0; bin < nbins; ++bin)
+  {
+    EXPECT_EQ(masking.getSpatialMask()[bin], 0);
+    EXPECT_EQ(masking.getTemporalMask()[bin], 0);
+    EXPECT_EQ(masking.getBandGains(0)[bin], 1);
+    EXPECT_EQ(masking.getBandGains(1)[bin], 1);
+  }
+
+  // A sudden drop of 20dB falls below the memory of every bin, which are then removed.
+  for (int c = 0; c < 2; ++c)
+    wipp::divC(10, spectrum[c].get(), analysisLength);
+  SpectralFrame second(spectrumPtrs, analysisLength, 1);
+  masking.processSpectrum(second, outputPtrs);
+  for (int bin = 0; bin < nbins; ++bin)
+  {
+    EXPECT_EQ(masking.getSpatialMask()[bin], 0);
+    EXPECT_EQ(masking.getTemporalMask()[bin], 1);
+    EXPECT_DOUBLE_EQ(masking.getBandGains(0)[bin], 1e-3);
+    EXPECT_DOUBLE_EQ(masking.getBandGains(1)[bin], 1e-3);
+  }
+}
+
+TEST(MicrophoneArrayTest, testMaskStream)
+{
+  const int nbins = 3;
+  const unsigned char spatialMask[nbins] = {1, 0, 0};
+  const unsigned char temporalMask[nbins] = {0, 0, 1};
+  BaseType gains[2*nbins] = {0.1, 1, 0.3, 0.2, 1, 0.4};
+
+  EXPECT_THROW(MaskStream(nbins, 2, 0), MCArrayException);
+
+  // The oldest frame is overwritten when the buffer is full.
+  MaskStream stream(nbins, 2, 2);
+  for (unsigned long index = 0; index < 3; ++index)
+  {
+    gains[1] = index;
+    stream.push(index, 0.5*index, spatialMask, temporalMask, gains);
+  }
+  ASSERT_EQ(stream.getNumberOfFrames(), 2);
+  EXPECT_EQ(stream.getNumberOfDroppedFrames(), 1u);
+  EXPECT_EQ(stream.getIndex(0), 1u);
+  EXPECT_EQ(stream.getIndex(1), 2u);
+  EXPECT_DOUBLE_EQ(stream.getTimestamp(1), 1.0);
+  EXPECT_EQ(stream.getMask(0)[0], 1);
+  EXPECT_EQ(stream.getMask(0)[1], 0);
+  EXPECT_EQ(stream.getMask(0)[2], 1);
+  EXPECT_EQ(stream.getGains(0, 0)[1], 1);
+  EXPECT_EQ(stream.getGains(1, 0)[1], 2);
+  EXPECT_EQ(stream.getGains(1, 1)[2], 0.4);
+
+  stream.discard(1);
+  ASSERT_EQ(stream.getNumberOfFrames(), 1);
+  EXPECT_EQ(stream.getIndex(0), 2u);
+  EXPECT_THROW(stream.discard(2), MCArrayException);
+  stream.clear();
+  EXPECT_EQ(stream.getNumberOfFrames(), 0);
+
+  // Masking in mask-only mode publishes the masks and leaves the spectrum untouched.
+  const int sampleRate = 16000;
+  FastBinauralMasking::Config config;
+  config.maskStreamCapacity = 4;
+  config.maskOnly = true;
+  FastBinauralMasking masking(sampleRate, 0.15, 200, 4000, config, BinauralMasking::FULL);
+  const int analysisLength = masking.getAnalysisLength();
+  ASSERT_TRUE(masking.getMaskStream() != NULL);
+  EXPECT_TRUE(masking.isMaskOnly());
+
+  SignalVector spectrum, output;
+  std::vector<double*> spectrumPtrs, outputPtrs;
+  makeTestSpectra(2, analysisLength, spectrum, output, spectrumPtrs, outputPtrs);
+
+  SpectralFrame first(spectrumPtrs, analysisLength, 10);
+  masking.processSpectrum(first, outputPtrs);
+  for (int c = 0; c < 2; ++c)
+    wipp::divC(10, spectrum[c].get(), analysisLength);
+  SpectralFrame second(spectrumPtrs, analysisLength, 11);
+  masking.processSpectrum(second, outputPtrs);
+
+  for (int c = 0; c < 2; ++c)
+    for (int i = 0; i < analysisLength; ++i)
+      EXPECT_EQ(output[c][i], spectrum[c][i]);
+
+  MaskStream &masks = *masking.getMaskStream();
+  ASSERT_EQ(masks.getNumberOfFrames(), 2);
+  EXPECT_EQ(masks.getIndex(0), 10u);
+  EXPECT_EQ(masks.getIndex(1), 11u);
+  EXPECT_DOUBLE_EQ(masks.getTimestamp(1) - masks.getTimestamp(0), static_cast<double>(masking.getWindowShift())/sampleRate);
+  for (int bin = 0; bin < masking.getNumberOfBins(); ++bin)
+  {
+    EXPECT_EQ(masks.getMask(0)[bin], 0);
+    EXPECT_EQ(masks.getMask(1)[bin], 1);
+    EXPECT_DOUBLE_EQ(masks.getGains(1, 0)[bin], masking.getBandGains(0)[bin]);
+    EXPECT_DOUBLE_EQ(masks.getGains(1, 1)[bin], 1e-3);
+  }
+}
+
+TEST(MicrophoneArrayTest, testMultichannelMasking)
+{
+  typedef FastBinauralMasking::MicrophonePair MicrophonePair;
+
+  // Each microphone is paired with its nearest neighbour.
+  std::vector<double> x = {0, 0.05, 0.1, 0.15};
+  ArrayDescription linear = ArrayDescription::make_linear_array_description(x);
+  std::vector<MicrophonePair> pairs = FastBinauralMasking::getNearestNeighbourPairs(linear);
+  ASSERT_EQ(pairs.size(), 3u);
+  EXPECT_EQ(pairs[0], MicrophonePair(0, 1));
+  EXPECT_EQ(pairs[1], MicrophonePair(1, 2));
+  EXPECT_EQ(pairs[2], MicrophonePair(2, 3));
+
+  std::vector<double> clusters = {0, 0.05, 0.3, 0.32};
+  pairs = FastBinauralMasking::getNearestNeighbourPairs(ArrayDescription::make_linear_array_description(clusters));
+  ASSERT_EQ(pairs.size(), 2u);
+  EXPECT_EQ(pairs[0], MicrophonePair(0, 1));
+  EXPECT_EQ(pairs[1], MicrophonePair(2, 3));
+
+  const int sampleRate = 16000;
+  FastBinauralMasking::Config config;
+  EXPECT_THROW(FastBinauralMasking(sampleRate, ArrayDescription::make_linear_array_description(std::vector<double>(1, 0)),
+				   200, 4000, config), MCArrayException);
+  FastBinauralMasking::Config wrongPairs;
+  wrongPairs.pairs.push_back(MicrophonePair(0, 4));
+  EXPECT_THROW(FastBinauralMasking(sampleRate, linear, 200, 4000, wrongPairs), MCArrayException);
+
+  // A single mask is applied to all the channels.
+  const int nchannels = x.size();
+  FastBinauralMasking masking(sampleRate, linear, 200, 4000, config, BinauralMasking::FULL);
+  EXPECT_EQ(masking.getMicrophonePairs().size(), 3u);
+  EXPECT_DOUBLE_EQ(masking.getMicroPhoneDistance(), 0.05);
+  const int analysisLength = masking.getAnalysisLength();
+  const int nbins = masking.getNumberOfBins();
+
+  SignalVector spectrum, output;
+  std::vector<double*> spectrumPtrs, outputPtrs;
+  makeTestSpectra(nchannels, analysisLength, spectrum, output, spectrumPtrs, outputPtrs);
+
+  SpectralFrame first(spectrumPtrs, analysisLength, 0);
+  masking.processSpectrum(first, outputPtrs);
+  for (int c = 0; c < nchannels; ++c)
+    wipp::divC(10, spectrum[c].get(), analysisLength);
+  SpectralFrame second(spectrumPtrs, analysisLength, 1);
+  masking.processSpectrum(second, outputPtrs);
+
+  for (int bin = 0; bin < nbins; ++bin)
+  {
+    EXPECT_EQ(masking.getSpatialMask()[bin], 0);
+    EXPECT_EQ(masking.getTemporalMask()[bin], 1);
+    for (int c = 0; c < nchannels; ++c)
+      EXPECT_DOUBLE_EQ(masking.getBandGains(c)[bin], 1e-3);
+  }
+  for (int c = 1; c < nchannels; ++c)
+    for (int i = 0; i < analysisLength; ++i)
+      EXPECT_EQ(output[c][i], output[0][i]);
+}
+
+TEST(MicrophoneArrayTest, testUsefulBand)
+{
+  // 8.9 cm at 44.1 kHz, FFT of 2048: bins from 100 Hz to c/(2d) ~ 1.93 kHz.
+  const int complexLength = 1025;
+  int firstBin, lastBin;
+  getUsefulBand(0.089, 44100, complexLength, firstBin, lastBin);
+  EXPECT_EQ(firstBin, 5);
+  EXPECT_EQ(lastBin, static_cast<int>(maxFreqForSpatialAliasing(0.089)*2048/44100) + 1);
+  EXPECT_LT(lastBin - firstBin, complexLength/10);
+
+  // Coincident microphones do not alias, and far ones keep at least one bin.
+  getUsefulBand(0, 44100, complexLength, firstBin, lastBin);
+  EXPECT_EQ(lastBin, complexLength);
+  getUsefulBand(100, 44100, complexLength, firstBin, lastBin);
+  EXPECT_EQ(lastBin, firstBin + 1);
+
+  const int sampleRate = 16000;
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.089});
+  for (TauMatrix::Evaluation evaluation : {TauMatrix::TABLE, TauMatrix::RECURRENCE})
+  {
+    FreqGCCBinauralLocalisation::Config config;
+    config.bandLimited = true;
+    config.tauEvaluation = evaluation;
+    FreqGCCBinauralLocalisation localisation(sampleRate, positions, config, false);
+    EXPECT_GT(localisation.getAnalysisLength(), 0);
+  }
+}
+
+TEST(MicrophoneArrayTest, testDecimatingFrontEnd)
+{
+  // Below 2 kHz for an 8.9 cm pair, the factor has to divide the sample rate.
+  ArrayDescription pair = ArrayDescription::make_linear_array_description({0, 0.089});
+  EXPECT_EQ(DecimatingFrontEnd::chooseFactor(44100, pair.getBandwidth()), 9);
+  EXPECT_EQ(DecimatingFrontEnd::chooseFactor(48000, pair.getBandwidth()), 8);
+  EXPECT_EQ(DecimatingFrontEnd::chooseFactor(16000, pair.getBandwidth()), 2);
+  EXPECT_EQ(DecimatingFrontEnd::chooseFactor(16000, 0), 1);
+  EXPECT_THROW(DecimatingFrontEnd(16000, 2, 0), MCArrayException);
+
+  const int sampleRate = 48000;
+  DecimatingFrontEnd frontEnd(sampleRate, pair);
+  DecimatingFrontEnd reference(sampleRate, 2, frontEnd.getFactor());
+  const int factor = frontEnd.getFactor();
+  ASSERT_EQ(factor, 8);
+  EXPECT_EQ(frontEnd.getOutputSampleRate(), 6000);
+
+  // A tone in the band goes through, one that would alias into the band is removed.
+  const int length = 9600;
+  SignalVector input, output, expected;
+  std::vector<double*> inputPtrs, outputPtrs, expectedPtrs;
+  for (int c = 0; c < 2; ++c)
+  {
+    input.push_back(SignalPtr(new BaseType[length]));
+    output.push_back(SignalPtr(new BaseType[length]));
+    expected.push_back(SignalPtr(new BaseType[length]));
+    outputPtrs.push_back(output.back().get());
+    expectedPtrs.push_back(expected.back().get());
+  }
+  for (int n = 0; n < length; ++n)
+  {
+    input[0][n] = sin(2*M_PI*500*n/sampleRate);
+    input[1][n] = sin(2*M_PI*20000*n/sampleRate);
+  }
+
+  int expectedLength = reference.decimate(std::vector<double*>({input[0].get(), input[1].get()}), length, expectedPtrs);
+  EXPECT_EQ(expectedLength, length/factor);
+  for (int n = frontEnd.getDelay()/factor + 1; n < expectedLength; ++n)
+  {
+    EXPECT_NEAR(expected[0][n], sin(2*M_PI*500*(n*factor - frontEnd.getDelay())/sampleRate), 1e-2);
+    EXPECT_NEAR(expected[1][n], 0, 1e-3);
+  }
+
+  // Blocks of any length give the same signal.
+  int produced = 0;
+  for (int offset = 0, block = 1; offset < length; offset += block, block = 2*block + 3)
+  {
+    block = std::min(block, length - offset);
+    std::vector<double*> blockOutput = {&output[0][produced], &output[1][produced]};
+    produced += frontEnd.decimate(std::vector<double*>({&input[0][offset], &input[1][offset]}), block, blockOutput);
+  }
+  ASSERT_EQ(produced, expectedLength);
+  for (int c = 0; c < 2; ++c)
+    for (int n = 0; n < produced; ++n)
+      EXPECT_DOUBLE_EQ(output[c][n], expected[c][n]);
+}
+
+TEST(MicrophoneArrayTest, testRestrictedDOASearch)
+{
+  const int complexLength = 513;
+  const int numSteps = 61;
+
+  BaseTypeC left[complexLength];
+  BaseTypeC right[complexLength];
+  srand(48);
+  for (int k = 0; k < complexLength; ++k)
+  {
+    left[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    left[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].re = rand()/static_cast<double>(RAND_MAX) - 0.5;
+    right[k].im = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  }
+
+  BaseType tau[numSteps];
+  for (int t = 0; t < numSteps; ++t)
+    tau[t] = doaToDelayFarFieldSamples(doaIdx2angle(t, M_PI/(numSteps-1)), 0.15, 16000);
+
+  // Windows on the edges of the grid, across its centre and not aligned to groups of delays.
+  const std::pair<int, int> windows[] = {{0, 7}, {27, 35}, {13, 14}, {50, numSteps}};
+  const BaseType untouched = 1e6;
+  BaseType expected[numSteps], correlations[numSteps];
+  for (TauMatrix::Evaluation evaluation : {TauMatrix::TABLE, TauMatrix::RECURRENCE})
+  {
+    TauMatrix matrix(tau, numSteps, 11, complexLength, complexLength, evaluation);
+    BinauralGCC gcc(tau, numSteps, 11, complexLength, complexLength);
+    matrix.calculateCorrelations(left, right, expected);
+    for (const std::pair<int, int> &window : windows)
+    {
+      std::fill(correlations, correlations + numSteps, untouched);
+      if (evaluation == TauMatrix::TABLE)
+	gcc.calculateCorrelations(left, right, correlations, window.first, window.second);
+      else
+	matrix.calculateCorrelations(left, right, correlations, window.first, window.second);
+
+      for (int t = 0; t < numSteps; ++t)
+      {
+	if (t < window.first || t >= window.second)
+	  EXPECT_EQ(correlations[t], untouched);
+	else
+	  EXPECT_NEAR(correlations[t], expected[t], 1e-4);
+      }
+    }
+  }
+
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.15});
+  FreqGCCBinauralLocalisation::Config config;
+  config.trackingWindow = 5;
+  FreqGCCBinauralLocalisation localisation(16000, positions, config, false);
+  EXPECT_FALSE(localisation.isSourceLocked());
+
+  config.fullSearchPeriod = 0;
+  EXPECT_THROW(FreqGCCBinauralLocalisation(16000, positions, config, false), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testLocalisationRate)
+{
+  const int sampleRate = 16000;
+  const int fftCCSLength = 514;
+  const unsigned int nchannels = 4;
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.05, 0.1, 0.15});
+  BeamformingSeparationAndLocalisation impl(sampleRate, fftCCSLength, positions, 1, false);
+
+  srand(49);
+  SignalVector frames, wienerCoefs;
+  for (unsigned int c = 0; c < nchannels; ++c)
+  {
+    frames.push_back(SignalPtr(new BaseType[fftCCSLength]));
+    for (int i = 0; i < fftCCSLength; ++i)
+      frames[c][i] = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  }
+
+  // Every frame by default, then one out of four.
+  for (int f = 0; f < 4; ++f)
+    impl.processFrameLocalisation(frames, wienerCoefs);
+  EXPECT_EQ(impl.getNumberOfLocalisations(), 4u);
+
+  impl.setLocalisationRate(BeamformingSeparationAndLocalisation::LocalisationRate(4));
+  for (int f = 0; f < 12; ++f)
+    impl.processFrameLocalisation(frames, wienerCoefs);
+  EXPECT_EQ(impl.getNumberOfLocalisations(), 4u + 3u);
+
+  // A spectrum that changes is localised before the period elapses.
+  BeamformingSeparationAndLocalisation::LocalisationRate rate(100);
+  rate.spectralChange = 0.2;
+  impl.setLocalisationRate(rate);
+  impl.processFrameLocalisation(frames, wienerCoefs);
+  impl.processFrameLocalisation(frames, wienerCoefs);
+  EXPECT_EQ(impl.getNumberOfLocalisations(), 8u);
+  for (unsigned int c = 0; c < nchannels; ++c)
+    wipp::multC(3.0, frames[c].get(), fftCCSLength);
+  impl.processFrameLocalisation(frames, wienerCoefs);
+  EXPECT_EQ(impl.getNumberOfLocalisations(), 9u);
+
+  EXPECT_THROW(impl.setLocalisationRate(BeamformingSeparationAndLocalisation::LocalisationRate(0)), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testSourceCounting)
+{
+  const int sampleRate = 16000;
+  const int fftCCSLength = 514;
+  const int complexLength = fftCCSLength/2;
+  const unsigned int nchannels = 4;
+  const int numOfSources = 3;
+  std::vector<double> positions = {0, 0.02, 0.04, 0.06};
+  ArrayDescription array = ArrayDescription::make_linear_array_description(positions);
+  SteeringBeamforming steering(sampleRate, array, fftCCSLength, nchannels);
+
+  SignalVector frames, wienerCoefs;
+  for (unsigned int c = 0; c < nchannels; ++c)
+    frames.push_back(SignalPtr(new BaseType[fftCCSLength]));
+  SignalPtr DOA(new BaseType[numOfSources]), prob(new BaseType[numOfSources]);
+
+  // Sources from -50 and 40 degrees, the second one in the odd bins only.
+  srand(50);
+  auto generateFrame = [&](bool twoSources)
+  {
+    for (int k = 0; k < complexLength; ++k)
+    {
+      double doa = (twoSources && k % 2) ? 40*M_PI/180 : -50*M_PI/180;
+      double phase = 2*M_PI*rand()/static_cast<double>(RAND_MAX);
+      for (unsigned int c = 0; c < nchannels; ++c)
+      {
+	double delay = doaToDelayFarFieldSamples(doa, positions[c], sampleRate);
+	frames[c][2*k] = cos(phase - M_PI*k*delay/(complexLength-1));
+	frames[c][2*k+1] = sin(phase - M_PI*k*delay/(complexLength-1));
+      }
+    }
+  };
+
+  for (int f = 0; f < 20; ++f)
+  {
+    generateFrame(false);
+    steering.processFrame(frames, DOA, prob, numOfSources, wienerCoefs);
+  }
+  EXPECT_EQ(steering.getNumberOfActiveSources(), 1);
+
+  for (int f = 0; f < 20; ++f)
+  {
+    generateFrame(true);
+    steering.processFrame(frames, DOA, prob, numOfSources, wienerCoefs);
+  }
+  EXPECT_EQ(steering.getNumberOfActiveSources(), 2);
+
+  // The second source is released once its energy has faded.
+  for (int f = 0; f < 40; ++f)
+  {
+    generateFrame(false);
+    steering.processFrame(frames, DOA, prob, numOfSources, wienerCoefs);
+  }
+  EXPECT_EQ(steering.getNumberOfActiveSources(), 1);
+
+  // The separation beamforms every source unless counting is enabled, then the outputs of the
+  // inactive sources are zero.
+  BeamformingSeparationAndLocalisation impl(sampleRate, fftCCSLength, array, numOfSources, false);
+  SignalVector outputs;
+  for (unsigned int c = 0; c < nchannels; ++c)
+    outputs.push_back(SignalPtr(new BaseType[fftCCSLength]));
+  auto outputEnergy = [&](unsigned int c)
+  {
+    BaseType energy = 0;
+    for (int i = 0; i < fftCCSLength; ++i)
+      energy += outputs[c][i]*outputs[c][i];
+    return energy;
+  };
+
+  for (int f = 0; f < 20; ++f)
+  {
+    generateFrame(false);
+    impl.processFrameLocalisation(frames, wienerCoefs);
+  }
+  EXPECT_EQ(impl.getNumberOfActiveSources(), static_cast<unsigned int>(numOfSources));
+  impl.processFrameSeparation(frames, outputs);
+  for (int s = 0; s < numOfSources; ++s)
+    EXPECT_GT(outputEnergy(s), 0);
+
+  impl.setSourceCounting(true);
+  impl.processFrameLocalisation(frames, wienerCoefs);
+  EXPECT_EQ(impl.getNumberOfActiveSources(), 1u);
+  impl.processFrameSeparation(frames, outputs);
+  EXPECT_GT(outputEnergy(0), 0);
+  for (unsigned int c = 1; c < nchannels; ++c)
+    EXPECT_EQ(outputEnergy(c), 0);
+
+  impl.setSourceCounting(false);
+  EXPECT_EQ(impl.getNumberOfActiveSources(), static_cast<unsigned int>(numOfSources));
+}
+
+TEST(MicrophoneArrayTest, testMultibandThreads)
+{
+  const int sampleRate = 16000;
+  const int length = sampleRate/2;
+  const int delay = 3;
+  ArrayDescription adesc = ArrayDescription::make_linear_array_description({0, 0.2});
+
+  // White noise reaching the right microphone some samples later.
+  srand(27);
+  std::vector<BaseType> noise(length + delay);
+  for (int i = 0; i < length + delay; ++i)
+    noise[i] = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  SignalVector input;
+  input.push_back(SignalPtr(new BaseType[length]));
+  input.push_back(SignalPtr(new BaseType[length]));
+  wipp::copyBuffer(&noise[delay], input[0].get(), length);
+  wipp::copyBuffer(&noise[0], input[1].get(), length);
+
+  TestRecordingLocalisationCallback sequential, parallel;
+  MultibandBinarualLocalisation one(sampleRate, adesc, 15, false, 1);
+  MultibandBinarualLocalisation four(sampleRate, adesc, 15, false, 4);
+  one.setCallback(&sequential);
+  four.setCallback(&parallel);
+  one.process(input, length);
+  four.process(input, length);
+
+  ASSERT_GT(sequential.doas.size(), 0u);
+  ASSERT_EQ(sequential.doas.size(), parallel.doas.size());
+  for (size_t f = 0; f < sequential.doas.size(); ++f)
+  {
+    EXPECT_EQ(sequential.doas[f], parallel.doas[f]);
+    EXPECT_NEAR(sequential.probs[f], parallel.probs[f], 1e-9);
+    EXPECT_EQ(sequential.powers[f], parallel.powers[f]);
+  }
+}
+
+TEST(MicrophoneArrayTest, testDecimatedLocalisation)
+{
+  const int sampleRate = 48000;
+  const int length = 2*sampleRate;
+  const int block = sampleRate/10;
+  const int delay = 6;
+  ArrayDescription pair = ArrayDescription::make_linear_array_description({0, 0.089});
+
+  // Bursts of white noise reaching the second microphone some samples later, over a weak
+  // uncorrelated background that keeps the noise floor below them.
+  srand(47);
+  std::vector<BaseType> noise(length + delay);
+  for (int n = 0; n < length + delay; ++n)
+    noise[n] = rand()/static_cast<double>(RAND_MAX) - 0.5;
+  SignalVector input;
+  for (int c = 0; c < 2; ++c)
+    input.push_back(SignalPtr(new BaseType[length]));
+  for (int n = 0; n < length; ++n)
+  {
+    BaseType burst = ((n/(sampleRate/4)) % 2 == 0) ? 1 : 0;
+    input[0][n] = burst*noise[n + delay] + 1e-3*(rand()/static_cast<double>(RAND_MAX) - 0.5);
+    input[1][n] = burst*noise[n] + 1e-3*(rand()/static_cast<double>(RAND_MAX) - 0.5);
+  }
+
+  // The decimated path localises at the rate of its front end, the other one at the input rate.
+  TestRecordingLocalisationCallback fullRate, decimated;
+  SoundLocalisation full(sampleRate, pair, &fullRate);
+  SoundLocalisation reduced(sampleRate, pair, &decimated, SteeringBeamforming::SRP_PHAT, true);
+  DecimatingFrontEnd frontEnd(sampleRate, pair);
+  EXPECT_EQ(full.getAnalysisSampleRate(), sampleRate);
+  EXPECT_EQ(reduced.getAnalysisSampleRate(), frontEnd.getOutputSampleRate());
+  EXPECT_EQ(reduced.getAnalysisSampleRate(), 6000);
+
+  // Without decimation it is the localisation it always was, and with it, the same localisation
+  // built at the decimated rate and fed with the decimated signal.
+  TestRecordingLocalisationCallback fullReference, decimatedReference;
+  FreqGCCBinauralLocalisation fullLocalisation(sampleRate, pair, true);
+  fullLocalisation.setCallback(&fullReference);
+  FreqGCCBinauralLocalisation decimatedLocalisation(frontEnd.getOutputSampleRate(), pair, true);
+  decimatedLocalisation.setCallback(&decimatedReference);
+
+  SignalVector decimatedInput;
+  std::vector<double*> decimatedPtrs;
+  for (int c = 0; c < 2; ++c)
+  {
+    decimatedInput.push_back(SignalPtr(new BaseType[length]));
+    decimatedPtrs.push_back(decimatedInput.back().get());
+  }
+
+  int decimatedLength = 0;
+  for (int offset = 0; offset < length; offset += block)
+  {
+    std::vector<double*> channels = {&input[0][offset], &input[1][offset]};
+    EXPECT_EQ(full.process(channels, block), block);
+    fullLocalisation.process(channels, block);
+
+    std::vector<double*> decimatedBlock = {&decimatedInput[0][decimatedLength], &decimatedInput[1][decimatedLength]};
+    int produced = frontEnd.decimate(channels, block, decimatedBlock);
+    decimatedLocalisation.process(decimatedBlock, produced);
+    EXPECT_EQ(reduced.process(channels, block), produced);
+    decimatedLength += produced;
+  }
+  EXPECT_EQ(decimatedLength, length/frontEnd.getFactor());
+
+  ASSERT_GT(fullRate.doas.size(), 4u);
+  ASSERT_GT(decimated.doas.size(), 4u);
+  ASSERT_EQ(fullRate.doas.size(), fullReference.doas.size());
+  for (size_t f = 0; f < fullRate.doas.size(); ++f)
+  {
+    EXPECT_EQ(fullRate.doas[f], fullReference.doas[f]);
+    EXPECT_EQ(fullRate.probs[f], fullReference.probs[f]);
+    EXPECT_EQ(fullRate.powers[f], fullReference.powers[f]);
+  }
+  ASSERT_EQ(decimated.doas.size(), decimatedReference.doas.size());
+  for (size_t f = 0; f < decimated.doas.size(); ++f)
+  {
+    EXPECT_EQ(decimated.doas[f], decimatedReference.doas[f]);
+    EXPECT_EQ(decimated.probs[f], decimatedReference.probs[f]);
+    EXPECT_EQ(decimated.powers[f], decimatedReference.powers[f]);
+  }
+
+  // The delay is 0.75 samples at the decimated rate, 29.1 degrees away from broadside towards
+  // the first microphone. With this signal the GCC of the input finds it within 0.02 degrees
+  // and the one of the decimated signal 0.3 degrees further (at most 0.6 over seeds 1 to 7),
+  // so one degree, a third of the DOA grid of the localisation, is left for the decimation.
+  double trueDOA = -toDegrees(asin(delay*getSpeedOfSound()/(0.089*sampleRate)));
+  double fullDOA = estimatePairDOA(input, sampleRate/4, sampleRate, 1024, 0.089);
+  double decimatedDOA = estimatePairDOA(decimatedInput, sampleRate/4/frontEnd.getFactor(),
+					frontEnd.getOutputSampleRate(), 128, 0.089);
+  EXPECT_NEAR(fullDOA, trueDOA, 0.2);
+  EXPECT_NEAR(decimatedDOA, fullDOA, 1);
+  EXPECT_NEAR(decimatedDOA, trueDOA, 1);
+}
+
+TEST(MicrophoneArrayTest, testDefaultTimeConstants)
+{
+  const int sampleRate = 16000;
+  ArrayDescription positions = ArrayDescription::make_linear_array_description({0, 0.15});
+
+  // The default configuration keeps the factors it had before they followed the hop.
+  FastBinauralMasking masking(sampleRate, 0.15, 200, 4000, FastBinauralMasking::Config());
+  EXPECT_EQ(masking.getFrameForgetingFactor(), 0.04f);
+  FreqGCCBinauralLocalisation localisation(sampleRate, positions, FreqGCCBinauralLocalisation::Config());
+  EXPECT_EQ(localisation.getFrameCorrMemoryFactor(), 0.8f);
+  EXPECT_EQ(localisation.getFrameDoaMemoryFactor(), 0.6f);
+  EXPECT_EQ(localisation.getNoiseFloorTracker()->getWindowLength(), NoiseFloorTracker::getWindowLength(3, 0.075f));
+
+  // A hop twice as long forgets twice as much per frame.
+  FastBinauralMasking::Config longMaskingFrames;
+  longMaskingFrames.fftOrder = dsp::ShortTimeProcess::calculateOrderFromSampleRate(sampleRate, 0.050f) + 1;
+  FastBinauralMasking longMasking(sampleRate, 0.15, 200, 4000, longMaskingFrames);
+  EXPECT_FLOAT_EQ(longMasking.getFrameForgetingFactor(), 0.04f*0.04f);
+  FreqGCCBinauralLocalisation::Config longFrames;
+  longFrames.fftOrder = dsp::ShortTimeProcess::calculateOrderFromSampleRate(sampleRate, 0.075f) + 1;
+  FreqGCCBinauralLocalisation longLocalisation(sampleRate, positions, longFrames);
+  EXPECT_FLOAT_EQ(longLocalisation.getFrameCorrMemoryFactor(), 0.8f*0.8f);
+  EXPECT_FLOAT_EQ(longLocalisation.getFrameDoaMemoryFactor(), 0.6f*0.6f);
+  EXPECT_EQ(longLocalisation.getNoiseFloorTracker()->getWindowLength(), NoiseFloorTracker::getWindowLength(3, 0.15));
+}
+
+TEST(MicrophoneArrayTest, testMultiBeamBeamformer)
+{
+  const int sampleRate = 16000;
+  const int fftCCSLength = 514;
+  const unsigned int nchannels = 4;
+  const unsigned int nbeams = 3;
+  const BaseType DOAs[nbeams] = {-M_PI/4, 0.1, M_PI/3};
+
+  ArrayDescription description;
+  for (unsigned int c = 0; c < nchannels; ++c)
+    description.pushPosition(0.05*c, 0, 0);
+
+  SignalVector inputs, outputs, expected;
+  for (unsigned int c = 0; c < nchannels; ++c)
+  {
+    inputs.push_back(SignalPtr(new BaseType[fftCCSLength]));
+    outputs.push_back(SignalPtr(new BaseType[fftCCSLength]));
+    expected.push_back(SignalPtr(new BaseType[fftCCSLength]));
+    for (int i = 0; i < fftCCSLength; ++i)
+      inputs[c][i] = sin(0.37*i*(c+1)) + 0.1*c;
+  }
+
+  Beamformer single(sampleRate, description, fftCCSLength, nchannels);
+  Beamformer multi(sampleRate, description, fftCCSLength, nchannels, nbeams);
+
+  for (unsigned int b = 0; b < nbeams; ++b)
+    single.processFrame(inputs, expected[b], DOAs[b]);
+
+  multi.processFrame(inputs, outputs, DOAs, nbeams);
+  for (unsigned int b = 0; b < nbeams; ++b)
+    for (int i = 0; i < fftCCSLength; ++i)
+      EXPECT_NEAR(outputs[b][i], expected[b][i], 1e-9);
+
+  // Outputs written over the inputs.
+  multi.processFrame(inputs, inputs, DOAs, nbeams);
+  for (unsigned int b = 0; b < nbeams; ++b)
+    for (int i = 0; i < fftCCSLength; ++i)
+      EXPECT_NEAR(inputs[b][i], expected[b][i], 1e-9);
+
+  EXPECT_THROW(multi.processFrame(inputs, outputs, DOAs, nbeams+1), MCArrayException);
+}
+
+TEST(MicrophoneArrayTest, testAdaptiveBeamformer)
+{
+  const int sampleRate = 16000;
+  const int fftCCSLength = 514;
+  const int complexLength = fftCCSLength/2;
+  const unsigned int nchannels = 4;
+  const BaseType target = 0.0;
+  const BaseType interference = M_PI/4;
+
+  ArrayDescription description;
+  for (unsigned int c = 0; c < nchannels; ++c)
+    description.pushPosition(0.05*c, 0, 0);
+
+  // Steering vectors as used by the beamformer: x_c = e^{-jk*step_c} s
+  auto synthesise = [&](SignalVector &frames, BaseType DOA, BaseType amplitude, BaseType noise) {
+    for (unsigned int c = 0; c < nchannels; ++c)
+    {
+      double step = 2*M_PI*sampleRate/(fftCCSLength-2)/getSpeedOfSound()*description.getX(c)*cos(DOA+M_PI/2);
+      BaseTypeC *x = reinterpret_cast<BaseTypeC*>(frames[c].get());
+      for (int k = 0; k < complexLength; ++k)
+      {
+	double phase = 0.7*k*k + 0.3*k;
+	x[k].re = amplitude*cos(phase - k*step) + noise*(std::rand()/(double)RAND_MAX - 0.5);
+	x[k].im = amplitude*sin(phase - k*step) + noise*(std::rand()/(double)RAND_MAX - 0.5);
+      }
+    }
+  };
+  auto bandPower = [&](SignalPtr frame) {
+    BaseType power = 0;
+    for (int i = 2*complexLength/4; i < fftCCSLength; ++i)
+      power += frame[i]*frame[i];
+    return power;
+  };
+
+  SignalVector inputs, output(1);
+  for (unsigned int c = 0; c < nchannels; ++c)
+    inputs.push_back(SignalPtr(new BaseType[fftCCSLength]));
+  output[0].reset(new BaseType[fftCCSLength]);
+
+  Beamformer delayAndSum(sampleRate, description, fftCCSLength, nchannels);
+  AdaptiveBeamformer mvdr(sampleRate, description, fftCCSLength, nchannels, 1, Beamformer::MVDR);
+  AdaptiveBeamformer superdirective(sampleRate, description, fftCCSLength, nchannels, 1, Beamformer::SUPERDIRECTIVE);
+
+  std::srand(1);
+  for (int frame = 0; frame < 8; ++frame)
+  {
+    synthesise(inputs, interference, 1.0, 0.01);
+    mvdr.processFrame(inputs, output, &target, 1);
+  }
+
+  // The interference is cancelled much more than with delay-and-sum.
+  synthesise(inputs, interference, 1.0, 0);
+  delayAndSum.processFrame(inputs, output[0], target);
+  BaseType dsPower = bandPower(output[0]);
+  mvdr.processFrame(inputs, output, &target, 1);
+  EXPECT_LT(bandPower(output[0]), 0.01*dsPower);
+
+  // Both adaptive beamformers keep the signal from the target direction.
+  synthesise(inputs, target, 1.0, 0);
+  SignalPtr expected(new BaseType[fftCCSLength]);
+  for (int i = 0; i < fftCCSLength; ++i)
+    expected[i] = inputs[0][i];
+
+  mvdr.processFrame(inputs, output, &target, 1);
+  for (int i = 0; i < fftCCSLength; ++i)
+    EXPECT_NEAR(output[0][i], expected[i], 1e-6);
+
+  superdirective.processFrame(inputs, output[0], target);
+  for (int i = 0; i < fftCCSLength; ++i)
+    EXPECT_NEAR(output[0][i], expected[i], 1e-6);
+
+  EXPECT_THROW(AdaptiveBeamformer(sampleRate, description, fftCCSLength, nchannels, 1, Beamformer::DELAY_AND_SUM), MCArrayException);
+}
+
 TEST(MicrophoneArrayTest, testArrayDescription)
 {
   ArrayDescription description;
@@ -1064,6 +2675,21 @@ void testTemporalMaskingCore(dsp::ShortTimeProcess *masking, int sampleRate)
   EXPECT_LT(fabs(powerDB-5), 1);
 }
 
+void makeTestSpectra(unsigned int nchannels, int analysisLength, SignalVector &spectrum, SignalVector &output,
+		     std::vector<double*> &spectrumPtrs, std::vector<double*> &outputPtrs)
+{
+  // The same broadband spectrum on every channel, so that the pairs come from the front.
+  for (unsigned int c = 0; c < nchannels; ++c)
+  {
+    spectrum.push_back(SignalPtr(new BaseType[analysisLength]));
+    output.push_back(SignalPtr(new BaseType[analysisLength]));
+    spectrumPtrs.push_back(spectrum.back().get());
+    outputPtrs.push_back(output.back().get());
+    for (int i = 0; i < analysisLength; ++i)
+      spectrum[c][i] = cos(0.37*i*i) + 0.5;
+  }
+}
+
 void assertLocalisationMessage(double doa, double prob, double power)
 {
   DEBUG_STREAM("DOA: " << doa << " PROB: " << prob << " POWER: " << power);